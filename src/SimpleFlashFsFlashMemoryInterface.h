@@ -9,11 +9,27 @@
 #define SRC_SIMPLEFLASHFSFLASHMEMORYINTERFACE_H_
 
 #include <cstddef>
+#include <span>
 
 namespace SimpleFlashFs {
 
 class FlashMemoryInterface
 {
+public:
+	struct WriteVec
+	{
+		std::size_t address;
+		const std::byte *data;
+		std::size_t size;
+	};
+
+	struct ReadVec
+	{
+		std::size_t address;
+		std::byte *data;
+		std::size_t size;
+	};
+
 public:
 	virtual ~FlashMemoryInterface() {}
 
@@ -24,6 +40,46 @@ public:
 
 	virtual void erase( std::size_t address, std::size_t size ) = 0;
 
+	/**
+	 * scatter gather write. The filesystem passes several pages at once,
+	 * so a backend can use DMA or burst programming.
+	 * Returns the number of bytes written. Stops at the first short write.
+	 *
+	 * The default implementation calls write() for each entry.
+	 */
+	virtual std::size_t write_v( std::span<const WriteVec> vec ) {
+		std::size_t ret = 0;
+
+		for( const auto & v : vec ) {
+			const std::size_t len = write( v.address, v.data, v.size );
+			ret += len;
+
+			if( len != v.size ) {
+				break;
+			}
+		}
+
+		return ret;
+	}
+
+	/**
+	 * scatter gather read, see write_v()
+	 */
+	virtual std::size_t read_v( std::span<const ReadVec> vec ) {
+		std::size_t ret = 0;
+
+		for( const auto & v : vec ) {
+			const std::size_t len = read( v.address, v.data, v.size );
+			ret += len;
+
+			if( len != v.size ) {
+				break;
+			}
+		}
+
+		return ret;
+	}
+
 	/**
 	 * returns true if the flash memory is mapped into the address space,
 	 * so for reading we can simple get an address pointer
@@ -36,6 +92,22 @@ public:
 	 * converts the address to a in memory mapped address
 	 */
 	virtual const std::byte* map_read( std::size_t address, std::size_t size ) { return nullptr; }
+
+	/**
+	 * size of one bank in bytes. The memory is split into consecutive
+	 * banks of this size, writes and erases of different banks can
+	 * run at the same time. So a long erase of one bank does not block
+	 * a write to an other bank.
+	 *
+	 * A backend returning a value > 0 has to accept concurrent calls,
+	 * as long as they are for different banks. The filesystem
+	 * serializes the writes and erases of the same bank.
+	 *
+	 * 0 means, the whole memory is one bank.
+	 */
+	virtual std::size_t get_bank_size() const {
+		return 0;
+	}
 };
 
 
@@ -0,0 +1,261 @@
+/*
+ * SimpleFlashFsInstrumentedFlashMemory.cc
+ *
+ *  Created on: 17.10.2026
+ *      Author: martin
+ */
+#include "SimpleFlashFsInstrumentedFlashMemory.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <sstream>
+
+namespace SimpleFlashFs {
+
+namespace {
+
+uint64_t elapsed_ns( std::chrono::steady_clock::time_point start )
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - start ).count();
+}
+
+void report_operation( std::ostream & out, const char *name, const InstrumentedFlashMemory::OperationStats & stats )
+{
+	out << name << ": " << stats.count << " calls, " << stats.bytes << " bytes";
+
+	if( stats.latency.count() > 0 ) {
+		out << ", latency p50 " << stats.latency.percentile( 0.5 )
+			<< " ns, p99 " << stats.latency.percentile( 0.99 )
+			<< " ns, max " << stats.latency.max() << " ns";
+	}
+
+	out << '\n';
+}
+
+void report_pages( std::ostream & out, const char *name, const std::vector<uint32_t> & pages, std::size_t top_pages )
+{
+	std::vector<std::pair<uint32_t,uint32_t>> used; // count, page
+	uint64_t sum = 0;
+
+	for( uint32_t page = 0; page < pages.size(); page++ ) {
+		if( pages[page] > 0 ) {
+			used.emplace_back( pages[page], page );
+			sum += pages[page];
+		}
+	}
+
+	if( used.empty() ) {
+		return;
+	}
+
+	std::sort( used.begin(), used.end(), []( const auto & a, const auto & b ) {
+		return a.first != b.first ? a.first > b.first : a.second < b.second;
+	} );
+
+	out << name << " per page: " << used.size() << " pages, max " << used.front().first
+		<< ", mean " << ( sum / used.size() ) << '\n';
+
+	out << "  most " << name << ":";
+
+	for( std::size_t i = 0; i < used.size() && i < top_pages; i++ ) {
+		out << ' ' << used[i].second << '=' << used[i].first;
+	}
+
+	out << '\n';
+}
+
+} // namespace
+
+void InstrumentedFlashMemory::LatencyHistogram::add( uint64_t ns )
+{
+	const std::size_t bucket = std::min<std::size_t>( std::bit_width( ns ), BUCKETS ) - ( ns > 0 ? 1 : 0 );
+
+	buckets[bucket]++;
+	samples++;
+	max_ns = std::max( max_ns, ns );
+}
+
+uint64_t InstrumentedFlashMemory::LatencyHistogram::percentile( double p ) const
+{
+	if( samples == 0 ) {
+		return 0;
+	}
+
+	const uint64_t rank = std::max<uint64_t>( 1, static_cast<uint64_t>( p * samples + 0.5 ) );
+	uint64_t seen = 0;
+
+	for( std::size_t i = 0; i < BUCKETS; i++ ) {
+		seen += buckets[i];
+
+		if( seen >= rank ) {
+			const uint64_t upper = ( uint64_t(1) << ( i + 1 ) ) - 1;
+			return std::min( upper, max_ns );
+		}
+	}
+
+	return max_ns;
+}
+
+std::string InstrumentedFlashMemory::Snapshot::report( std::size_t top_pages ) const
+{
+	std::stringstream out;
+
+	report_operation( out, "read", read );
+	report_operation( out, "write", write );
+	report_operation( out, "erase", erase );
+	report_operation( out, "map_read", map_read );
+
+	out << "map_read hits: " << map_read_hits << '\n';
+
+	report_pages( out, "writes", page_writes, top_pages );
+	report_pages( out, "erases", page_erases, top_pages );
+
+	return out.str();
+}
+
+InstrumentedFlashMemory::InstrumentedFlashMemory( FlashMemoryInterface *mem_, std::size_t page_size )
+: mem( mem_ )
+{
+	set_page_size( page_size );
+}
+
+void InstrumentedFlashMemory::set_page_size( std::size_t page_size )
+{
+	std::lock_guard<std::mutex> lock( m_mutex );
+
+	m_stats.page_size = page_size;
+	m_stats.page_writes.clear();
+	m_stats.page_erases.clear();
+
+	if( page_size > 0 ) {
+		const std::size_t pages = ( mem->size() + page_size - 1 ) / page_size;
+		m_stats.page_writes.resize( pages );
+		m_stats.page_erases.resize( pages );
+	}
+}
+
+InstrumentedFlashMemory::Snapshot InstrumentedFlashMemory::snapshot() const
+{
+	std::lock_guard<std::mutex> lock( m_mutex );
+	return m_stats;
+}
+
+void InstrumentedFlashMemory::reset()
+{
+	std::lock_guard<std::mutex> lock( m_mutex );
+
+	Snapshot stats;
+	stats.page_size = m_stats.page_size;
+	stats.page_writes.resize( m_stats.page_writes.size() );
+	stats.page_erases.resize( m_stats.page_erases.size() );
+
+	m_stats = std::move( stats );
+}
+
+void InstrumentedFlashMemory::count_pages( std::vector<uint32_t> & pages, std::size_t address, std::size_t size )
+{
+	if( m_stats.page_size == 0 || size == 0 ) {
+		return;
+	}
+
+	const std::size_t last = ( address + size - 1 ) / m_stats.page_size;
+
+	for( std::size_t page = address / m_stats.page_size; page <= last && page < pages.size(); page++ ) {
+		pages[page]++;
+	}
+}
+
+std::size_t InstrumentedFlashMemory::write( std::size_t address, const std::byte *data, std::size_t size )
+{
+	const auto start = std::chrono::steady_clock::now();
+	const std::size_t ret = mem->write( address, data, size );
+	const uint64_t ns = elapsed_ns( start );
+
+	std::lock_guard<std::mutex> lock( m_mutex );
+	m_stats.write.count++;
+	m_stats.write.bytes += ret;
+	m_stats.write.latency.add( ns );
+	count_pages( m_stats.page_writes, address, size );
+
+	return ret;
+}
+
+std::size_t InstrumentedFlashMemory::read( std::size_t address, std::byte *data, std::size_t size )
+{
+	const auto start = std::chrono::steady_clock::now();
+	const std::size_t ret = mem->read( address, data, size );
+	const uint64_t ns = elapsed_ns( start );
+
+	std::lock_guard<std::mutex> lock( m_mutex );
+	m_stats.read.count++;
+	m_stats.read.bytes += ret;
+	m_stats.read.latency.add( ns );
+
+	return ret;
+}
+
+void InstrumentedFlashMemory::erase( std::size_t address, std::size_t size )
+{
+	const auto start = std::chrono::steady_clock::now();
+	mem->erase( address, size );
+	const uint64_t ns = elapsed_ns( start );
+
+	std::lock_guard<std::mutex> lock( m_mutex );
+	m_stats.erase.count++;
+	m_stats.erase.bytes += size;
+	m_stats.erase.latency.add( ns );
+	count_pages( m_stats.page_erases, address, size );
+}
+
+std::size_t InstrumentedFlashMemory::write_v( std::span<const WriteVec> vec )
+{
+	const auto start = std::chrono::steady_clock::now();
+	const std::size_t ret = mem->write_v( vec );
+	const uint64_t ns = elapsed_ns( start );
+
+	std::lock_guard<std::mutex> lock( m_mutex );
+	m_stats.write.count++;
+	m_stats.write.bytes += ret;
+	m_stats.write.latency.add( ns );
+
+	for( const auto & v : vec ) {
+		count_pages( m_stats.page_writes, v.address, v.size );
+	}
+
+	return ret;
+}
+
+std::size_t InstrumentedFlashMemory::read_v( std::span<const ReadVec> vec )
+{
+	const auto start = std::chrono::steady_clock::now();
+	const std::size_t ret = mem->read_v( vec );
+	const uint64_t ns = elapsed_ns( start );
+
+	std::lock_guard<std::mutex> lock( m_mutex );
+	m_stats.read.count++;
+	m_stats.read.bytes += ret;
+	m_stats.read.latency.add( ns );
+
+	return ret;
+}
+
+const std::byte* InstrumentedFlashMemory::map_read( std::size_t address, std::size_t size )
+{
+	const auto start = std::chrono::steady_clock::now();
+	const std::byte *ret = mem->map_read( address, size );
+	const uint64_t ns = elapsed_ns( start );
+
+	std::lock_guard<std::mutex> lock( m_mutex );
+	m_stats.map_read.count++;
+	m_stats.map_read.latency.add( ns );
+
+	if( ret ) {
+		m_stats.map_read_hits++;
+		m_stats.map_read.bytes += size;
+	}
+
+	return ret;
+}
+
+} // namespace SimpleFlashFs
@@ -0,0 +1,144 @@
+/*
+ * SimpleFlashFsInstrumentedFlashMemory.h
+ *
+ *  Created on: 17.10.2026
+ *      Author: martin
+ */
+
+#ifndef SRC_SIMPLEFLASHFSINSTRUMENTEDFLASHMEMORY_H_
+#define SRC_SIMPLEFLASHFSINSTRUMENTEDFLASHMEMORY_H_
+
+#include "SimpleFlashFsFlashMemoryInterface.h"
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace SimpleFlashFs {
+
+/**
+ * Wraps an other FlashMemoryInterface and counts what the filesystem
+ * does to the device: number of calls, bytes, map_read() hits,
+ * writes and erases per page and the latency of each call.
+ *
+ * The page histograms need the page size of the filesystem. The page
+ * number is the address divided by the page size, so the header is
+ * page 0.
+ */
+class InstrumentedFlashMemory : public FlashMemoryInterface
+{
+public:
+	/**
+	 * latency of the calls in nanoseconds.
+	 * Bucket i counts the calls taking [2^i, 2^(i+1)) ns,
+	 * so the percentiles are accurate to a factor of two.
+	 */
+	class LatencyHistogram
+	{
+	public:
+		static constexpr std::size_t BUCKETS = 48;
+
+	private:
+		std::array<uint64_t,BUCKETS> buckets {};
+		uint64_t samples = 0;
+		uint64_t max_ns = 0;
+
+	public:
+		void add( uint64_t ns );
+
+		uint64_t count() const {
+			return samples;
+		}
+
+		uint64_t max() const {
+			return max_ns;
+		}
+
+		/**
+		 * p in the range 0.0 to 1.0
+		 * returns the upper bound of the bucket, but not more than max()
+		 */
+		uint64_t percentile( double p ) const;
+	};
+
+	struct OperationStats
+	{
+		uint64_t count = 0; // number of calls
+		uint64_t bytes = 0;
+		LatencyHistogram latency {};
+	};
+
+	struct Snapshot
+	{
+		OperationStats read {};
+		OperationStats write {};
+		OperationStats erase {};
+		OperationStats map_read {};
+		uint64_t map_read_hits = 0;
+
+		std::size_t page_size = 0;
+		std::vector<uint32_t> page_writes {}; // index is the page number
+		std::vector<uint32_t> page_erases {};
+
+		/**
+		 * human readable summary, with the top_pages most written and erased pages
+		 */
+		std::string report( std::size_t top_pages = 10 ) const;
+	};
+
+protected:
+	FlashMemoryInterface *mem;
+	mutable std::mutex m_mutex;
+	Snapshot m_stats;
+
+public:
+	/**
+	 * page_size = 0 disables the page histograms
+	 */
+	InstrumentedFlashMemory( FlashMemoryInterface *mem_, std::size_t page_size = 0 );
+
+	void set_page_size( std::size_t page_size );
+
+	Snapshot snapshot() const;
+
+	/**
+	 * clears all counters, the page size is kept
+	 */
+	void reset();
+
+	FlashMemoryInterface *get_memory_interface() const {
+		return mem;
+	}
+
+	std::size_t size() const override {
+		return mem->size();
+	}
+
+	std::size_t write( std::size_t address, const std::byte *data, std::size_t size ) override;
+	std::size_t read( std::size_t address, std::byte *data, std::size_t size ) override;
+
+	void erase( std::size_t address, std::size_t size ) override;
+
+	// one call to the device, so counted once
+	std::size_t write_v( std::span<const WriteVec> vec ) override;
+	std::size_t read_v( std::span<const ReadVec> vec ) override;
+
+	bool can_map_read() const override {
+		return mem->can_map_read();
+	}
+
+	const std::byte* map_read( std::size_t address, std::size_t size ) override;
+
+	std::size_t get_bank_size() const override {
+		return mem->get_bank_size();
+	}
+
+private:
+	void count_pages( std::vector<uint32_t> & pages, std::size_t address, std::size_t size );
+};
+
+} // namespace SimpleFlashFs
+
+#endif /* SRC_SIMPLEFLASHFSINSTRUMENTEDFLASHMEMORY_H_ */
@@ -0,0 +1,186 @@
+/*
+ * SimpleFlashFsTimedFlashMemory.cc
+ *
+ *  Created on: 17.10.2026
+ *      Author: martin
+ */
+#include "SimpleFlashFsTimedFlashMemory.h"
+
+#include <chrono>
+#include <thread>
+
+namespace SimpleFlashFs {
+
+TimedFlashMemory::Profile TimedFlashMemory::Profile::fm25w256()
+{
+	Profile p;
+	p.name = "fm25w256";
+	p.page_size = 256;
+	p.erase_ns = 102'400;                   // no erase, the driver writes 0xFF over the bus
+	p.read_setup_ns = 1'600;                // opcode + 2 address bytes
+	p.bus_bytes_per_second = 20'000'000 / 8;
+	return p;
+}
+
+TimedFlashMemory::Profile TimedFlashMemory::Profile::at45db321e()
+{
+	Profile p;
+	p.name = "at45db321e";
+	p.page_size = 528;
+	p.page_program_ns = 2'000'000;          // tP typical
+	p.erase_ns = 7'000'000;                 // tPE typical
+	p.read_setup_ns = 600;                  // opcode + 3 address bytes + 4 dummy bytes
+	p.bus_bytes_per_second = 66'000'000 / 8;
+	return p;
+}
+
+TimedFlashMemory::Profile TimedFlashMemory::Profile::stm32h7()
+{
+	Profile p;
+	p.name = "stm32h7";
+	p.page_size = 32;                       // one flash word
+	p.page_program_ns = 16'000;
+	p.erase_ns = 2'000'000'000;             // 128kB sector typical
+	p.erase_granularity = 128 * 1024;
+	p.read_setup_ns = 0;
+	p.bus_bytes_per_second = 400'000'000;
+	return p;
+}
+
+std::optional<TimedFlashMemory::Profile> TimedFlashMemory::Profile::find( const std::string_view & name )
+{
+	for( auto p : { fm25w256(), at45db321e(), stm32h7() } ) {
+		if( name == p.name ) {
+			return p;
+		}
+	}
+
+	return {};
+}
+
+TimedFlashMemory::TimedFlashMemory( FlashMemoryInterface *mem_, const Profile & profile_, bool do_sleep_ )
+: mem( mem_ ),
+  profile( profile_ ),
+  do_sleep( do_sleep_ )
+{
+}
+
+void TimedFlashMemory::reset_clock()
+{
+	read_ns = 0;
+	write_ns = 0;
+	erase_ns = 0;
+	partial_erases = 0;
+}
+
+uint64_t TimedFlashMemory::transfer_ns( std::size_t size ) const
+{
+	if( profile.bus_bytes_per_second == 0 ) {
+		return 0;
+	}
+
+	return size * 1'000'000'000ull / profile.bus_bytes_per_second;
+}
+
+uint64_t TimedFlashMemory::read_time( std::size_t size ) const
+{
+	return profile.read_setup_ns + transfer_ns( size );
+}
+
+uint64_t TimedFlashMemory::write_time( std::size_t address, std::size_t size ) const
+{
+	uint64_t ns = transfer_ns( size );
+
+	if( profile.page_size > 0 && size > 0 ) {
+		const std::size_t pages = ( address + size - 1 ) / profile.page_size - address / profile.page_size + 1;
+		ns += pages * profile.page_program_ns;
+	}
+
+	return ns;
+}
+
+uint64_t TimedFlashMemory::erase_time( std::size_t address, std::size_t size )
+{
+	const std::size_t unit = profile.erase_granularity ? profile.erase_granularity : profile.page_size;
+
+	if( unit == 0 || size == 0 ) {
+		return 0;
+	}
+
+	if( address % unit != 0 || size % unit != 0 ) {
+		partial_erases++;
+	}
+
+	const std::size_t units = ( address + size - 1 ) / unit - address / unit + 1;
+
+	return units * profile.erase_ns;
+}
+
+void TimedFlashMemory::elapse( std::atomic<uint64_t> & clock, uint64_t ns )
+{
+	clock += ns;
+
+	if( do_sleep && ns > 0 ) {
+		std::this_thread::sleep_for( std::chrono::nanoseconds( ns ) );
+	}
+}
+
+std::size_t TimedFlashMemory::write( std::size_t address, const std::byte *data, std::size_t size )
+{
+	const std::size_t ret = mem->write( address, data, size );
+	elapse( write_ns, write_time( address, size ) );
+	return ret;
+}
+
+std::size_t TimedFlashMemory::read( std::size_t address, std::byte *data, std::size_t size )
+{
+	const std::size_t ret = mem->read( address, data, size );
+	elapse( read_ns, read_time( size ) );
+	return ret;
+}
+
+void TimedFlashMemory::erase( std::size_t address, std::size_t size )
+{
+	mem->erase( address, size );
+	elapse( erase_ns, erase_time( address, size ) );
+}
+
+std::size_t TimedFlashMemory::write_v( std::span<const WriteVec> vec )
+{
+	const std::size_t ret = mem->write_v( vec );
+	uint64_t ns = 0;
+
+	for( const auto & v : vec ) {
+		ns += write_time( v.address, v.size );
+	}
+
+	elapse( write_ns, ns );
+	return ret;
+}
+
+std::size_t TimedFlashMemory::read_v( std::span<const ReadVec> vec )
+{
+	const std::size_t ret = mem->read_v( vec );
+	uint64_t ns = 0;
+
+	for( const auto & v : vec ) {
+		ns += read_time( v.size );
+	}
+
+	elapse( read_ns, ns );
+	return ret;
+}
+
+const std::byte* TimedFlashMemory::map_read( std::size_t address, std::size_t size )
+{
+	const std::byte *ret = mem->map_read( address, size );
+
+	if( ret ) {
+		// the caller reads the data later, count it now
+		elapse( read_ns, read_time( size ) );
+	}
+
+	return ret;
+}
+
+} // namespace SimpleFlashFs
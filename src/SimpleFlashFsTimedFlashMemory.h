@@ -0,0 +1,146 @@
+/*
+ * SimpleFlashFsTimedFlashMemory.h
+ *
+ *  Created on: 17.10.2026
+ *      Author: martin
+ */
+
+#ifndef SRC_SIMPLEFLASHFSTIMEDFLASHMEMORY_H_
+#define SRC_SIMPLEFLASHFSTIMEDFLASHMEMORY_H_
+
+#include "SimpleFlashFsFlashMemoryInterface.h"
+
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+namespace SimpleFlashFs {
+
+/**
+ * Wraps an other FlashMemoryInterface and calculates, how long each
+ * call would take on a real device. The time is added to a virtual
+ * clock, optionally the call also sleeps that long.
+ *
+ * Only the time is simulated, the data is handled by the wrapped memory.
+ */
+class TimedFlashMemory : public FlashMemoryInterface
+{
+public:
+	struct Profile
+	{
+		const char *name = "";
+
+		std::size_t page_size = 0;             // program unit of the device
+		uint64_t page_program_ns = 0;          // per started page
+		uint64_t erase_ns = 0;                 // per erase unit
+		std::size_t erase_granularity = 0;     // erase unit in bytes, 0 = page_size
+		uint64_t read_setup_ns = 0;            // per read command
+		uint64_t bus_bytes_per_second = 0;     // transfer of the data, 0 = no costs
+
+		/**
+		 * Ramtron/Cypress FM25W256 32kB SPI FRAM, drive a.
+		 * No program delay, an erase is writing 0xFF, 20 MHz SPI.
+		 */
+		static Profile fm25w256();
+
+		/**
+		 * Adesto AT45DB321E 4MB DataFlash with 528 byte pages, drive b.
+		 * Typical times, page erase and program through the buffer, 66 MHz SPI.
+		 */
+		static Profile at45db321e();
+
+		/**
+		 * STM32H7 internal flash. 32 byte flash words, 128kB sectors,
+		 * reads through the AXI bus.
+		 */
+		static Profile stm32h7();
+
+		/**
+		 * returns a built-in profile: fm25w256, at45db321e or stm32h7
+		 */
+		static std::optional<Profile> find( const std::string_view & name );
+	};
+
+protected:
+	FlashMemoryInterface *mem;
+	Profile profile;
+	bool do_sleep = false;
+
+	std::atomic<uint64_t> read_ns = 0;
+	std::atomic<uint64_t> write_ns = 0;
+	std::atomic<uint64_t> erase_ns = 0;
+
+	// erases not covering whole erase units, a real device would erase more
+	std::atomic<uint64_t> partial_erases = 0;
+
+public:
+	TimedFlashMemory( FlashMemoryInterface *mem_, const Profile & profile_, bool do_sleep_ = false );
+
+	const Profile & get_profile() const {
+		return profile;
+	}
+
+	void set_sleep( bool do_sleep_ ) {
+		do_sleep = do_sleep_;
+	}
+
+	/**
+	 * simulated time of all calls since the last reset_clock()
+	 */
+	uint64_t get_elapsed_ns() const {
+		return read_ns + write_ns + erase_ns;
+	}
+
+	uint64_t get_read_ns() const {
+		return read_ns;
+	}
+
+	uint64_t get_write_ns() const {
+		return write_ns;
+	}
+
+	uint64_t get_erase_ns() const {
+		return erase_ns;
+	}
+
+	uint64_t get_partial_erases() const {
+		return partial_erases;
+	}
+
+	void reset_clock();
+
+	std::size_t size() const override {
+		return mem->size();
+	}
+
+	std::size_t write( std::size_t address, const std::byte *data, std::size_t size ) override;
+	std::size_t read( std::size_t address, std::byte *data, std::size_t size ) override;
+
+	void erase( std::size_t address, std::size_t size ) override;
+
+	std::size_t write_v( std::span<const WriteVec> vec ) override;
+	std::size_t read_v( std::span<const ReadVec> vec ) override;
+
+	bool can_map_read() const override {
+		return mem->can_map_read();
+	}
+
+	const std::byte* map_read( std::size_t address, std::size_t size ) override;
+
+	std::size_t get_bank_size() const override {
+		return mem->get_bank_size();
+	}
+
+protected:
+	uint64_t transfer_ns( std::size_t size ) const;
+	uint64_t read_time( std::size_t size ) const;
+	uint64_t write_time( std::size_t address, std::size_t size ) const;
+	uint64_t erase_time( std::size_t address, std::size_t size );
+
+	void elapse( std::atomic<uint64_t> & clock, uint64_t ns );
+};
+
+} // namespace SimpleFlashFs
+
+#endif /* SRC_SIMPLEFLASHFSTIMEDFLASHMEMORY_H_ */
@@ -13,6 +13,8 @@
 #include "../SimpleFlashFsFlashMemoryInterface.h"
 #include "../SimpleFlashFsFileInterface.h"
 #include "SimpleFlashFsPageSet.h"
+#include "SimpleFlashFsNameIndex.h"
+#include "SimpleFlashFsBitmap.h"
 #include "SimpleFlashFsHeaderInodeRange.h"
 #include "SimpleFlashFsLock.h"
 #include <CpputilsDebug.h>
@@ -20,8 +22,14 @@
 #include <string_utils.h>
 #include <bit>
 #include <span>
+#include <array>
+#include <limits>
 #include <optional>
+#include <utility>
+#include <memory>
+#include <type_traits>
 #include <mutex>
+#include <shared_mutex>
 
 namespace SimpleFlashFs {
 
@@ -59,6 +67,16 @@ struct Header
 		CRC32 = 0
 	};
 
+	// inodes are storing one page number per data page
+	static constexpr uint16_t VERSION_PAGE_LIST = 1;
+
+	// inodes are storing (first page, number of pages) extents
+	static constexpr uint16_t VERSION_EXTENTS = 2;
+
+	// like VERSION_EXTENTS, but large files are using
+	// single or double indirect page table pages
+	static constexpr uint16_t VERSION_PAGE_TABLES = 3;
+
 	Config::magic_string_type 	magic_string;
 	ENDIANNESS 					endianness{ENDIANNESS::LE};
 	uint16_t   					version = 0;
@@ -67,6 +85,11 @@ struct Header
 	uint32_t					max_inodes = 0;
 	uint16_t					max_path_len = 0;
 	CRC_CHECKSUM				crc_checksum_type{CRC_CHECKSUM::CRC32};
+
+	// pages per erase block of the device, 0 or 1: every page can be
+	// erased on its own. Older filesystems have a 0 at this position.
+	// See the erase block mode of the dynamic implementation.
+	uint32_t					erase_block_size = 0;
 };
 
 enum class InodeAttribute
@@ -92,6 +115,9 @@ struct Inode
 	using data_pages_value_type = uint32_t;
 	static constexpr uint32_t data_pages_type_size = sizeof(data_pages_value_type);
 
+	// first page + number of pages
+	static constexpr uint32_t data_extent_type_size = 2 * sizeof(data_pages_value_type);
+
 	struct data_page_t {
 		enum class State
 		{
@@ -107,6 +133,23 @@ struct Inode
 	// the index of data pages
 	typename Config::template vector_type<data_page_t> data_pages;
 
+	// VERSION_PAGE_TABLES only:
+	// 0: the inode stores extents
+	// 1: the inode stores the page numbers of indirect_pages
+	// 2: the inode stores the page numbers of double_indirect_pages
+	uint16_t				table_level{};
+
+	// page table pages, each one stores the page numbers of
+	// get_page_table_entries() data pages
+	typename Config::template page_table_vector_type<data_pages_value_type> indirect_pages;
+
+	// page table pages, storing the page numbers of indirect_pages
+	typename Config::template page_table_vector_type<data_pages_value_type> double_indirect_pages;
+
+	// the page numbers stored in indirect_pages, so a flush finds
+	// the unchanged page table pages without reading them again
+	typename Config::template page_table_vector_type<data_pages_value_type> indirect_entries;
+
 	// data, that can be stored inside the inode
 	// will only be filled if pages == 0, so data_pages is also
 	// zero and needs no space
@@ -132,6 +175,26 @@ public:
 	bool modified   {false};
 	bool append     {false}; // always write at the end of file
 
+	// see set_tail_buffer()
+	struct TailBuffer
+	{
+		bool enabled {false};
+		bool valid {false}; // page contains data, that is not programmed yet
+		std::size_t page_idx {0};
+		typename Config::tail_page_type page {}; // empty, until the first partial page is buffered
+	};
+
+	TailBuffer tail {};
+
+	// read only handle, pinning the pages of this inode version. See SimpleFlashFsBase::open_snapshot()
+	std::optional<uint64_t> snapshot_epoch {};
+
+	// bank, the allocator prefers for the pages of this writer. See SimpleFlashFsBase::get_writer_bank()
+	std::optional<uint32_t> bank {};
+
+	// returned by open(), the filesystem knows, that the inode is in use. See SimpleFlashFsBase::handle_opened()
+	bool registered {false};
+
 protected:
 	FS *fs;
 
@@ -146,6 +209,10 @@ public:
 	  pos( other.pos ),
 	  modified( other.modified ),
 	  append( other.append ),
+	  tail( std::move( other.tail ) ),
+	  snapshot_epoch( other.snapshot_epoch ),
+	  bank( other.bank ),
+	  registered( other.registered ),
 	  fs( other.fs )
 	{
 		other.fs = nullptr;
@@ -165,6 +232,19 @@ public:
 			for( auto page : inode.data_pages ) {
 				fs->free_unwritten_pages(page.page_id);
 			}
+
+			if( bank ) {
+				fs->release_writer_bank( *bank );
+			}
+
+			if( registered ) {
+				fs->handle_closed( this );
+			}
+
+			// last, the pages may be erased now
+			if( snapshot_epoch ) {
+				fs->release_snapshot( *snapshot_epoch );
+			}
 		}
 	}
 
@@ -172,11 +252,27 @@ public:
 	FileHandle & operator=( const FileHandle & other ) = delete;
 
 	FileHandle & operator=( FileHandle && other ) {
+		if( fs && bank ) {
+			fs->release_writer_bank( *bank );
+		}
+
+		if( fs && registered ) {
+			fs->handle_closed( this );
+		}
+
+		if( fs && snapshot_epoch ) {
+			fs->release_snapshot( *snapshot_epoch );
+		}
+
 		inode = other.inode;
 		page = other.page;
 		pos = other.pos;
 		modified = other.modified;
 		append = other.append;
+		tail = std::move( other.tail );
+		snapshot_epoch = other.snapshot_epoch;
+		bank = other.bank;
+		registered = other.registered;
 		fs = other.fs;
 
 		other.fs = nullptr;
@@ -200,6 +296,13 @@ public:
 		return fs->read( this, data, size );
 	}
 
+	/**
+	 * zero copy read, see SimpleFlashFsBase::read_spans()
+	 */
+	template <class F> std::size_t read_spans( std::size_t size, F f ) {
+		return fs->read_spans( this, size, f );
+	}
+
 	bool flush() override {
 		return fs->flush(this);
 	}
@@ -222,6 +325,13 @@ public:
 
 	bool seek( std::size_t pos_ ) override {
 
+		// seek away from the buffered page
+		if( tail.valid && pos_ / fs->get_header().page_size != tail.page_idx ) {
+			if( !fs->write_tail_buffer( this ) ) {
+				return false;
+			}
+		}
+
 		if( pos_ < inode.file_len || pos_ == inode.file_len ) {
 			pos = pos_;
 			return true;
@@ -236,6 +346,10 @@ public:
 		return true;
 	}
 
+	/**
+	 * a copy without the filesystem and without the tail buffer. The destructor
+	 * of the copy does not flush, nor release the bank or the snapshot.
+	 */
 	FileHandle get_disconnected_copy() const {
 		FileHandle ret{};
 
@@ -244,6 +358,8 @@ public:
 		ret.pos = pos;
 		ret.modified = modified;
 		ret.append = append;
+		ret.snapshot_epoch = snapshot_epoch;
+		ret.bank = bank;
 
 		return ret;
 	}
@@ -277,7 +393,11 @@ public:
 	 * not keep growing with stale whitespace padding.
 	 */
 	bool truncate( std::size_t new_size ) override {
-		if( fs == nullptr ) {
+		if( fs == nullptr || snapshot_epoch ) {
+			return false;
+		}
+
+		if( !fs->write_tail_buffer( this ) ) {
 			return false;
 		}
 
@@ -305,8 +425,8 @@ public:
 			const std::size_t page_size = fs->get_header().page_size;
 			const std::size_t needed_pages =
 				( new_size + page_size - 1 ) / page_size;
-			if( needed_pages < inode.data_pages.size() ) {
-				inode.data_pages.resize( needed_pages );
+			if( needed_pages < inode.count_valid_data_pages() ) {
+				fs->drop_data_pages( this, needed_pages );
 			}
 		}
 
@@ -322,6 +442,32 @@ public:
 	}
 	// AI generated by GitHub Copilot Claude Opus 4.7 END
 
+	/**
+	 * Collect partial page writes in RAM. The page is programmed
+	 * when it is full, on flush() or on seek() to another page,
+	 * so small appends do not program a new page each time.
+	 * Fails, if Config::USE_TAIL_BUFFER is false.
+	 */
+	bool set_tail_buffer( bool enable ) {
+		if( fs == nullptr ) {
+			return false;
+		}
+
+		if constexpr( !Config::USE_TAIL_BUFFER ) {
+			if( enable ) {
+				return false;
+			}
+		}
+
+		tail.enabled = enable;
+
+		if( !enable ) {
+			return fs->write_tail_buffer( this );
+		}
+
+		return true;
+	}
+
 	void disconnect() {
 		fs = nullptr;
 	}
@@ -391,6 +537,11 @@ public:
 
 protected:
 	using data_page_t = Inode<Config>::data_page_t;
+	using data_pages_value_type = Inode<Config>::data_pages_value_type;
+	using page_table_t = Config::template page_table_vector_type<data_pages_value_type>;
+
+	// maximum number of pages passed to one write_v() or read_v() call
+	static constexpr std::size_t MAX_PAGES_PER_IO = 16;
 
 	class InodeVersionStore
 	{
@@ -512,9 +663,17 @@ protected:
 	header_t header {};
 	FlashMemoryInterface *mem;
 
-	// to be replaced by a static version later
-	PageSet<Config> allocated_unwritten_pages;
-	PageSet<Config> free_data_pages;
+	// inode pages, that are allocated, but not written yet
+	Bitmap<Config> allocated_unwritten_pages;
+
+	// inode pages containing a valid inode, or that cannot be read.
+	// Built by the init() implementations, that are reading all inode pages
+	// anyway. Until then free inode pages are searched by reading them.
+	Bitmap<Config> used_inode_pages;
+	bool used_inode_pages_valid = false;
+
+	// free data pages, filled by the init() implementations
+	FreePageBitmap<Config> free_data_pages;
 
 	uint64_t max_inode_number = 0;
 
@@ -522,6 +681,42 @@ protected:
 	// stack of the function, because it can be really large.
 	InodeVersionStore iv_storage;
 
+	/**
+	 * Scratch buffer of find_file_unmapped() and find_file_mapped().
+	 * With a real mutex_type several threads can scan at the same time,
+	 * so each scan allocates its own buffer. A single threaded Config
+	 * reuses iv_storage.
+	 */
+	class ScanBuffer
+	{
+		std::unique_ptr<InodeVersionStore> own;
+		InodeVersionStore *storage;
+
+	public:
+		ScanBuffer( InodeVersionStore & shared ) {
+			if constexpr( std::is_same_v<typename Config::mutex_type, NullMutex> ) {
+				storage = &shared;
+				storage->clear();
+			} else {
+				own = std::make_unique<InodeVersionStore>();
+				storage = own.get();
+			}
+		}
+
+		InodeVersionStore & operator*() {
+			return *storage;
+		}
+
+		InodeVersionStore * operator->() {
+			return storage;
+		}
+	};
+
+	// file name => latest inode page. Built by the init() implementations,
+	// that are scanning all inodes anyway. Until then it is invalid and
+	// find_file() scans all inodes.
+	NameIndex<Config> name_index;
+
 	DefaultHeaderInodeRange<Config> default_header_inode_range{header};
 	HeaderInodeRangeInterface<Config>* header_inode_range = &default_header_inode_range;
 
@@ -533,6 +728,9 @@ protected:
 	// Strategy:
 	//   * Locks are taken at the narrowest possible scope, never
 	//     held across blocking I/O or across other locks.
+	//   * The locks are not recursive. Lookups take them shared
+	//     (std::shared_lock), everything that modifies the
+	//     protected data takes them exclusive.
 	//   * The read paths (read, read_page, read_page_mapped,
 	//     get_inode_file_name_mapped) take NO locks at all - they
 	//     are designed to be safe to call from any thread while a
@@ -548,12 +746,67 @@ protected:
 	//   m_max_inode_number_mutex
 	//     < m_inode_meta_mutex
 	//     < m_free_data_pages_mutex
-	//     < m_mem_mutex
-	mutable typename Config::mutex_type m_inode_meta_mutex;       // iv_storage + header_inode_range + allocated_unwritten_pages
+	//     < m_name_index_mutex
+	//     < m_bank_mutex (ascending bank number)
+	mutable typename Config::mutex_type m_inode_meta_mutex;       // header_inode_range + allocated_unwritten_pages + used_inode_pages
 	mutable typename Config::mutex_type m_free_data_pages_mutex;  // free_data_pages
 	mutable typename Config::mutex_type m_max_inode_number_mutex; // max_inode_number
-	mutable typename Config::mutex_type m_mem_mutex;              // mem->write / mem->erase (NOT mem->read)
+	mutable std::array<typename Config::mutex_type,Config::MAX_BANKS> m_bank_mutex; // mem->write / mem->erase (NOT mem->read), see BankLock
 	// AI generated by GitHub Copilot Claude Opus 4.7 END
+	mutable typename Config::mutex_type m_name_index_mutex;       // name_index
+
+	static_assert( Config::MAX_BANKS >= 1 && Config::MAX_BANKS <= 32, "the banks of a BankLock are a 32 bit mask" );
+
+	// number of FileHandles writing to each bank, guarded by m_free_data_pages_mutex
+	std::array<uint32_t,Config::MAX_BANKS> m_bank_writers {};
+
+	/**
+	 * locks the banks of a get_bank_mask() in ascending order,
+	 * so two writers touching several banks cannot deadlock.
+	 */
+	class BankLock
+	{
+		const SimpleFlashFsBase & fs;
+		const uint32_t mask;
+
+	public:
+		BankLock( const SimpleFlashFsBase & fs_, uint32_t mask_ )
+		: fs( fs_ ),
+		  mask( mask_ )
+		{
+			for( std::size_t i = 0; i < Config::MAX_BANKS; i++ ) {
+				if( mask & ( uint32_t(1) << i ) ) {
+					fs.m_bank_mutex[i].lock();
+				}
+			}
+		}
+
+		~BankLock()
+		{
+			for( std::size_t i = Config::MAX_BANKS; i > 0; i-- ) {
+				if( mask & ( uint32_t(1) << ( i - 1 ) ) ) {
+					fs.m_bank_mutex[i - 1].unlock();
+				}
+			}
+		}
+
+		BankLock( const BankLock & other ) = delete;
+		BankLock & operator=( const BankLock & other ) = delete;
+	};
+
+	// Open snapshots, see open_snapshot(). Each commit, that replaces
+	// pages, increments the epoch. A snapshot pins the epoch it was
+	// opened at, pages replaced later are kept until it is released.
+	struct RetiredPage
+	{
+		uint64_t epoch = 0;
+		uint32_t page = 0;
+	};
+
+	mutable typename Config::mutex_type m_snapshot_mutex;         // never held together with an other lock
+	uint64_t m_snapshot_epoch = 0;
+	typename Config::template snapshot_vector_type<uint64_t> m_snapshot_pins;
+	typename Config::template snapshot_vector_type<RetiredPage> m_retired_pages; // ordered by epoch
 
 public:
 	SimpleFlashFsBase( FlashMemoryInterface *mem_interface_ )
@@ -572,12 +825,48 @@ public:
 
 	file_handle_t open( const Config::string_view_type & name, std::ios_base::openmode mode );
 
+	/**
+	 * Config::USE_SNAPSHOTS only.
+	 * Opens the latest stored version of an existing file read only.
+	 * The handle keeps reading this version, even if an other handle
+	 * writes a new version of the file in the meantime. Writers do not
+	 * have to wait for the reader, the replaced pages are erased after
+	 * all snapshots, that could read them, are closed.
+	 *
+	 * Data, that is not flushed by a writer, is not visible.
+	 * Keep snapshots short lived, the kept pages cannot be reused.
+	 */
+	file_handle_t open_snapshot( const Config::string_view_type & name );
+
 	std::size_t write( file_handle_t* file, const std::byte *data, std::size_t size );
 
 	std::size_t read( file_handle_t* file, std::byte *data, std::size_t size );
 
+	/**
+	 * Reads up to size bytes from the current position without copying them.
+	 * f( std::span<const std::byte> ) is called for each piece of data,
+	 * usually once per page, and can return false to stop reading.
+	 * The span is only valid during the call.
+	 *
+	 * If the memory can be mapped, the spans point directly into the flash,
+	 * otherwise each page is read into one buffer first.
+	 *
+	 * Returns the number of bytes passed to f. The file position is moved
+	 * forward by this amount.
+	 */
+	template <class F> std::size_t read_spans( file_handle_t* file, std::size_t size, F f );
+
 	bool flush( file_handle_t* file );
 
+	/**
+	 * Group commit: flushes all files at once.
+	 * The inode pages are allocated in one pass and written back to back,
+	 * the old inode versions and unused data pages are erased afterwards
+	 * in one combined pass.
+	 * Returns false if at least one file could not be flushed.
+	 */
+	bool flush_all( std::span<file_handle_t* const> files );
+
 	bool delete_file( file_handle_t* file );
 
 	bool rename_file( file_handle_t* file, const std::string_view & new_file_name );
@@ -598,7 +887,52 @@ public:
 	}
 
 	std::size_t get_number_of_free_data_pages() const {
-		return free_data_pages.size();
+		std::size_t count = 0;
+
+		{
+			std::shared_lock<typename Config::mutex_type> lock( m_free_data_pages_mutex );
+			count = free_data_pages.size();
+		}
+
+		return count + get_number_of_pending_erase_pages();
+	}
+
+	/**
+	 * number of inode pages, that are neither used nor allocated.
+	 * 0 if the implementation does not keep track of the used inode pages.
+	 */
+	std::size_t get_number_of_free_inode_pages() const {
+		std::shared_lock<typename Config::mutex_type> lock( m_inode_meta_mutex );
+
+		if( !used_inode_pages_valid ) {
+			return 0;
+		}
+
+		std::size_t count = 0;
+
+		for( uint32_t page = 0; page < header.max_inodes; page++ ) {
+			if( !used_inode_pages.test( page ) && !allocated_unwritten_pages.test( page ) ) {
+				count++;
+			}
+		}
+
+		return count;
+	}
+
+	/**
+	 * number of obsolete data pages, that are not erased yet.
+	 * See erase_pages() and reclaim_pages_now()
+	 */
+	virtual std::size_t get_number_of_pending_erase_pages() const {
+		return 0;
+	}
+
+	/**
+	 * number of replaced pages, that are kept for open snapshots
+	 */
+	std::size_t get_number_of_snapshot_pages() const {
+		std::shared_lock<typename Config::mutex_type> lock( m_snapshot_mutex );
+		return m_retired_pages.size();
 	}
 
 	/**
@@ -655,6 +989,14 @@ protected:
 	Config::page_type inode2page( const Inode<Config> & inode );
 
 	file_handle_t find_file( const Config::string_view_type & name ) {
+		if( auto handle = find_file_indexed(name); handle ) {
+			return std::move(*handle);
+		}
+
+		if( auto handle = find_file_lazy(name); handle ) {
+			return std::move(*handle);
+		}
+
 		if( mem->can_map_read() ) {
 			return find_file_mapped(name);
 		}
@@ -664,6 +1006,111 @@ protected:
 	file_handle_t find_file_mapped( const Config::string_view_type & name );
 	file_handle_t find_file_unmapped( const Config::string_view_type & name );
 
+	/**
+	 * lookup via name_index
+	 * returns an empty optional, if the index cannot answer the question.
+	 * An invalid file handle means: file does not exist.
+	 */
+	std::optional<file_handle_t> find_file_indexed( const Config::string_view_type & name );
+
+	/**
+	 * lookup, while the inode pages are not read completely.
+	 * Same return values as find_file_indexed().
+	 * See the lazy mount of the dynamic implementation.
+	 */
+	virtual std::optional<file_handle_t> find_file_lazy( const Config::string_view_type & /*name*/ ) {
+		return {};
+	}
+
+	/**
+	 * reads and crc checks an inode page. If the memory is mapped
+	 * no data is copied, otherwise the page is read into buffer.
+	 * Returns an empty span on error.
+	 */
+	std::span<const std::byte> read_inode_page( uint32_t idx, Config::page_type & buffer );
+
+	void inode_page_written( uint32_t page ) {
+		std::lock_guard<typename Config::mutex_type> lock( m_inode_meta_mutex );
+		used_inode_pages.set( page );
+		allocated_unwritten_pages.reset( page );
+		page_changed( page );
+	}
+
+	/**
+	 * Called after an inode page was written, or after a page was erased
+	 * and marked as free. m_inode_meta_mutex (inode pages) or
+	 * m_free_data_pages_mutex (data pages) is held, so the calls come in
+	 * the same order as the allocations. See the dynamic checkpoint.
+	 */
+	virtual void page_changed( uint32_t /*page*/ ) {
+	}
+
+	/**
+	 * Called after a page was erased, with the same lock held as
+	 * for page_changed(). See the wear leveling of the dynamic implementation.
+	 */
+	virtual void page_erased( uint32_t /*page*/ ) {
+	}
+
+	/**
+	 * Called after a page was allocated, before it is written.
+	 * No lock is held. See the dynamic checkpoint.
+	 */
+	virtual void page_allocated( uint32_t /*page*/ ) {
+	}
+
+	/**
+	 * Called before a page is allocated, or an inode page is erased,
+	 * without holding a lock. See the lazy mount of the dynamic implementation.
+	 */
+	virtual void prepare_modification() {
+	}
+
+	/**
+	 * true if the implementation can handle header.erase_block_size > 1,
+	 * otherwise init() refuses such a filesystem.
+	 */
+	virtual bool supports_erase_blocks() const {
+		return false;
+	}
+
+	/**
+	 * Called before an unchanged page table page is reused by the next
+	 * inode version. Returning true writes it to a new page.
+	 * See the segment cleaner of the dynamic implementation.
+	 */
+	virtual bool page_is_relocated( uint32_t /*page*/ ) const {
+		return false;
+	}
+
+	/**
+	 * Called by open(), after the file was found, and by the first flush()
+	 * of a new file, when it got its inode number. No lock is held.
+	 * Returning false means, that a newer version of the inode was written
+	 * meanwhile, the file is looked up again.
+	 * See the segment cleaner of the dynamic implementation.
+	 */
+	virtual bool handle_opened( file_handle_t * /*file*/ ) {
+		return true;
+	}
+
+	/**
+	 * Called, when a handle returned by open() is closed.
+	 */
+	virtual void handle_closed( file_handle_t * /*file*/ ) {
+	}
+
+	/**
+	 * find_file() for open() and open_snapshot(), the handle is registered.
+	 * See handle_opened()
+	 */
+	file_handle_t find_open_file( const Config::string_view_type & name );
+
+	// keep name_index up to date
+	void name_index_insert( const file_handle_t & file );
+	void name_index_remove( const file_handle_t & file );
+	void name_index_invalidate();
+
 	file_handle_t get_inode( const Config::page_type & data, bool do_error_corrections = true ) {
 		return get_inode( std::span<const std::byte>(data.data(),data.size()), do_error_corrections );
 	}
@@ -671,94 +1118,386 @@ protected:
 	file_handle_t get_inode( const std::span<const std::byte> & data, bool do_error_corrections = true );
 
 	file_handle_t allocate_free_inode_page() {
-		if( mem->can_map_read() ) {
-			return allocate_free_inode_page_mapped();
+		auto page = allocate_free_inode_page_number();
+
+		if( !page ) {
+			return {};
 		}
-		return allocate_free_inode_page_unmapped();
-	}
 
-	file_handle_t allocate_free_inode_page_mapped();
-	file_handle_t allocate_free_inode_page_unmapped();
+		file_handle_t fh_ret(this);
+		fh_ret.page = *page;
+		return fh_ret;
+	}
 
 	void free_unwritten_pages( uint32_t page ) {
 		// AI generated by GitHub Copilot Claude Opus 4.7 START
 		std::lock_guard<typename Config::mutex_type> lock( m_inode_meta_mutex );
 		// AI generated by GitHub Copilot Claude Opus 4.7 END
-		allocated_unwritten_pages.erase(page);
+		allocated_unwritten_pages.reset(page);
 	}
 
 	std::optional<uint32_t> allocate_free_inode_page_number() {
-		if( mem->can_map_read() ) {
-			return allocate_free_inode_page_number_mapped();
+		prepare_modification();
+
+		std::optional<uint32_t> page;
+
+		if( used_inode_pages_valid ) {
+			page = allocate_free_inode_page_number_bitmap();
+		} else if( mem->can_map_read() ) {
+			page = allocate_free_inode_page_number_mapped();
+		} else {
+			page = allocate_free_inode_page_number_unmapped();
 		}
-		return allocate_free_inode_page_number_unmapped();
-	}
 
-	std::optional<uint32_t> allocate_free_inode_page_number_mapped();
-	std::optional<uint32_t> allocate_free_inode_page_number_unmapped();
+		if( page ) {
+			page_allocated( *page );
+		}
 
-	/**
-	 * chooses a free data page from free_data_pages and removes it from the set. 
-	 * Returns nullopt if no free page is available.
-	 * 
-	 * Overloead this function if you want to implement wear leveling or something like that. 
-	 * The default implementation just returns the first element from the free_data_pages set,
-	 * which is the lowest page number.
-	 */
-	virtual std::optional<uint32_t> allocate_free_data_page();
-	std::optional<uint32_t> allocate_free_data_page( const file_handle_t *file );
+		return page;
+	}
 
 	/**
-	 * returns the maximum size of data, that fits inside an spacific inode
-	 * depends, on the filename len
+	 * allocates pages.size() inode pages at once.
+	 * Returns the number of allocated pages.
 	 */
-	std::size_t get_inode_data_space_size( const file_handle_t* file ) const;
+	std::size_t allocate_free_inode_page_numbers( std::span<uint32_t> pages ) {
+		prepare_modification();
 
-	/**
-	 * The length of the filename is dynamic, so we have to calculate
-	 * it per file.
-	 */
-	std::size_t get_max_inode_data_pages( const file_handle_t* file ) const;
+		if( used_inode_pages_valid ) {
+			const std::size_t count = allocate_free_inode_page_numbers_bitmap( pages );
 
-	virtual void erase_inode_and_unused_pages( file_handle_t & inode_to_erase, file_handle_t & next_inode_version );
+			for( std::size_t i = 0; i < count; i++ ) {
+				page_allocated( pages[i] );
+			}
 
+			return count;
+		}
 
-	bool write_page( file_handle_t* file,
-			const std::basic_string_view<std::byte> & page,
-			typename Inode<Config>::data_page_t & page_meta );
+		// no bitmap, each allocation has to read the inode pages
+		std::size_t count = 0;
 
-	bool write_page( file_handle_t* file,
-			const Config::page_type & page,
-			typename Inode<Config>::data_page_t & page_meta ) {
+		for( ; count < pages.size(); count++ ) {
+			auto page = allocate_free_inode_page_number();
 
-		return write_page( file,
-				std::basic_string_view<std::byte>( page.data(), page.size() ),
-				page_meta );
+			if( !page ) {
+				break;
+			}
+
+			pages[count] = *page;
+		}
+
+		return count;
 	}
 
-	bool write_meta_page( file_handle_t* file,
-			const Config::page_type & page,
-			 uint32_t idx ) {
+	std::optional<uint32_t> allocate_free_inode_page_number_bitmap() {
+		uint32_t page = 0;
 
-		data_page_t page_meta { idx, data_page_t::State::New };
+		if( allocate_free_inode_page_numbers_bitmap( std::span<uint32_t>( &page, 1 ) ) == 1 ) {
+			return page;
+		}
 
-		return write_page( file,
-				std::basic_string_view<std::byte>( page.data(), page.size() ),
-				page_meta );
+		return {};
 	}
 
-	bool allocate_new_data_pages( std::size_t page_idx, file_handle_t* file );
+	std::size_t allocate_free_inode_page_numbers_bitmap( std::span<uint32_t> pages );
+	std::optional<uint32_t> allocate_free_inode_page_number_mapped();
+	std::optional<uint32_t> allocate_free_inode_page_number_unmapped();
 
 	/**
-	 * replaces the existing page at data_pages with a new allocated page
+	 * has to be called by the init() implementations, after reading all inode pages.
+	 * used_inode_pages has to contain all pages, that cannot be allocated.
 	 */
-	bool allocate_new_data_page_at( std::size_t page_idx, file_handle_t* file );
+	void set_used_inode_pages_valid() {
+		std::lock_guard<typename Config::mutex_type> lock( m_inode_meta_mutex );
+		used_inode_pages_valid = true;
+	}
+
+	/**
+	 * erases an inode page and marks it as free
+	 */
+	virtual void erase_inode_page( uint32_t page );
+
+	/**
+	 * erases an inode or data page and marks it as free
+	 */
+	virtual void erase_and_free_page( uint32_t page );
+
+	/**
+	 * Called if no free data page is left. Implementations, that are
+	 * deferring erase_pages(), have to erase up to count pending pages now.
+	 * Returns true if data pages became free.
+	 */
+	virtual bool reclaim_pages_now( std::size_t /*count*/ ) {
+		return false;
+	}
+
+	/**
+	 * calls reclaim_pages_now(), if free_data_pages is empty
+	 */
+	void reclaim_if_no_free_data_pages( std::size_t count ) {
+		prepare_modification();
+
+		bool empty = false;
+
+		{
+			std::shared_lock<typename Config::mutex_type> lock( m_free_data_pages_mutex );
+			empty = free_data_pages.empty();
+		}
+
+		if( empty ) {
+			reclaim_pages_now( count );
+		}
+	}
+
+	/**
+	 * chooses a free data page from free_data_pages and removes it from the set. 
+	 * Returns nullopt if no free page is available.
+	 * 
+	 * Overloead this function if you want to implement wear leveling or something like that. 
+	 * The default implementation just returns the first element from the free_data_pages set,
+	 * which is the lowest page number.
+	 */
+	virtual std::optional<uint32_t> allocate_free_data_page();
+	std::optional<uint32_t> allocate_free_data_page( file_handle_t *file );
+
+	/**
+	 * allocate_free_data_page() for a page, that replaces a page of file.
+	 * On a memory with banks the page is taken from the bank of the writer.
+	 */
+	std::optional<uint32_t> allocate_writer_data_page( file_handle_t *file );
+
+	/**
+	 * chooses up to count physically contiguous free data pages and removes them from the set.
+	 * Pages directly behind near_page are preferred, so a file grows in place.
+	 * Returns at least one page, or nullopt if no free page is available.
+	 *
+	 * Overload this function together with allocate_free_data_page().
+	 */
+	virtual std::optional<PageRun> allocate_free_data_page_run( uint32_t near_page, uint32_t count );
+
+	/**
+	 * number of banks of the memory, see FlashMemoryInterface::get_bank_size()
+	 */
+	std::size_t get_number_of_banks() const;
+
+	/**
+	 * returns the locks of the banks, that the address range touches.
+	 * Bit i is m_bank_mutex[i].
+	 */
+	uint32_t get_bank_mask( std::size_t address, std::size_t size ) const;
+	uint32_t get_bank_mask( std::span<const FlashMemoryInterface::WriteVec> vec ) const;
+
+	/**
+	 * Returns true, if concurrent writers should get their pages from different banks.
+	 * Overload this function, if the allocator places the pages by an other rule.
+	 */
+	virtual bool steer_writers_to_banks() const;
+
+	/**
+	 * Chooses the bank with the fewest writers, when the file allocates
+	 * its first page. The file keeps the bank until it is closed.
+	 */
+	uint32_t get_writer_bank( file_handle_t *file );
+	void release_writer_bank( uint32_t bank );
+
+	/**
+	 * first free data page candidate of a bank
+	 */
+	uint32_t get_first_page_of_bank( uint32_t bank ) const;
+
+	/**
+	 * near_page for allocate_free_data_page_run(). A file grows in
+	 * place, as long as it stays in the bank of the writer.
+	 */
+	uint32_t get_writer_near_page( file_handle_t *file, uint32_t near_page );
+
+	/**
+	 * returns the maximum size of data, that fits inside an spacific inode
+	 * depends, on the filename len
+	 */
+	std::size_t get_inode_data_space_size( const file_handle_t* file ) const;
+
+	/**
+	 * The length of the filename is dynamic, so we have to calculate
+	 * it per file.
+	 * Returns the number of entries the inode can store:
+	 * pages for VERSION_PAGE_LIST, extents for VERSION_EXTENTS,
+	 * data pages reachable by double indirect page tables for VERSION_PAGE_TABLES
+	 */
+	std::size_t get_max_inode_data_pages( const file_handle_t* file ) const;
+
+	/**
+	 * number of entries the data_pages list needs inside the inode
+	 */
+	std::size_t get_inode_data_pages_entries( const file_handle_t* file ) const;
+
+	/**
+	 * number of (first page, number of pages) extents of data_pages
+	 */
+	std::size_t count_data_pages_extents( const file_handle_t* file ) const;
+
+	/**
+	 * true if the inode cannot store one more data page
+	 */
+	bool inode_data_pages_full( const file_handle_t* file ) const;
+
+	bool use_extents() const {
+		return header.version >= header_t::VERSION_EXTENTS;
+	}
+
+	bool use_page_tables() const {
+		return Config::USE_PAGE_TABLES && header.version >= header_t::VERSION_PAGE_TABLES;
+	}
+
+	/**
+	 * number of page numbers, that fits into one page table page
+	 */
+	std::size_t get_page_table_entries() const {
+		return (header.page_size - get_checksum_size()) / inode_t::data_pages_type_size;
+	}
+
+	/**
+	 * VERSION_PAGE_TABLES: writes the page table pages of the inode
+	 * and selects the table level. Only changed table pages are written
+	 * to new pages. Has to be called before inode2page().
+	 */
+	bool write_page_tables( file_handle_t* file );
+
+	/**
+	 * writes one level of page table pages.
+	 * entry(i) returns the page number of the i'th entry,
+	 * old_entries are the page numbers stored in old_tables.
+	 */
+	template <class F>
+	bool write_page_table_level( file_handle_t* file,
+			const page_table_t & old_tables,
+			const page_table_t & old_entries,
+			std::size_t entries,
+			F entry,
+			page_table_t & new_tables );
+
+	/**
+	 * reads count page numbers from the page table pages tables
+	 * and appends them to entries
+	 */
+	bool read_page_table_level( const page_table_t & tables, std::size_t count, page_table_t & entries );
+
+	virtual void erase_inode_and_unused_pages( file_handle_t & inode_to_erase, file_handle_t & next_inode_version );
+
+	/**
+	 * adds all pages of inode_to_erase, that are not used by next_inode_version,
+	 * and the inode page itself to pages_to_erase
+	 */
+	void collect_unused_pages( const file_handle_t & inode_to_erase,
+			const file_handle_t & next_inode_version,
+			PageSet<Config> & pages_to_erase );
+
+	/**
+	 * erases the pages and marks them as free
+	 */
+	virtual void erase_pages( PageSet<Config> & pages_to_erase );
+
+	/**
+	 * erase_pages() for pages of a replaced inode version.
+	 * If snapshots are open, the pages are kept until they are released.
+	 */
+	void retire_pages( PageSet<Config> & pages_to_erase );
+
+	/**
+	 * returns the epoch, that has to be passed to release_snapshot()
+	 */
+	uint64_t pin_snapshot();
+
+	/**
+	 * erases the pages, that are not required by an other snapshot anymore
+	 */
+	void release_snapshot( uint64_t epoch );
+
+	/**
+	 * flush() of a file, that was never written before
+	 */
+	bool write_first_inode_version( file_handle_t* file );
+
+	/**
+	 * flush() of an already stored file. The next version of the inode
+	 * is written to new_page, old_file receives the current version.
+	 */
+	bool write_next_inode_version( file_handle_t* file, uint32_t new_page, file_handle_t & old_file );
+
+
+	bool write_page( file_handle_t* file,
+			const std::basic_string_view<std::byte> & page,
+			typename Inode<Config>::data_page_t & page_meta );
+
+	/**
+	 * writes count complete pages, starting at the current file position,
+	 * with one FlashMemoryInterface::write_v() call.
+	 * count has to be <= MAX_PAGES_PER_IO
+	 */
+	bool write_full_pages( file_handle_t* file, const std::byte *data, std::size_t count );
+
+	/**
+	 * reads count complete pages, starting at the current file position,
+	 * with one FlashMemoryInterface::read_v() call.
+	 * count has to be <= MAX_PAGES_PER_IO
+	 */
+	bool read_full_pages( file_handle_t* file, std::byte *data, std::size_t count );
+
+	bool write_page( file_handle_t* file,
+			const Config::page_type & page,
+			typename Inode<Config>::data_page_t & page_meta ) {
+
+		return write_page( file,
+				std::basic_string_view<std::byte>( page.data(), page.size() ),
+				page_meta );
+	}
+
+	bool write_meta_page( file_handle_t* file,
+			const Config::page_type & page,
+			 uint32_t idx ) {
+
+		data_page_t page_meta { idx, data_page_t::State::New };
+
+		return write_page( file,
+				std::basic_string_view<std::byte>( page.data(), page.size() ),
+				page_meta );
+	}
+
+	bool allocate_new_data_pages( std::size_t page_idx, file_handle_t* file );
+
+	/**
+	 * replaces the existing page at data_pages with a new allocated page
+	 */
+	bool allocate_new_data_page_at( std::size_t page_idx, file_handle_t* file );
+
+	/**
+	 * A stored page was replaced by a new one. Keep the old page as a deleted
+	 * entry, so it is erased after the next flush(), like allocate_new_data_page_at() does.
+	 */
+	void keep_replaced_data_page( file_handle_t* file, uint32_t page_id );
+
+	/**
+	 * Marks the data pages from index keep on as deleted. The current inode version
+	 * still uses them, so they are erased after the next flush().
+	 */
+	void drop_data_pages( file_handle_t* file, std::size_t keep = 0 );
 
 	/***
 	 * writes unwritten pages, filled with zeros
 	 * This can happen when seeking to > file size position in the file.
 	 */
 	bool write_zero_pages( file_handle_t* file );
+
+	/**
+	 * programs the page kept in the tail buffer of the file
+	 */
+	bool write_tail_buffer( file_handle_t* file );
+
+	/**
+	 * writes a page of the file, that contains data up to page_end,
+	 * or keeps it in the tail buffer, if the page is not full.
+	 */
+	bool write_partial_page( file_handle_t* file, const Config::page_type & page, std::size_t page_idx, std::size_t page_end );
 };
 
 template <class Config>
@@ -767,7 +1506,7 @@ Header<Config> SimpleFlashFsBase<Config>::create_default_header( uint32_t page_s
 	header_t header;
 
 	header.magic_string.assign(MAGICK_STRING);
-	header.version = 1;
+	header.version = header_t::VERSION_PAGE_LIST;
 	header.page_size = page_size;
 	header.filesystem_size = filesystem_size;
 
@@ -850,6 +1589,12 @@ bool SimpleFlashFsBase<Config>::write( const Header<Config> & header_ )
 	uint16_t chktype = static_cast<uint16_t>(h.crc_checksum_type);
 	add(chktype);
 
+	if( pos + sizeof(h.erase_block_size) + get_num_of_checksum_bytes() <= page.size() ) {
+		add(h.erase_block_size);
+	} else if( h.erase_block_size > 1 ) {
+		CPPDEBUG( "page size too small for the erase block size" );
+		return false;
+	}
 
 	add_page_checksum( page );
 
@@ -857,7 +1602,7 @@ bool SimpleFlashFsBase<Config>::write( const Header<Config> & header_ )
 	// Serialize physical writes; mem (e.g. SimFlashFsFlashMemory's
 	// fstream) is not safe against concurrent seeks/writes.
 	{
-		std::lock_guard<typename Config::mutex_type> lock( m_mem_mutex );
+		BankLock lock( *this, get_bank_mask( 0, page.size() ) );
 		mem->write( 0, page.data(), page.size() );
 	}
 	// AI generated by GitHub Copilot Claude Opus 4.7 END
@@ -1008,8 +1753,35 @@ Config::page_type SimpleFlashFsBase<Config>::inode2page( const Inode<Config> & i
 	uint32_t pages = inode.data_pages.size();
 	write( pages );
 
-	for( unsigned i = 0; i < pages; i++ ) {
-		write( inode.data_pages[i].page_id );
+	if( use_page_tables() && pages > 0 ) {
+		write( inode.table_level );
+	}
+
+	if( use_page_tables() && inode.table_level == 1 ) {
+		for( auto table_page : inode.indirect_pages ) {
+			write( table_page );
+		}
+	} else if( use_page_tables() && inode.table_level == 2 ) {
+		for( auto table_page : inode.double_indirect_pages ) {
+			write( table_page );
+		}
+	} else if( use_extents() ) {
+		for( uint32_t i = 0; i < pages; ) {
+			const uint32_t first_page = inode.data_pages[i].page_id;
+			uint32_t count = 1;
+
+			while( i + count < pages && inode.data_pages[i + count].page_id == first_page + count ) {
+				count++;
+			}
+
+			write( first_page );
+			write( count );
+			i += count;
+		}
+	} else {
+		for( unsigned i = 0; i < pages; i++ ) {
+			write( inode.data_pages[i].page_id );
+		}
 	}
 
 	// write small data directly into the inode
@@ -1064,6 +1836,12 @@ bool SimpleFlashFsBase<Config>::init()
 	};
 
 	read(h.version);
+
+	if( h.version > header_t::VERSION_PAGE_TABLES ) {
+		CPPDEBUG( "unsupported filesystem version" );
+		return false;
+	}
+
 	read(h.page_size);
 	read(h.filesystem_size);
 	read(h.max_inodes);
@@ -1107,17 +1885,47 @@ bool SimpleFlashFsBase<Config>::init()
 		return false;
 	}
 
+	if( pos + sizeof(h.erase_block_size) + get_num_of_checksum_bytes() <= page.size() ) {
+		read(h.erase_block_size);
+	}
+
+	if( h.erase_block_size > 1 && !supports_erase_blocks() ) {
+		CPPDEBUG( "erase blocks are not supported by this implementation" );
+		return false;
+	}
+
+	if( h.version >= header_t::VERSION_PAGE_TABLES && !Config::USE_PAGE_TABLES ) {
+		CPPDEBUG( "page tables are disabled" );
+		return false;
+	}
+
 	header = h;
 
 	default_header_inode_range = DefaultHeaderInodeRange<Config>( header );
 
+	// has to be rebuilt by the derived class
+	name_index_invalidate();
+
+	{
+		std::lock_guard<typename Config::mutex_type> lock( m_inode_meta_mutex );
+		allocated_unwritten_pages.resize( header.max_inodes );
+		used_inode_pages.resize( header.max_inodes );
+		used_inode_pages_valid = false;
+	}
+
+	{
+		// -1 for the header page
+		std::lock_guard<typename Config::mutex_type> lock( m_free_data_pages_mutex );
+		free_data_pages.resize( static_cast<uint32_t>( header.filesystem_size - 1 ) );
+	}
+
 	return true;
  }
 
 template <class Config>
 FileHandle<Config,SimpleFlashFsBase<Config>> SimpleFlashFsBase<Config>::open( const Config::string_view_type & name, std::ios_base::openmode mode )
 {
-	auto handle = find_file( name );
+	auto handle = find_open_file( name );
 
 	auto handle_append_mode = [mode]( auto & handle ) {
 		if( mode & std::ios_base::app ) {
@@ -1153,6 +1961,8 @@ FileHandle<Config,SimpleFlashFsBase<Config>> SimpleFlashFsBase<Config>::open( co
 		handle.inode.file_name = name;
 		handle.inode.file_name_len = name.size();
 		handle.modified = true;
+		// handle_opened() is called, when the first flush() assigns the inode number
+		handle.registered = true;
 
 		handle_append_mode( handle );
 
@@ -1160,40 +1970,72 @@ FileHandle<Config,SimpleFlashFsBase<Config>> SimpleFlashFsBase<Config>::open( co
 	}
 	else if( mode & std::ios_base::trunc ) {
 
-		auto new_handle = allocate_free_inode_page();
+		// CPPDEBUG( Tools::static_format<100>( "opening file: '%s' truncating it using inode at page: %d", name, handle.page ) );
 
-		if( !new_handle ) {
-			CPPDEBUG( "cannot allocate new inode page" );
-			return {};
-		}
+		// flush() writes the next inode version and erases the pages
+		// of the current one, like for any other change
+		handle.inode.file_len = 0;
+		handle.inode.pages = 0;
+		drop_data_pages( &handle );
+		handle.inode.inode_data.clear();
+		handle.modified = true;
+
+		return handle;
+	}
+
+	handle_append_mode( handle );
 
-		// CPPDEBUG( Tools::static_format<100>( "opening file: '%s' truncating it using inode at page: %d", name, new_handle.page ) );
+	return handle;
+}
+
+template <class Config>
+FileHandle<Config,SimpleFlashFsBase<Config>> SimpleFlashFsBase<Config>::open_snapshot( const Config::string_view_type & name )
+{
+	if constexpr( !Config::USE_SNAPSHOTS ) {
+		CPPDEBUG( "snapshots are disabled" );
+		return {};
+	}
+
+	// pinned before the lookup, so the inode page found
+	// cannot be erased while it is read
+	const uint64_t epoch = pin_snapshot();
 
-		new_handle.inode = handle.inode;
-		new_handle.inode.file_len = 0;
-		new_handle.inode.pages = 0;
-		new_handle.inode.data_pages.clear();
-		new_handle.inode.inode_data.clear();
+	auto handle = find_open_file( name );
 
-		return new_handle;
+	if( !handle ) {
+		release_snapshot( epoch );
+		return {};
 	}
 
-	handle_append_mode( handle );
+	handle.snapshot_epoch = epoch;
 
 	return handle;
 }
 
+template <class Config>
+FileHandle<Config,SimpleFlashFsBase<Config>> SimpleFlashFsBase<Config>::find_open_file( const Config::string_view_type & name )
+{
+	for( ;; ) {
+		auto handle = find_file( name );
+
+		if( !handle ) {
+			return handle;
+		}
+
+		if( handle_opened( &handle ) ) {
+			handle.registered = true;
+			return handle;
+		}
+	}
+}
+
 template <class Config>
 FileHandle<Config,SimpleFlashFsBase<Config>> SimpleFlashFsBase<Config>::find_file_unmapped( const Config::string_view_type & name )
 {
-	// AI generated by GitHub Copilot Claude Opus 4.7 START
-	// iv_storage is a shared scratch buffer reused across calls; it
-	// MUST NOT be mutated by two threads at the same time. We hold
-	// the lock for the whole function so the lookup sees a stable
-	// snapshot of the inode-version map.
-	std::lock_guard<typename Config::mutex_type> lock( m_inode_meta_mutex );
-	// AI generated by GitHub Copilot Claude Opus 4.7 END
-	iv_storage.clear();
+	// No lock is held while the flash is read, each scan has its own buffer.
+	// The temporary handles are disconnected, so their destructors do
+	// not call back into the filesystem.
+	ScanBuffer iv_scan( iv_storage );
 
 	// find the latest version of all inodes
 	// we have top do this, because only the last version of each
@@ -1205,12 +2047,13 @@ FileHandle<Config,SimpleFlashFsBase<Config>> SimpleFlashFsBase<Config>::find_fil
 		if( read_page( i, page, true ) ) {
 			auto file_handle = get_inode( page, false );
 			file_handle.page = i;
+			file_handle.disconnect();
 
-			iv_storage.add(file_handle);
+			iv_scan->add(file_handle);
 		}
 	}
 
-	for( auto & iv : iv_storage.get_data() ) {
+	for( auto & iv : iv_scan->get_data() ) {
 
 		typename Config::page_type page(header.page_size);
 		if( read_page( iv.page, page, true ) ) {
@@ -1219,6 +2062,7 @@ FileHandle<Config,SimpleFlashFsBase<Config>> SimpleFlashFsBase<Config>::find_fil
 
 			// deleted file
 			if( file_handle.inode.file_name.empty() ) {
+				file_handle.disconnect();
 				continue;
 			}
 
@@ -1229,6 +2073,8 @@ FileHandle<Config,SimpleFlashFsBase<Config>> SimpleFlashFsBase<Config>::find_fil
 							*/
 				return file_handle;
 			}
+
+			file_handle.disconnect();
 		}
 	}
 
@@ -1239,10 +2085,8 @@ FileHandle<Config,SimpleFlashFsBase<Config>> SimpleFlashFsBase<Config>::find_fil
 template <class Config>
 FileHandle<Config,SimpleFlashFsBase<Config>> SimpleFlashFsBase<Config>::find_file_mapped( const Config::string_view_type & name )
 {
-	// AI generated by GitHub Copilot Claude Opus 4.7 START
-	std::lock_guard<typename Config::mutex_type> lock( m_inode_meta_mutex );
-	// AI generated by GitHub Copilot Claude Opus 4.7 END
-	iv_storage.clear();
+	// see find_file_unmapped()
+	ScanBuffer iv_scan( iv_storage );
 
 	// find the latest version of all inodes
 	// we have top do this, because only the last version of each
@@ -1254,12 +2098,13 @@ FileHandle<Config,SimpleFlashFsBase<Config>> SimpleFlashFsBase<Config>::find_fil
 			auto page = *ret.data;
 			auto file_handle = get_inode( page, false );
 			file_handle.page = i;
+			file_handle.disconnect();
 
-			iv_storage.add(file_handle);
+			iv_scan->add(file_handle);
 		}
 	}
 
-	for( auto & iv : iv_storage.get_data() ) {
+	for( auto & iv : iv_scan->get_data() ) {
 
 		ReadPageMappedReturn ret = read_page_mapped( iv.page, header.page_size, true );
 
@@ -1270,12 +2115,15 @@ FileHandle<Config,SimpleFlashFsBase<Config>> SimpleFlashFsBase<Config>::find_fil
 
 			// deleted file
 			if( file_handle.inode.file_name.empty() ) {
+				file_handle.disconnect();
 				continue;
 			}
 
 			if( file_handle.inode.file_name == name ) {
 				return file_handle;
 			}
+
+			file_handle.disconnect();
 		}
 	}
 
@@ -1283,27 +2131,170 @@ FileHandle<Config,SimpleFlashFsBase<Config>> SimpleFlashFsBase<Config>::find_fil
 }
 
 template <class Config>
-std::optional<typename Config::string_view_type> SimpleFlashFsBase<Config>::get_inode_file_name_mapped( const file_handle_t & file_handle ) const
+std::span<const std::byte> SimpleFlashFsBase<Config>::read_inode_page( uint32_t idx, Config::page_type & buffer )
 {
-	if( !mem->can_map_read() ) {
-		return {};
-	}
-
-	std::size_t offset = header.page_size + file_handle.page * header.page_size;
+	if( mem->can_map_read() ) {
+		ReadPageMappedReturn ret = read_page_mapped( idx, header.page_size, true );
 
-	const std::byte* addr = mem->map_read(offset, header.page_size );
+		if( !ret ) {
+			return {};
+		}
 
-	if( addr == nullptr ) {
-		CPPDEBUG( "cannot read all data" );
-		return {};
+		return *ret.data;
 	}
 
-	std::span<const std::byte> page( addr, header.page_size );
+	buffer.resize( header.page_size );
 
-	std::size_t pos = sizeof( inode_t::inode_number) +
-	   				  sizeof( inode_t::inode_version_number );
+	if( !read_page( idx, buffer, true ) ) {
+		return {};
+	}
 
-	decltype(inode_t::file_name_len) file_name_len = 0;
+	return { buffer.data(), buffer.size() };
+}
+
+template <class Config>
+std::optional<FileHandle<Config,SimpleFlashFsBase<Config>>> SimpleFlashFsBase<Config>::find_file_indexed( const Config::string_view_type & name )
+{
+	if constexpr( !Config::USE_NAME_INDEX ) {
+		return {};
+	} else {
+		using entry_t = typename NameIndex<Config>::Entry;
+
+		const uint32_t name_hash = NameIndex<Config>::hash( name );
+
+		// n'th entry with this hash. Only the lookup is locked,
+		// the inode pages are read without holding the lock.
+		auto candidate = [this,name_hash]( std::size_t n, bool & valid ) {
+			std::shared_lock<typename Config::mutex_type> lock( m_name_index_mutex );
+			std::optional<entry_t> ret;
+
+			valid = name_index.valid();
+
+			name_index.find( name_hash, [&ret,&n]( const entry_t & entry ) {
+				if( n-- > 0 ) {
+					return false;
+				}
+
+				ret = entry;
+				return true;
+			});
+
+			return ret;
+		};
+
+		auto same_entry = []( const std::optional<entry_t> & a, const entry_t & b ) {
+			return a && a->inode_number == b.inode_number && a->page == b.page;
+		};
+
+		typename Config::page_type buffer;
+
+		// a writer can replace the inode, while its page is read.
+		// Then the lookup is repeated. If it happens too often, find_file() scans.
+		for( unsigned attempt = 0; attempt < 3; attempt++ ) {
+			bool valid = false;
+
+			for( std::size_t n = 0; ; n++ ) {
+				const auto entry = candidate( n, valid );
+
+				if( !valid ) {
+					return {};
+				}
+
+				if( !entry ) {
+					// file does not exists
+					return std::optional<file_handle_t>( std::in_place );
+				}
+
+				std::span<const std::byte> page = read_inode_page( entry->page, buffer );
+
+				if( !page.empty() ) {
+					auto file_handle = get_inode( page, false );
+					file_handle.disconnect();
+
+					if( file_handle.inode.inode_number == entry->inode_number ) {
+
+						// only the hash is equal
+						if( file_handle.inode.file_name != name ) {
+							continue;
+						}
+
+						// page still points to the data of entry->page
+						auto ret = get_inode( page );
+						ret.page = entry->page;
+
+						return std::optional<file_handle_t>( std::move(ret) );
+					}
+				}
+
+				if( !same_entry( candidate( n, valid ), *entry ) ) {
+					// replaced meanwhile
+					break;
+				}
+
+				CPPDEBUG( "name index out of date" );
+				name_index_invalidate();
+				return {};
+			}
+		}
+
+		return {};
+	}
+}
+
+template <class Config>
+void SimpleFlashFsBase<Config>::name_index_insert( const file_handle_t & file )
+{
+	if constexpr( Config::USE_NAME_INDEX ) {
+		// deleted file
+		if( file.inode.file_name.empty() ) {
+			return;
+		}
+
+		std::lock_guard<typename Config::mutex_type> lock( m_name_index_mutex );
+		name_index.insert( NameIndex<Config>::hash( file.inode.file_name ), file.inode.inode_number, file.page );
+	}
+}
+
+template <class Config>
+void SimpleFlashFsBase<Config>::name_index_remove( const file_handle_t & file )
+{
+	if constexpr( Config::USE_NAME_INDEX ) {
+		std::lock_guard<typename Config::mutex_type> lock( m_name_index_mutex );
+		name_index.remove( NameIndex<Config>::hash( file.inode.file_name ), file.inode.inode_number );
+	}
+}
+
+template <class Config>
+void SimpleFlashFsBase<Config>::name_index_invalidate()
+{
+	if constexpr( Config::USE_NAME_INDEX ) {
+		std::lock_guard<typename Config::mutex_type> lock( m_name_index_mutex );
+		name_index.invalidate();
+	}
+}
+
+template <class Config>
+std::optional<typename Config::string_view_type> SimpleFlashFsBase<Config>::get_inode_file_name_mapped( const file_handle_t & file_handle ) const
+{
+	if( !mem->can_map_read() ) {
+		return {};
+	}
+
+	std::size_t offset = header.page_size + file_handle.page * header.page_size;
+
+	const std::byte* addr = mem->map_read(offset, header.page_size );
+
+	if( addr == nullptr ) {
+		CPPDEBUG( "cannot read all data" );
+		return {};
+	}
+
+	std::span<const std::byte> page( addr, header.page_size );
+
+	std::size_t pos = sizeof( inode_t::inode_number) +
+	   				  sizeof( inode_t::inode_version_number );
+
+	decltype(inode_t::file_name_len) file_name_len = 0;
 
 	auto read=[this,&pos,&page]( auto & t ) {
 		const size_t size = sizeof(std::remove_reference_t<decltype(t)>);
@@ -1349,10 +2340,83 @@ FileHandle<Config,SimpleFlashFsBase<Config>> SimpleFlashFsBase<Config>::get_inod
 
 		std::size_t len_read = 0;
 
+		// current extent, for VERSION_EXTENTS
+		typename Inode<Config>::data_pages_value_type extent_page{};
+		uint32_t extent_pages_left = 0;
+		const std::size_t extents_end = page.size() - get_checksum_size();
+
+		// page numbers from the page table pages, for VERSION_PAGE_TABLES
+		page_table_t table_page_ids{};
+
+		if( use_page_tables() ) {
+			read( ret.inode.table_level );
+
+			if( ret.inode.table_level > 0 ) {
+				const std::size_t table_entries = get_page_table_entries();
+				const std::size_t tables = (ret.inode.pages + table_entries - 1) / table_entries;
+				const std::size_t inode_tables = ret.inode.table_level == 1 ? tables : (tables + table_entries - 1) / table_entries;
+
+				if( ret.inode.table_level <= 2 && pos + inode_tables * inode_t::data_pages_type_size <= extents_end ) {
+					auto & inode_table_pages = ret.inode.table_level == 1 ? ret.inode.indirect_pages : ret.inode.double_indirect_pages;
+
+					for( std::size_t i = 0; i < inode_tables; i++ ) {
+						data_pages_value_type table_page{};
+						read( table_page );
+						inode_table_pages.push_back( table_page );
+					}
+
+					if( ret.inode.table_level == 2 ) {
+						read_page_table_level( ret.inode.double_indirect_pages, tables, ret.inode.indirect_pages );
+					}
+
+					table_page_ids.reserve( ret.inode.pages );
+					read_page_table_level( ret.inode.indirect_pages, ret.inode.pages, table_page_ids );
+				}
+			}
+		}
+
 		for( unsigned i = 0; i < ret.inode.pages; i++ ) {
 			typename Inode<Config>::data_pages_value_type page_id{};
 
-			read( page_id );
+			if( ret.inode.table_level > 0 ) {
+				if( i >= table_page_ids.size() ) {
+					// CPPDEBUG( "page table missing or corrupt" );
+					if( do_error_corrections ) {
+						ret.inode.file_len = std::min( ret.inode.file_len, static_cast<uint64_t>(len_read) );
+						ret.modified = true;
+					}
+					break;
+				}
+
+				page_id = table_page_ids[i];
+			} else if( use_extents() ) {
+				if( extent_pages_left == 0 ) {
+					if( pos + inode_t::data_extent_type_size > extents_end ) {
+						// CPPDEBUG( "extent list exceeds inode page" );
+						if( do_error_corrections ) {
+							ret.inode.file_len = std::min( ret.inode.file_len, static_cast<uint64_t>(len_read) );
+							ret.modified = true;
+						}
+						break;
+					}
+
+					read( extent_page );
+					read( extent_pages_left );
+
+					if( extent_pages_left == 0 ) {
+						if( do_error_corrections ) {
+							ret.inode.file_len = std::min( ret.inode.file_len, static_cast<uint64_t>(len_read) );
+							ret.modified = true;
+						}
+						break;
+					}
+				}
+
+				page_id = extent_page++;
+				extent_pages_left--;
+			} else {
+				read( page_id );
+			}
 
 			if( do_error_corrections ) {
 				if( page_id >= header.filesystem_size ) {
@@ -1417,6 +2481,10 @@ FileHandle<Config,SimpleFlashFsBase<Config>> SimpleFlashFsBase<Config>::get_inod
 			ret.inode.data_pages.push_back( { page_id } );
 			len_read += header.page_size;
 		}
+
+		if( ret.inode.table_level > 0 ) {
+			ret.inode.indirect_entries = std::move( table_page_ids );
+		}
 	}
 	/**
 	 * read the data, that is directly stored inside the inode
@@ -1439,71 +2507,177 @@ FileHandle<Config,SimpleFlashFsBase<Config>> SimpleFlashFsBase<Config>::get_inod
 }
 
 template <class Config>
-FileHandle<Config,SimpleFlashFsBase<Config>> SimpleFlashFsBase<Config>::allocate_free_inode_page_unmapped()
+bool SimpleFlashFsBase<Config>::read_page_table_level( const page_table_t & tables, std::size_t count, page_table_t & entries )
 {
-	// AI generated by GitHub Copilot Claude Opus 4.7 START
-	// header_inode_range is stateful (m_current) and the
-	// count()+insert() on allocated_unwritten_pages must be a single
-	// atomic check-then-claim or two writers would both grab the
-	// same inode page.
-	std::lock_guard<typename Config::mutex_type> lock( m_inode_meta_mutex );
-	// AI generated by GitHub Copilot Claude Opus 4.7 END
-	for( auto i = header_inode_range->start(); header_inode_range->has_next(); i = header_inode_range->next() ) {
+	typename Config::page_type buffer{};
+	const std::size_t table_entries = get_page_table_entries();
 
-		typename Config::page_type page(header.page_size);
+	for( auto table_page : tables ) {
+		if( table_page < header.max_inodes || table_page >= header.filesystem_size ) {
+			return false;
+		}
 
-		ReadPageReturn ret = read_page( i, page, true );
+		auto page = read_inode_page( table_page, buffer );
 
-		if( !ret && *ret.error != ReadError::ReadError ) {
-			if( allocated_unwritten_pages.count(i) == 0 ) {
-				file_handle_t fh_ret(this);
-				fh_ret.page = i;
-				allocated_unwritten_pages.insert(i);
-				return fh_ret;
+		if( page.empty() ) {
+			// CPPDEBUG( Tools::static_format<100>( "invalid page table page %d", table_page ) );
+			return false;
+		}
+
+		for( std::size_t i = 0; i < table_entries && entries.size() < count; i++ ) {
+			data_pages_value_type page_id{};
+			std::memcpy( &page_id, page.data() + i * inode_t::data_pages_type_size, sizeof(page_id) );
+			auto_endianess( page_id );
+			entries.push_back( page_id );
+		}
+	}
+
+	return entries.size() == count;
+}
+
+template <class Config>
+bool SimpleFlashFsBase<Config>::write_zero_pages( file_handle_t* file )
+{
+	for( auto & p : file->inode.data_pages ) {
+		if( p.state == data_page_t::State::New ) {
+
+			typename Config::page_type page(header.page_size);
+
+			if( !write_page( file, page, p ) ) {
+				// CPPDEBUG( Tools::static_format<100>( "cannot write zero page %d", p.page_id ));
+				return false;
 			}
+
+			p.state = data_page_t::State::Stored;
 		}
 	}
 
-	return {};
+	return true;
 }
 
 template <class Config>
-FileHandle<Config,SimpleFlashFsBase<Config>> SimpleFlashFsBase<Config>::allocate_free_inode_page_mapped()
+template <class F>
+bool SimpleFlashFsBase<Config>::write_page_table_level( file_handle_t* file,
+		const page_table_t & old_tables,
+		const page_table_t & old_entries,
+		std::size_t entries,
+		F entry,
+		page_table_t & new_tables )
 {
-	// AI generated by GitHub Copilot Claude Opus 4.7 START
-	std::lock_guard<typename Config::mutex_type> lock( m_inode_meta_mutex );
-	// AI generated by GitHub Copilot Claude Opus 4.7 END
-	for( auto i = header_inode_range->start(); header_inode_range->has_next(); i = header_inode_range->next() ) {
+	typename Config::page_type page(header.page_size);
+	const std::size_t table_entries = get_page_table_entries();
 
-		ReadPageMappedReturn ret = read_page_mapped( i, header.page_size, true );
+	for( std::size_t t = 0; t * table_entries < entries; t++ ) {
 
-		if( !ret && *ret.error != ReadError::ReadError ) {
-			if( allocated_unwritten_pages.count(i) == 0 ) {
-				file_handle_t fh_ret(this);
-				fh_ret.page = i;
-				allocated_unwritten_pages.insert(i);
-				return fh_ret;
+		const std::size_t first = t * table_entries;
+		const std::size_t count = std::min( table_entries, entries - first );
+
+		// an unchanged page table page is not written again
+		if( t < old_tables.size() && !page_is_relocated( old_tables[t] ) &&
+			first + count <= old_entries.size() &&
+			std::min( table_entries, old_entries.size() - first ) == count ) {
+
+			bool unchanged = true;
+
+			for( std::size_t i = first; i < first + count && unchanged; i++ ) {
+				unchanged = entry( i ) == old_entries[i];
+			}
+
+			if( unchanged ) {
+				new_tables.push_back( old_tables[t] );
+				continue;
 			}
 		}
+
+		// unused entries are kept in erased state
+		std::fill( page.begin(), page.end(), std::byte(0xFF) );
+
+		for( std::size_t i = 0; i < count; i++ ) {
+			data_pages_value_type page_id = entry( first + i );
+			auto_endianess( page_id );
+			std::memcpy( page.data() + i * inode_t::data_pages_type_size, &page_id, sizeof(page_id) );
+		}
+
+		add_page_checksum( page );
+
+		auto o_page = allocate_free_data_page();
+
+		if( !o_page ) {
+			CPPDEBUG( "cannot allocate page table page" );
+			return false;
+		}
+
+		new_tables.push_back( *o_page );
+
+		if( !write_meta_page( file, page, *o_page ) ) {
+			CPPDEBUG( "cannot write page table page" );
+			return false;
+		}
 	}
 
-	return {};
+	return true;
 }
 
 template <class Config>
-bool SimpleFlashFsBase<Config>::write_zero_pages( file_handle_t* file )
+bool SimpleFlashFsBase<Config>::write_page_tables( file_handle_t* file )
 {
-	for( auto & p : file->inode.data_pages ) {
-		if( p.state == data_page_t::State::New ) {
+	if( !use_page_tables() ) {
+		return true;
+	}
 
-			typename Config::page_type page(header.page_size);
+	auto & inode = file->inode;
+	const auto & dp = inode.data_pages;
+	const std::size_t space = get_inode_data_space_size( file ) - sizeof(inode.table_level);
+
+	page_table_t indirect_pages{};
+	page_table_t double_indirect_pages{};
+	uint16_t table_level = 0;
+	bool ok = true;
+
+	// the extents do not fit into the inode
+	if( count_data_pages_extents( file ) > space / inode_t::data_extent_type_size ) {
+		table_level = 1;
+		ok = write_page_table_level( file, inode.indirect_pages, inode.indirect_entries, dp.size(),
+				[&dp]( std::size_t i ) { return dp[i].page_id; },
+				indirect_pages );
+
+		// the page numbers of the page tables do not fit into the inode
+		if( ok && indirect_pages.size() > space / inode_t::data_pages_type_size ) {
+			table_level = 2;
+			ok = write_page_table_level( file, inode.double_indirect_pages, inode.indirect_pages, indirect_pages.size(),
+					[&indirect_pages]( std::size_t i ) { return indirect_pages[i]; },
+					double_indirect_pages );
+
+			if( ok && double_indirect_pages.size() > space / inode_t::data_pages_type_size ) {
+				CPPDEBUG( "file too large for double indirect page tables" );
+				ok = false;
+			}
+		}
+	}
 
-			if( !write_page( file, page, p ) ) {
-				// CPPDEBUG( Tools::static_format<100>( "cannot write zero page %d", p.page_id ));
-				return false;
+	if( !ok ) {
+		// give back the pages, that are not used by the current inode version
+		auto release = [this]( const page_table_t & new_tables, const page_table_t & old_tables ) {
+			for( auto page : new_tables ) {
+				if( std::find( old_tables.begin(), old_tables.end(), page ) == old_tables.end() ) {
+					erase_and_free_page( page );
+				}
 			}
+		};
 
-			p.state = data_page_t::State::Stored;
+		release( indirect_pages, inode.indirect_pages );
+		release( double_indirect_pages, inode.double_indirect_pages );
+		return false;
+	}
+
+	inode.table_level = table_level;
+	inode.indirect_pages = std::move( indirect_pages );
+	inode.double_indirect_pages = std::move( double_indirect_pages );
+	inode.indirect_entries.clear();
+
+	if( table_level > 0 ) {
+		for( const auto & p : dp ) {
+			inode.indirect_entries.push_back( p.page_id );
 		}
 	}
 
@@ -1534,50 +2708,18 @@ bool SimpleFlashFsBase<Config>::flush( file_handle_t* file )
 				Tools::IterableToCommaSeparatedString(v_deleted) ));
 	};
 */
+	if( !write_tail_buffer( file ) ) {
+		return false;
+	}
+
 	if( !file->modified ) {
 		return true;
 	}
 
 	if( file->inode.inode_number == 0) {
-		// AI generated by GitHub Copilot Claude Opus 4.7 START
-		// Read-modify-write of max_inode_number; another writer must
-		// not grab the same number.
-		{
-			std::lock_guard<typename Config::mutex_type> lock( m_max_inode_number_mutex );
-			file->inode.inode_number = max_inode_number + 1;
-			max_inode_number = file->inode.inode_number;
-		}
-		// AI generated by GitHub Copilot Claude Opus 4.7 END
-
-		/*
-		CPPDEBUG( Tools::static_format<100>( "writing new inode %d,%d at page %d",
-				file->inode.inode_number,
-				file->inode.inode_version_number,
-				file->page));
-		*/
-
-		if( !write_zero_pages( file ) ) {
-			CPPDEBUG( "failed flushing zero pages" );
-		}
-
-		auto page = inode2page(file->inode);
-		add_page_checksum(page);
-
-		// debug(file);
-
-		if( !write_meta_page(file, page, file->page ) ) {
-			/*
-			CPPDEBUG( Tools::static_format<100>( "cannot write inode %d page %d",
-					  file->inode.inode_number, file->page ) );
-					  */
-			return false;
-		}
-		file->modified = false;
-		return true;
+		return write_first_inode_version( file );
 	}
 
-	FileHandle old_file = file->get_disconnected_copy();
-
 	auto o_page = allocate_free_inode_page_number();
 
 	if( !o_page ) {
@@ -1585,67 +2727,266 @@ bool SimpleFlashFsBase<Config>::flush( file_handle_t* file )
 		return false;
 	}
 
-	file->page = *o_page;
-	file->inode.inode_version_number++;
-
-	// AI generated by GitHub Copilot Claude Opus 4.7 START
-	// Strip Deleted entries from the new inode's data_pages list
-	// BEFORE serialising it. allocate_new_data_page_at() temporarily
-	// keeps the old page-id in the list with state=Deleted as a
-	// crash-recovery safety net (if the flush below fails the old
-	// inode on disk still claims it, so the data is recoverable).
-	// On a successful flush the old pages are unreachable and must
-	// be reclaimed - leaving them in the new inode would
-	//   1) waste flash by serialising a longer page list, and
-	//   2) defeat erase_inode_and_unused_pages() which removes from
-	//      its erase candidates every page-id that appears in the
-	//      new inode - so the old data page would never be erased
-	//      and never returned to free_data_pages, leaking pages
-	//      monotonically with every COW.
-	// old_file (already copied above) still has the Deleted entries
-	// so the OLD - NEW comparison correctly identifies them as
-	// "should be erased".
-	{
-		auto & dp = file->inode.data_pages;
-		auto new_end = std::remove_if(
-			dp.begin(), dp.end(),
-			[]( const auto & p ) {
-				return p.state == data_page_t::State::Deleted;
-			} );
-		dp.erase( new_end, dp.end() );
-	}
-	// AI generated by GitHub Copilot Claude Opus 4.7 END
-
-	auto page = inode2page(file->inode);
-	add_page_checksum(page);
-
-	if( !write_zero_pages( file ) ) {
-		CPPDEBUG( "failed flushing zero pages" );
-	}
-
-	// debug(file);
+	file_handle_t old_file{};
 
-	if( !write_meta_page(file, page, file->page ) ) {
-		/*
-		CPPDEBUG( Tools::static_format<100>( "cannot write inode %d,%d page %d",
-				file->inode.inode_number, file->inode.inode_version_number, file->page ));
-				*/
+	if( !write_next_inode_version( file, *o_page, old_file ) ) {
 		return false;
 	}
 
-	file->modified = false;
-
 	erase_inode_and_unused_pages(old_file, *file);
 
 	return true;
 }
 
 template <class Config>
-std::optional<uint32_t> SimpleFlashFsBase<Config>::allocate_free_inode_page_number_unmapped()
+bool SimpleFlashFsBase<Config>::flush_all( std::span<file_handle_t* const> files )
 {
-	// AI generated by GitHub Copilot Claude Opus 4.7 START
+	bool ret = true;
+	std::size_t next_versions = 0;
+
+	// data pages first
+	for( auto file : files ) {
+		if( !write_tail_buffer( file ) ) {
+			ret = false;
+		}
+
+		if( file->modified && file->inode.inode_number != 0 ) {
+			next_versions++;
+		}
+	}
+
+	// allocate the inode pages of all files in one pass
+	typename Config::template vector_type<uint32_t> inode_pages;
+	inode_pages.resize( next_versions );
+
+	const std::size_t allocated = allocate_free_inode_page_numbers( std::span<uint32_t>( inode_pages.data(), inode_pages.size() ) );
+
+	if( allocated < next_versions ) {
+		CPPDEBUG( "cannot allocate new inode page" );
+		ret = false;
+	}
+
+	// write the inode pages back to back, collect the pages to erase
+	PageSet<Config> pages_to_erase;
+	std::size_t next_inode_page = 0;
+
+	for( auto file : files ) {
+		if( !file->modified ) {
+			continue;
+		}
+
+		if( file->inode.inode_number == 0 ) {
+			if( !write_first_inode_version( file ) ) {
+				ret = false;
+			}
+			continue;
+		}
+
+		if( next_inode_page == allocated ) {
+			continue;
+		}
+
+		file_handle_t old_file{};
+
+		if( !write_next_inode_version( file, inode_pages[next_inode_page++], old_file ) ) {
+			ret = false;
+			continue;
+		}
+
+		collect_unused_pages( old_file, *file, pages_to_erase );
+	}
+
+	// inode pages, that were not required
+	for( ; next_inode_page < allocated; next_inode_page++ ) {
+		free_unwritten_pages( inode_pages[next_inode_page] );
+	}
+
+	// one erase pass for all files
+	retire_pages( pages_to_erase );
+
+	return ret;
+}
+
+template <class Config>
+bool SimpleFlashFsBase<Config>::write_first_inode_version( file_handle_t* file )
+{
+	// AI generated by GitHub Copilot Claude Opus 4.7 START
+	// Read-modify-write of max_inode_number; another writer must
+	// not grab the same number.
+	{
+		std::lock_guard<typename Config::mutex_type> lock( m_max_inode_number_mutex );
+		file->inode.inode_number = max_inode_number + 1;
+		max_inode_number = file->inode.inode_number;
+	}
+	// AI generated by GitHub Copilot Claude Opus 4.7 END
+
+	// the new inode cannot have a newer version yet
+	if( file->registered ) {
+		handle_opened( file );
+	}
+
+	/*
+	CPPDEBUG( Tools::static_format<100>( "writing new inode %d,%d at page %d",
+			file->inode.inode_number,
+			file->inode.inode_version_number,
+			file->page));
+	*/
+
+	// pages replaced before the first flush() are not used by any inode on flash
+	PageSet<Config> replaced_pages;
+
+	{
+		auto & dp = file->inode.data_pages;
+
+		for( const auto & p : dp ) {
+			if( p.state == data_page_t::State::Deleted ) {
+				replaced_pages.unordered_insert( p.page_id );
+			}
+		}
+
+		dp.erase( std::remove_if( dp.begin(), dp.end(), []( const auto & p ) {
+			return p.state == data_page_t::State::Deleted;
+		} ), dp.end() );
+	}
+
+	if( !write_zero_pages( file ) ) {
+		CPPDEBUG( "failed flushing zero pages" );
+	}
+
+	if( !write_page_tables( file ) ) {
+		return false;
+	}
+
+	auto page = inode2page(file->inode);
+	add_page_checksum(page);
+
+	if( !write_meta_page(file, page, file->page ) ) {
+		/*
+		CPPDEBUG( Tools::static_format<100>( "cannot write inode %d page %d",
+				  file->inode.inode_number, file->page ) );
+				  */
+		return false;
+	}
+	file->modified = false;
+	inode_page_written( file->page );
+	name_index_insert( *file );
+
+	if( !replaced_pages.empty() ) {
+		erase_pages( replaced_pages );
+	}
+
+	return true;
+}
+
+template <class Config>
+bool SimpleFlashFsBase<Config>::write_next_inode_version( file_handle_t* file, uint32_t new_page, file_handle_t & old_file )
+{
+	old_file = file->get_disconnected_copy();
+
+	file->page = new_page;
+	file->inode.inode_version_number++;
+
+	// AI generated by GitHub Copilot Claude Opus 4.7 START
+	// Strip Deleted entries from the new inode's data_pages list
+	// BEFORE serialising it. allocate_new_data_page_at() temporarily
+	// keeps the old page-id in the list with state=Deleted as a
+	// crash-recovery safety net (if the flush below fails the old
+	// inode on disk still claims it, so the data is recoverable).
+	// On a successful flush the old pages are unreachable and must
+	// be reclaimed - leaving them in the new inode would
+	//   1) waste flash by serialising a longer page list, and
+	//   2) defeat erase_inode_and_unused_pages() which removes from
+	//      its erase candidates every page-id that appears in the
+	//      new inode - so the old data page would never be erased
+	//      and never returned to free_data_pages, leaking pages
+	//      monotonically with every COW.
+	// old_file (already copied above) still has the Deleted entries
+	// so the OLD - NEW comparison correctly identifies them as
+	// "should be erased".
+	{
+		auto & dp = file->inode.data_pages;
+		auto new_end = std::remove_if(
+			dp.begin(), dp.end(),
+			[]( const auto & p ) {
+				return p.state == data_page_t::State::Deleted;
+			} );
+		dp.erase( new_end, dp.end() );
+	}
+	// AI generated by GitHub Copilot Claude Opus 4.7 END
+
+	if( !write_page_tables( file ) ) {
+		return false;
+	}
+
+	auto page = inode2page(file->inode);
+	add_page_checksum(page);
+
+	if( !write_zero_pages( file ) ) {
+		CPPDEBUG( "failed flushing zero pages" );
+	}
+
+	if( !write_meta_page(file, page, file->page ) ) {
+		/*
+		CPPDEBUG( Tools::static_format<100>( "cannot write inode %d,%d page %d",
+				file->inode.inode_number, file->inode.inode_version_number, file->page ));
+				*/
+		return false;
+	}
+
+	file->modified = false;
+	inode_page_written( file->page );
+	name_index_insert( *file );
+
+	return true;
+}
+
+template <class Config>
+std::size_t SimpleFlashFsBase<Config>::allocate_free_inode_page_numbers_bitmap( std::span<uint32_t> pages )
+{
+	std::lock_guard<typename Config::mutex_type> lock( m_inode_meta_mutex );
+
+	std::size_t count = 0;
+
+	if( header_inode_range == &default_header_inode_range ) {
+		// no special order, take the first free ones
+		uint32_t from = 0;
+
+		while( count < pages.size() ) {
+			auto page = used_inode_pages.find_first_unset( allocated_unwritten_pages, from );
+
+			if( !page ) {
+				break;
+			}
+
+			allocated_unwritten_pages.set(*page);
+			pages[count++] = *page;
+			from = *page + 1;
+		}
+	} else {
+		header_inode_range->reset();
+
+		while( count < pages.size() && header_inode_range->has_next() ) {
+			const uint32_t i = header_inode_range->next();
+
+			if( !used_inode_pages.test(i) && !allocated_unwritten_pages.test(i) ) {
+				allocated_unwritten_pages.set(i);
+				pages[count++] = i;
+			}
+		}
+	}
+
+	return count;
+}
+
+template <class Config>
+std::optional<uint32_t> SimpleFlashFsBase<Config>::allocate_free_inode_page_number_unmapped()
+{
+	// AI generated by GitHub Copilot Claude Opus 4.7 START
 	std::lock_guard<typename Config::mutex_type> lock( m_inode_meta_mutex );
 	// AI generated by GitHub Copilot Claude Opus 4.7 END
+	// Reads the pages with the lock held, header_inode_range has no other protection.
+	// Only used as long as used_inode_pages is not valid, the dynamic
+	// implementation builds it while mounting.
 	typename Config::page_type page{};
 	page.reserve(header.page_size);
 
@@ -1657,8 +2998,8 @@ std::optional<uint32_t> SimpleFlashFsBase<Config>::allocate_free_inode_page_numb
 
 
 		if( !ret && *ret.error != ReadError::ReadError ) {
-			if( allocated_unwritten_pages.count(i) == 0 ) {
-				allocated_unwritten_pages.insert(i);
+			if( !allocated_unwritten_pages.test(i) ) {
+				allocated_unwritten_pages.set(i);
 				return i;
 			}
 		}
@@ -1678,8 +3019,8 @@ std::optional<uint32_t> SimpleFlashFsBase<Config>::allocate_free_inode_page_numb
 		ReadPageMappedReturn ret = read_page_mapped( i, header.page_size, true );
 
 		if( !ret && *ret.error != ReadError::ReadError ) {
-			if( allocated_unwritten_pages.count(i) == 0 ) {
-				allocated_unwritten_pages.insert(i);
+			if( !allocated_unwritten_pages.test(i) ) {
+				allocated_unwritten_pages.set(i);
 				return i;
 			}
 		}
@@ -1691,35 +3032,201 @@ std::optional<uint32_t> SimpleFlashFsBase<Config>::allocate_free_inode_page_numb
 template <class Config>
 std::optional<uint32_t> SimpleFlashFsBase<Config>::allocate_free_data_page()
 {
-	// AI generated by GitHub Copilot Claude Opus 4.7 START
-	// The empty()/begin()/erase() trio must be atomic, or two
-	// concurrent writers will both observe the same first free page
-	// and the second write will silently overwrite the first.
-	std::lock_guard<typename Config::mutex_type> lock( m_free_data_pages_mutex );
-	// AI generated by GitHub Copilot Claude Opus 4.7 END
-	if( free_data_pages.empty() ) {
+	reclaim_if_no_free_data_pages( 1 );
+
+	std::optional<uint32_t> ret;
+
+	{
+		// AI generated by GitHub Copilot Claude Opus 4.7 START
+		// The empty()/begin()/erase() trio must be atomic, or two
+		// concurrent writers will both observe the same first free page
+		// and the second write will silently overwrite the first.
+		std::lock_guard<typename Config::mutex_type> lock( m_free_data_pages_mutex );
+		// AI generated by GitHub Copilot Claude Opus 4.7 END
+		ret = free_data_pages.allocate_first();
+	}
+
+	if( !ret ) {
 		CPPDEBUG( "no free data pages left" );
 		return {};
 	}
 
-	auto it = free_data_pages.begin();
-	uint32_t ret = *it;
-	free_data_pages.erase(it);
+	page_allocated( *ret );
 
 	return ret;
 }
 
 template <class Config>
-std::optional<uint32_t> SimpleFlashFsBase<Config>::allocate_free_data_page( const file_handle_t *file )
+std::optional<PageRun> SimpleFlashFsBase<Config>::allocate_free_data_page_run( uint32_t near_page, uint32_t count )
 {
-	std::size_t max_pages = get_max_inode_data_pages( file );
+	reclaim_if_no_free_data_pages( count );
+
+	std::optional<PageRun> ret;
+
+	{
+		std::lock_guard<typename Config::mutex_type> lock( m_free_data_pages_mutex );
+		ret = free_data_pages.allocate_run( near_page, count );
+	}
+
+	if( !ret ) {
+		CPPDEBUG( "no free data pages left" );
+		return {};
+	}
+
+	for( uint32_t i = 0; i < ret->count; i++ ) {
+		page_allocated( ret->first_page + i );
+	}
+
+	return ret;
+}
 
-	if( file->inode.data_pages.size() + 1 >= max_pages ) {
+template <class Config>
+std::optional<uint32_t> SimpleFlashFsBase<Config>::allocate_free_data_page( file_handle_t *file )
+{
+	if( inode_data_pages_full( file ) ) {
 		// no space left
 		return {};
 	}
 
-	return allocate_free_data_page();
+	return allocate_writer_data_page( file );
+}
+
+template <class Config>
+std::optional<uint32_t> SimpleFlashFsBase<Config>::allocate_writer_data_page( file_handle_t *file )
+{
+	if( !steer_writers_to_banks() ) {
+		return allocate_free_data_page();
+	}
+
+	const auto run = allocate_free_data_page_run( get_writer_near_page( file, 0 ), 1 );
+
+	if( !run ) {
+		return {};
+	}
+
+	return run->first_page;
+}
+
+template <class Config>
+std::size_t SimpleFlashFsBase<Config>::get_number_of_banks() const
+{
+	const std::size_t bank_size = mem->get_bank_size();
+
+	if( bank_size == 0 ) {
+		return 1;
+	}
+
+	return ( mem->size() + bank_size - 1 ) / bank_size;
+}
+
+template <class Config>
+uint32_t SimpleFlashFsBase<Config>::get_bank_mask( std::size_t address, std::size_t size ) const
+{
+	if constexpr( Config::MAX_BANKS == 1 ) {
+		return 1;
+	}
+
+	const std::size_t bank_size = mem->get_bank_size();
+
+	if( bank_size == 0 ) {
+		return 1;
+	}
+
+	const std::size_t first = address / bank_size;
+	const std::size_t last = ( address + std::max<std::size_t>( size, 1 ) - 1 ) / bank_size;
+	uint32_t mask = 0;
+
+	for( std::size_t bank = first; bank <= last && bank < first + Config::MAX_BANKS; bank++ ) {
+		mask |= uint32_t(1) << ( bank % Config::MAX_BANKS );
+	}
+
+	return mask;
+}
+
+template <class Config>
+uint32_t SimpleFlashFsBase<Config>::get_bank_mask( std::span<const FlashMemoryInterface::WriteVec> vec ) const
+{
+	uint32_t mask = 0;
+
+	for( const auto & v : vec ) {
+		mask |= get_bank_mask( v.address, v.size );
+	}
+
+	return mask;
+}
+
+template <class Config>
+bool SimpleFlashFsBase<Config>::steer_writers_to_banks() const
+{
+	return Config::MAX_BANKS > 1 && get_number_of_banks() > 1;
+}
+
+template <class Config>
+uint32_t SimpleFlashFsBase<Config>::get_writer_bank( file_handle_t *file )
+{
+	// banks sharing a lock would not run in parallel
+	const std::size_t banks = std::min( get_number_of_banks(), Config::MAX_BANKS );
+
+	std::lock_guard<typename Config::mutex_type> lock( m_free_data_pages_mutex );
+
+	if( !file->bank ) {
+		uint32_t best = 0;
+
+		for( uint32_t bank = 1; bank < banks; bank++ ) {
+			if( m_bank_writers[bank] < m_bank_writers[best] ) {
+				best = bank;
+			}
+		}
+
+		m_bank_writers[best]++;
+		file->bank = best;
+	}
+
+	return *file->bank;
+}
+
+template <class Config>
+void SimpleFlashFsBase<Config>::release_writer_bank( uint32_t bank )
+{
+	std::lock_guard<typename Config::mutex_type> lock( m_free_data_pages_mutex );
+
+	if( bank < m_bank_writers.size() && m_bank_writers[bank] > 0 ) {
+		m_bank_writers[bank]--;
+	}
+}
+
+template <class Config>
+uint32_t SimpleFlashFsBase<Config>::get_first_page_of_bank( uint32_t bank ) const
+{
+	const std::size_t address = bank * mem->get_bank_size();
+	std::size_t page = 0;
+
+	// page 0 starts behind the header
+	if( address > header.page_size ) {
+		page = ( address - header.page_size + header.page_size - 1 ) / header.page_size;
+	}
+
+	return static_cast<uint32_t>( std::max<std::size_t>( page, header.max_inodes ) );
+}
+
+template <class Config>
+uint32_t SimpleFlashFsBase<Config>::get_writer_near_page( file_handle_t *file, uint32_t near_page )
+{
+	if( !steer_writers_to_banks() ) {
+		return near_page;
+	}
+
+	const uint32_t bank = get_writer_bank( file );
+
+	if( near_page != 0 ) {
+		const std::size_t address = header.page_size + static_cast<std::size_t>(near_page) * header.page_size;
+
+		if( address / mem->get_bank_size() == bank ) {
+			return near_page;
+		}
+	}
+
+	return get_first_page_of_bank( bank );
 }
 
 template <class Config>
@@ -1748,9 +3255,87 @@ template <class Config>
 std::size_t SimpleFlashFsBase<Config>::get_max_inode_data_pages( const file_handle_t* file ) const
 {
 	std::size_t space = get_inode_data_space_size( file );
+
+	if( use_page_tables() ) {
+		// double indirect page tables
+		const std::size_t table_entries = get_page_table_entries();
+		space -= sizeof(inode_t::table_level);
+		return space / inode_t::data_pages_type_size * table_entries * table_entries;
+	}
+
+	if( use_extents() ) {
+		return space / inode_t::data_extent_type_size;
+	}
+
 	return space / inode_t::data_pages_type_size;
 }
 
+template <class Config>
+std::size_t SimpleFlashFsBase<Config>::get_inode_data_pages_entries( const file_handle_t* file ) const
+{
+	// deleted pages are not stored in the inode, see flush()
+	if( !use_extents() || use_page_tables() ) {
+		return file->inode.count_valid_data_pages();
+	}
+
+	return count_data_pages_extents( file );
+}
+
+template <class Config>
+std::size_t SimpleFlashFsBase<Config>::count_data_pages_extents( const file_handle_t* file ) const
+{
+	const auto & dp = file->inode.data_pages;
+	std::size_t extents = 0;
+
+	const data_page_t *prev = nullptr;
+
+	for( const auto & page : dp ) {
+		if( page.state == data_page_t::State::Deleted ) {
+			continue;
+		}
+
+		if( !prev || page.page_id != prev->page_id + 1 ) {
+			extents++;
+		}
+
+		prev = &page;
+	}
+
+	return extents;
+}
+
+template <class Config>
+bool SimpleFlashFsBase<Config>::inode_data_pages_full( const file_handle_t* file ) const
+{
+	const std::size_t max_entries = get_max_inode_data_pages( file );
+
+	// there are never more extents than pages, so counting is not required
+	if( file->inode.data_pages.size() + 1 < max_entries ) {
+		return false;
+	}
+
+	// one more page may require one more entry
+	return get_inode_data_pages_entries( file ) + 1 >= max_entries;
+}
+
+template <class Config>
+void SimpleFlashFsBase<Config>::erase_inode_page( uint32_t page )
+{
+	prepare_modification();
+
+	{
+		const std::size_t address = header.page_size + page * header.page_size;
+		BankLock lock( *this, get_bank_mask( address, header.page_size ) );
+		mem->erase( address, header.page_size );
+	}
+
+	std::lock_guard<typename Config::mutex_type> lock( m_inode_meta_mutex );
+	allocated_unwritten_pages.reset( page );
+	used_inode_pages.reset( page );
+	page_erased( page );
+	page_changed( page );
+}
+
 template <class Config>
 void SimpleFlashFsBase<Config>::erase_inode_and_unused_pages( file_handle_t & inode_to_erase,
 		file_handle_t & next_inode_version )
@@ -1763,139 +3348,423 @@ void SimpleFlashFsBase<Config>::erase_inode_and_unused_pages( file_handle_t & in
 			next_inode_version.inode.inode_version_number));
 */
 
+	PageSet<Config> pages_to_erase;
+
+	collect_unused_pages( inode_to_erase, next_inode_version, pages_to_erase );
+	retire_pages( pages_to_erase );
+
+	inode_to_erase.modified = false;
+}
+
+template <class Config>
+void SimpleFlashFsBase<Config>::collect_unused_pages( const file_handle_t & inode_to_erase,
+		const file_handle_t & next_inode_version,
+		PageSet<Config> & pages_to_erase )
+{
 	// all pages, that are used by the next inode are still in use
 	auto & dp = inode_to_erase.inode.data_pages;
 
 	// assume to erase all old pages
 	//typename Config::set_type<uint32_t> pages_to_erase( dp.begin(), dp.end() );
-	PageSet<Config> pages_to_erase;
 	for( auto & p : dp ) {
 		pages_to_erase.unordered_insert( p.page_id );
 	}
 
+	// page table pages are data pages too
+	for( auto page : inode_to_erase.inode.indirect_pages ) {
+		pages_to_erase.unordered_insert( page );
+	}
+
+	for( auto page : inode_to_erase.inode.double_indirect_pages ) {
+		pages_to_erase.unordered_insert( page );
+	}
+
 	// now remove all pages from the inode in the next version
 	for( auto page : next_inode_version.inode.data_pages ) {
 		pages_to_erase.erase(page.page_id);
 	}
 
+	// unchanged page table pages are reused by the next version
+	for( auto page : next_inode_version.inode.indirect_pages ) {
+		pages_to_erase.erase(page);
+	}
+
+	for( auto page : next_inode_version.inode.double_indirect_pages ) {
+		pages_to_erase.erase(page);
+	}
+
 	// add the inode self too
 	pages_to_erase.insert(inode_to_erase.page);
+}
+
+template <class Config>
+void SimpleFlashFsBase<Config>::erase_pages( PageSet<Config> & pages_to_erase )
+{
+	for( auto page : pages_to_erase.get_data() ) {
+		erase_and_free_page( page );
+	}
+}
+
+template <class Config>
+void SimpleFlashFsBase<Config>::retire_pages( PageSet<Config> & pages_to_erase )
+{
+	{
+		std::lock_guard<typename Config::mutex_type> lock( m_snapshot_mutex );
+
+		const uint64_t epoch = ++m_snapshot_epoch;
+
+		if( !m_snapshot_pins.empty() ) {
+			for( auto page : pages_to_erase.get_data() ) {
+				if( page != PageSet<Config>::NO_DATA ) {
+					m_retired_pages.push_back( { epoch, page } );
+				}
+			}
+			return;
+		}
+	}
+
+	erase_pages( pages_to_erase );
+}
+
+template <class Config>
+uint64_t SimpleFlashFsBase<Config>::pin_snapshot()
+{
+	std::lock_guard<typename Config::mutex_type> lock( m_snapshot_mutex );
+	m_snapshot_pins.push_back( m_snapshot_epoch );
+	return m_snapshot_epoch;
+}
+
+template <class Config>
+void SimpleFlashFsBase<Config>::release_snapshot( uint64_t epoch )
+{
+	PageSet<Config> pages_to_erase;
+
+	{
+		std::lock_guard<typename Config::mutex_type> lock( m_snapshot_mutex );
+
+		auto & pins = m_snapshot_pins;
+		auto it = std::find( pins.begin(), pins.end(), epoch );
+
+		if( it != pins.end() ) {
+			*it = pins.back();
+			pins.resize( pins.size() - 1 );
+		}
+
+		// pages retired after the oldest open snapshot are still required
+		uint64_t oldest = std::numeric_limits<uint64_t>::max();
+
+		for( auto pin : pins ) {
+			oldest = std::min( oldest, pin );
+		}
+
+		std::size_t count = 0;
+
+		while( count < m_retired_pages.size() && m_retired_pages[count].epoch <= oldest ) {
+			pages_to_erase.unordered_insert( m_retired_pages[count].page );
+			count++;
+		}
+
+		if( count > 0 ) {
+			std::move( m_retired_pages.begin() + count, m_retired_pages.end(), m_retired_pages.begin() );
+			m_retired_pages.resize( m_retired_pages.size() - count );
+		}
+	}
+
+	if( !pages_to_erase.empty() ) {
+		erase_pages( pages_to_erase );
+	}
+}
+
+template <class Config>
+void SimpleFlashFsBase<Config>::erase_and_free_page( uint32_t page )
+{
+	// CPPDEBUG( Tools::static_format<100>( "erasing page: %d", page ) );
+
+	std::size_t address = header.page_size + page * header.page_size;
+	// AI generated by GitHub Copilot Claude Opus 4.7 START
+	// Lock mem and free_data_pages briefly, separately, never
+	// holding both at once - avoids any ordering trap against
+	// write_page() which takes them the other way around.
+	{
+		BankLock lock( *this, get_bank_mask( address, header.page_size ) );
+		mem->erase(address, header.page_size );
+	}
+
+	if( page >= header.max_inodes ) {
+		std::lock_guard<typename Config::mutex_type> lock( m_free_data_pages_mutex );
+		free_data_pages.insert(page);
+		page_erased( page );
+		page_changed( page );
+	} else {
+		// Inode page just physically erased on flash. It is no
+		// longer reserved by any in-flight allocation, so drop
+		// the entry that allocate_free_inode_page_number() put
+		// there. Without this drop, allocated_unwritten_pages
+		// grows monotonically with every flush() of a long-lived
+		// FileHandle - once it covers all max_inodes entries the
+		// allocator refuses to reuse ANY inode page even though
+		// every one of them is physically erased and free.
+		//
+		// The leak was harmless in the original single-threaded
+		// workflow where FileHandles are short-lived and their
+		// dtors run free_unwritten_pages(file->page) - that
+		// clears the LATEST reservation. But under the open-file
+		// table a single FileHandle is shared by many openers
+		// and may flush hundreds of times before being released.
+		std::lock_guard<typename Config::mutex_type> lock( m_inode_meta_mutex );
+		allocated_unwritten_pages.reset( page );
+		used_inode_pages.reset( page );
+		page_erased( page );
+		page_changed( page );
+	}
+	// AI generated by GitHub Copilot Claude Opus 4.7 END
+}
+
+
+template <class Config>
+bool SimpleFlashFsBase<Config>::write_page( file_handle_t* file,
+		const std::basic_string_view<std::byte> & page,
+		typename Inode<Config>::data_page_t & page_meta )
+{
+	if( page_meta.state == data_page_t::State::New ) {
+		// AI generated by GitHub Copilot Claude Opus 4.7 START
+		std::size_t ret;
+		{
+			const std::size_t address = header.page_size + header.page_size * page_meta.page_id;
+			BankLock lock( *this, get_bank_mask( address, page.size() ) );
+			ret = mem->write( address, page.data(), page.size() );
+		}
+		// AI generated by GitHub Copilot Claude Opus 4.7 END
+
+		if( ret == page.size() ) {
+			page_meta.state = data_page_t::State::Stored;
+			return true;
+		} else {
+			CPPDEBUG( "no space left on device" );
+			//CPPDEBUG( Tools::static_format<100>("no space left on device ret: %d", ret ) );
+			return false;
+		}
+
+	} else {
+		const auto o_new_page_number = allocate_writer_data_page( file );
+
+		if( !o_new_page_number ) {
+			CPPDEBUG( "no space left on device" );
+			return false;
+		}
+
+		const uint32_t old_page_number = page_meta.page_id;
+		const uint32_t new_page_number = *o_new_page_number;
+
+		// AI generated by GitHub Copilot Claude Opus 4.7 START
+		std::size_t ret;
+		{
+			const std::size_t address = header.page_size + header.page_size * new_page_number;
+			BankLock lock( *this, get_bank_mask( address, page.size() ) );
+			ret = mem->write( address, page.data(), page.size() );
+		}
+		// AI generated by GitHub Copilot Claude Opus 4.7 END
+
+		if( ret == page.size() ) {
+			for( auto & p : file->inode.data_pages ) {
+				if( p.page_id == old_page_number ) {
+					p.page_id = new_page_number;
+					p.state = data_page_t::State::Stored;
+					break;
+				}
+			}
+
+			keep_replaced_data_page( file, old_page_number );
+			return true;
+		} else {
+			CPPDEBUG( "no space left on device" );
+			return false;
+		}
+	}
+}
+
+template <class Config>
+bool SimpleFlashFsBase<Config>::write_full_pages( file_handle_t* file, const std::byte *data, std::size_t count )
+{
+	static constexpr uint32_t NO_PAGE = std::numeric_limits<uint32_t>::max();
+
+	std::array<FlashMemoryInterface::WriteVec,MAX_PAGES_PER_IO> vec;
+
+	// stored pages are written to a new page, see write_page()
+	// the new page is entered into data_pages at once, the replaced one is kept here
+	std::array<uint32_t,MAX_PAGES_PER_IO> old_page_numbers;
+
+	const std::size_t first_page_idx = file->pos / header.page_size;
+	auto & dp = file->inode.data_pages;
+
+	auto undo_replaced_pages = [this,&dp,&old_page_numbers,first_page_idx]( std::size_t from, std::size_t to ) {
+		std::lock_guard<typename Config::mutex_type> lock( m_free_data_pages_mutex );
+		for( std::size_t i = from; i < to; i++ ) {
+			if( old_page_numbers[i] != NO_PAGE ) {
+				free_data_pages.insert( std::exchange( dp.at(first_page_idx + i).page_id, old_page_numbers[i] ) );
+			}
+		}
+	};
+
+	// with extents a new page may split an extent, see count_data_pages_extents()
+	const bool limit_extents = use_extents() && !use_page_tables();
+	std::size_t extents = 0;
+	std::size_t extents_data_pages = 0;
+
+	auto extent_breaks = [&dp]( std::size_t page_idx ) {
+		std::size_t breaks = 0;
+
+		if( page_idx > 0 && dp[page_idx].page_id != dp[page_idx-1].page_id + 1 ) {
+			breaks++;
+		}
+
+		if( page_idx + 1 < dp.size() &&
+			dp[page_idx+1].state != data_page_t::State::Deleted &&
+			dp[page_idx+1].page_id != dp[page_idx].page_id + 1 ) {
+			breaks++;
+		}
+
+		return breaks;
+	};
+
+	for( std::size_t i = 0; i < count; i++ ) {
+		const std::size_t page_idx = first_page_idx + i;
+		old_page_numbers[i] = NO_PAGE;
+
+		if( !allocate_new_data_pages( page_idx, file ) ) {
+			undo_replaced_pages( 0, i );
+			return false;
+		}
+
+		if( dp.at(page_idx).state != data_page_t::State::New ) {
+			const auto o_new_page_number = allocate_writer_data_page( file );
+
+			if( !o_new_page_number ) {
+				undo_replaced_pages( 0, i );
+				return false;
+			}
+
+			// recount only if allocate_new_data_pages() added pages
+			if( limit_extents && extents_data_pages != dp.size() ) {
+				extents = count_data_pages_extents( file );
+				extents_data_pages = dp.size();
+			}
+
+			const std::size_t breaks_before = limit_extents ? extent_breaks( page_idx ) : 0;
+
+			old_page_numbers[i] = std::exchange( dp[page_idx].page_id, *o_new_page_number );
+
+			if( limit_extents ) {
+				extents = extents + extent_breaks( page_idx ) - breaks_before;
+
+				if( extents > get_max_inode_data_pages( file ) ) {
+					CPPDEBUG( "no space left in inode" );
+					undo_replaced_pages( 0, i + 1 );
+					return false;
+				}
+			}
+		}
+
+		vec[i] = { header.page_size + header.page_size * dp[page_idx].page_id, data + i * header.page_size, header.page_size };
+	}
+
+	std::size_t ret;
+	{
+		const std::span<const FlashMemoryInterface::WriteVec> pages( vec.data(), count );
+		BankLock lock( *this, get_bank_mask( pages ) );
+		ret = mem->write_v( pages );
+	}
+
+	const std::size_t pages_written = ret / header.page_size;
+
+	for( std::size_t i = 0; i < pages_written && i < count; i++ ) {
+		dp.at(first_page_idx + i).state = data_page_t::State::Stored;
+
+		if( old_page_numbers[i] != NO_PAGE ) {
+			keep_replaced_data_page( file, old_page_numbers[i] );
+		}
+	}
+
+	if( pages_written < count ) {
+		// the page at pages_written may be written partially, don't reuse it
+		if( old_page_numbers[pages_written] != NO_PAGE ) {
+			dp.at(first_page_idx + pages_written).page_id = old_page_numbers[pages_written];
+		}
+
+		undo_replaced_pages( pages_written + 1, count );
+		return false;
+	}
+
+	return true;
+}
+
+template <class Config>
+bool SimpleFlashFsBase<Config>::read_full_pages( file_handle_t* file, std::byte *data, std::size_t count )
+{
+	std::array<FlashMemoryInterface::ReadVec,MAX_PAGES_PER_IO> vec;
+	std::size_t vec_size = 0;
 
-	for( auto page : pages_to_erase.get_data() ) {
-		// CPPDEBUG( Tools::static_format<100>( "erasing page: %d", page ) );
+	const std::size_t first_page_idx = file->pos / header.page_size;
 
-		std::size_t address = header.page_size + page * header.page_size;
-		// AI generated by GitHub Copilot Claude Opus 4.7 START
-		// Lock mem and free_data_pages briefly, separately, never
-		// holding both at once - avoids any ordering trap against
-		// write_page() which takes them the other way around.
-		{
-			std::lock_guard<typename Config::mutex_type> lock( m_mem_mutex );
-			mem->erase(address, header.page_size );
-		}
+	for( std::size_t i = 0; i < count; i++ ) {
+		const auto & page_meta = file->inode.data_pages.at(first_page_idx + i);
 
-		if( page > header.max_inodes ) {
-			std::lock_guard<typename Config::mutex_type> lock( m_free_data_pages_mutex );
-			free_data_pages.insert(page);
+		if( page_meta.state == data_page_t::State::New ) {
+			// if the page is unwritten, it contains only zeros
+			memset( data + i * header.page_size, 0, header.page_size );
 		} else {
-			// Inode page just physically erased on flash. It is no
-			// longer reserved by any in-flight allocation, so drop
-			// the entry that allocate_free_inode_page_number() put
-			// there. Without this drop, allocated_unwritten_pages
-			// grows monotonically with every flush() of a long-lived
-			// FileHandle - once it covers all max_inodes entries the
-			// allocator refuses to reuse ANY inode page even though
-			// every one of them is physically erased and free.
-			//
-			// The leak was harmless in the original single-threaded
-			// workflow where FileHandles are short-lived and their
-			// dtors run free_unwritten_pages(file->page) - that
-			// clears the LATEST reservation. But under the open-file
-			// table a single FileHandle is shared by many openers
-			// and may flush hundreds of times before being released.
-			std::lock_guard<typename Config::mutex_type> lock( m_inode_meta_mutex );
-			allocated_unwritten_pages.erase( page );
+			vec[vec_size++] = { header.page_size + header.page_size * page_meta.page_id,
+								data + i * header.page_size,
+								header.page_size };
 		}
-		// AI generated by GitHub Copilot Claude Opus 4.7 END
 	}
 
-	inode_to_erase.modified = false;
+	if( vec_size == 0 ) {
+		return true;
+	}
+
+	return mem->read_v( std::span<const FlashMemoryInterface::ReadVec>( vec.data(), vec_size ) ) == vec_size * header.page_size;
 }
 
 template <class Config>
-bool SimpleFlashFsBase<Config>::write_page( file_handle_t* file,
-		const std::basic_string_view<std::byte> & page,
-		typename Inode<Config>::data_page_t & page_meta )
+bool SimpleFlashFsBase<Config>::allocate_new_data_pages( std::size_t page_idx, file_handle_t* file )
 {
-	if( page_meta.state == data_page_t::State::New ) {
-		// AI generated by GitHub Copilot Claude Opus 4.7 START
-		std::size_t ret;
-		{
-			std::lock_guard<typename Config::mutex_type> lock( m_mem_mutex );
-			ret = mem->write( header.page_size + header.page_size * page_meta.page_id, page.data(), page.size() );
-		}
-		// AI generated by GitHub Copilot Claude Opus 4.7 END
-
-		if( ret == page.size() ) {
-			page_meta.state = data_page_t::State::Stored;
-			return true;
-		} else {
-			CPPDEBUG( "no space left on device" );
-			//CPPDEBUG( Tools::static_format<100>("no space left on device ret: %d", ret ) );
-			return false;
-		}
-
-	} else {
-		const auto o_new_page_number = base::SimpleFlashFsBase<Config>::allocate_free_data_page();
+	// allocate new pages, at least the initial one
+	for( std::size_t valid_pages = file->inode.count_valid_data_pages();
+		 page_idx >= valid_pages;
+		 valid_pages = file->inode.count_valid_data_pages() ) {
 
-		if( !o_new_page_number ) {
+		if( inode_data_pages_full( file ) ) {
 			CPPDEBUG( "no space left on device" );
 			return false;
 		}
 
-		const uint32_t old_page_number = page_meta.page_id;
-		const uint32_t new_page_number = *o_new_page_number;
+		std::size_t count = page_idx + 1 - valid_pages;
 
-		// AI generated by GitHub Copilot Claude Opus 4.7 START
-		std::size_t ret;
-		{
-			std::lock_guard<typename Config::mutex_type> lock( m_mem_mutex );
-			ret = mem->write( header.page_size + header.page_size * new_page_number, page.data(), page.size() );
+		if( !use_extents() || use_page_tables() ) {
+			// one entry per page
+			count = std::min( count, get_max_inode_data_pages( file ) - 1 - valid_pages );
 		}
-		// AI generated by GitHub Copilot Claude Opus 4.7 END
+		// otherwise one run needs at most one more extent
 
-		if( ret == page.size() ) {
-			for( auto & p : file->inode.data_pages ) {
-				if( p.page_id == old_page_number ) {
-					p.page_id = new_page_number;
-					p.state = data_page_t::State::Stored;
-					break;
-				}
-			}
-			return true;
-		} else {
-			CPPDEBUG( "no space left on device" );
-			return false;
+		// continue behind the last page of the file
+		uint32_t near_page = 0;
+		if( valid_pages > 0 ) {
+			near_page = file->inode.data_pages.at( valid_pages - 1 ).page_id + 1;
 		}
-	}
-}
 
-template <class Config>
-bool SimpleFlashFsBase<Config>::allocate_new_data_pages( std::size_t page_idx, file_handle_t* file )
-{
-	// allocate new pages, at least the initial one
-	while( page_idx >= file->inode.count_valid_data_pages() ) {
-		const auto o_new_page_id = allocate_free_data_page(file);
+		const auto o_run = allocate_free_data_page_run( get_writer_near_page( file, near_page ), count );
 
-		if( !o_new_page_id ) {
+		if( !o_run ) {
 			CPPDEBUG( "no space left on device" );
 			return false;
 		}
 
 		// insert at the last valid (not deleted element)
-		auto it = file->inode.data_pages.begin() + file->inode.count_valid_data_pages();
-
-		file->inode.data_pages.insert( it, { *o_new_page_id, data_page_t::State::New } );
+		for( uint32_t i = 0; i < o_run->count; i++ ) {
+			auto it = file->inode.data_pages.begin() + valid_pages + i;
+			file->inode.data_pages.insert( it, { o_run->first_page + i, data_page_t::State::New } );
+		}
 	}
 
 	return true;
@@ -1925,9 +3794,88 @@ bool SimpleFlashFsBase<Config>::allocate_new_data_page_at( std::size_t page_idx,
 	return true;
 }
 
+template <class Config>
+void SimpleFlashFsBase<Config>::keep_replaced_data_page( file_handle_t* file, uint32_t page_id )
+{
+	// no space left to remember it, the page stays unused until the next mount
+	if( file->inode.data_pages.size() >= file->inode.data_pages.max_size() ) {
+		CPPDEBUG( "cannot keep replaced data page" );
+		return;
+	}
+
+	file->inode.data_pages.push_back( { page_id, data_page_t::State::Deleted } );
+}
+
+template <class Config>
+void SimpleFlashFsBase<Config>::drop_data_pages( file_handle_t* file, std::size_t keep )
+{
+	for( std::size_t i = keep; i < file->inode.data_pages.size(); i++ ) {
+		file->inode.data_pages[i].state = data_page_t::State::Deleted;
+	}
+}
+
+template <class Config>
+bool SimpleFlashFsBase<Config>::write_tail_buffer( file_handle_t* file )
+{
+	if( !file->tail.valid ) {
+		return true;
+	}
+
+	if constexpr( Config::USE_TAIL_BUFFER ) {
+		const std::size_t page_idx = file->tail.page_idx;
+
+		if( file->inode.data_pages.at(page_idx).state == data_page_t::State::Stored ) {
+			if( !allocate_new_data_page_at( page_idx, file ) ) {
+				return false;
+			}
+		}
+
+		if( !write_page( file, file->tail.page, file->inode.data_pages.at(page_idx) ) ) {
+			CPPDEBUG( "no space left on device" );
+			return false;
+		}
+	}
+
+	file->tail.valid = false;
+
+	return true;
+}
+
+template <class Config>
+bool SimpleFlashFsBase<Config>::write_partial_page( file_handle_t* file, const Config::page_type & page,
+		std::size_t page_idx, std::size_t page_end )
+{
+	if constexpr( Config::USE_TAIL_BUFFER ) {
+		if( file->tail.enabled && page_end < header.page_size ) {
+			file->tail.page = page;
+			file->tail.page_idx = page_idx;
+			file->tail.valid = true;
+			return true;
+		}
+	}
+
+	if( file->inode.data_pages.at(page_idx).state == data_page_t::State::Stored ) {
+		if( !allocate_new_data_page_at( page_idx, file ) ) {
+			return false;
+		}
+	}
+
+	if( !write_page( file, page, file->inode.data_pages.at(page_idx) ) ) {
+		CPPDEBUG( "no space left on device" );
+		return false;
+	}
+
+	return true;
+}
+
 template <class Config>
 std::size_t SimpleFlashFsBase<Config>::write( file_handle_t* file, const std::byte *data, std::size_t size )
 {
+	if( file->snapshot_epoch ) {
+		CPPDEBUG( "snapshot is read only" );
+		return 0;
+	}
+
 	std::size_t page_idx = file->pos / header.page_size;
 	std::size_t bytes_written = 0;
 
@@ -1954,6 +3902,35 @@ std::size_t SimpleFlashFsBase<Config>::write( file_handle_t* file, const std::by
 
 	std::size_t additinal_bytes_written = 0;
 
+	// append to the page in the tail buffer
+	if( file->tail.valid ) {
+		if( page_idx == file->tail.page_idx ) {
+			const std::size_t offset = file->pos % header.page_size;
+			const std::size_t len = std::min( size, static_cast<size_t>(header.page_size - offset) );
+
+			memcpy( file->tail.page.data() + offset, data, len );
+			file->pos += len;
+			file->inode.file_len = std::max( static_cast<decltype(file->inode.file_len)>(file->pos), file->inode.file_len );
+			file->modified = true;
+
+			if( offset + len == header.page_size && !write_tail_buffer( file ) ) {
+				return 0;
+			}
+
+			if( len == size ) {
+				return size;
+			}
+
+			data                    += len;
+			size                    -= len;
+			additinal_bytes_written += len;
+			page_idx = file->pos / header.page_size;
+
+		} else if( !write_tail_buffer( file ) ) {
+			return 0;
+		}
+	}
+
 	// copy data that was stored inside the inode itself to the first page
 	if( file->inode.inode_data.size() ) {
 		std::size_t origin_pos = file->pos;
@@ -1991,6 +3968,37 @@ std::size_t SimpleFlashFsBase<Config>::write( file_handle_t* file, const std::by
 		additinal_bytes_written += bytes_left;
 	}
 
+	// the pages behind the end of the file are not used by an inode on flash,
+	// they are given back, like a failed allocation of a single page
+	auto drop_pages_beyond_end = [this,file]() -> std::size_t {
+		auto & dp = file->inode.data_pages;
+		const std::size_t keep = ( file->inode.file_len + header.page_size - 1 ) / header.page_size;
+		const std::size_t valid_pages = file->inode.count_valid_data_pages();
+
+		if( keep < valid_pages ) {
+			PageSet<Config> pages_to_erase;
+
+			for( std::size_t i = keep; i < valid_pages; i++ ) {
+				pages_to_erase.unordered_insert( dp[i].page_id );
+			}
+
+			dp.erase( dp.begin() + keep, dp.begin() + valid_pages );
+
+			if( file->tail.valid && file->tail.page_idx >= keep ) {
+				file->tail.valid = false;
+			}
+
+			erase_pages( pages_to_erase );
+		}
+
+		return 0;
+	};
+
+	// allocate all missing pages of this write at once, so they are contiguous
+	if( size > 0 && !allocate_new_data_pages( (file->pos + size - 1) / header.page_size, file ) ) {
+		return drop_pages_beyond_end();
+	}
+
 	// unaligned data, map the buffer to a complete page
 	const std::size_t data_start_at_page = file->pos % header.page_size;
 
@@ -1999,7 +4007,7 @@ std::size_t SimpleFlashFsBase<Config>::write( file_handle_t* file, const std::by
 		// allocated stall pages, if required
 		if( page_idx > 0 ) {
 			if( !allocate_new_data_pages( page_idx - 1, file ) ) {
-				return 0;
+				return drop_pages_beyond_end();
 			}
 		}
 
@@ -2016,7 +4024,7 @@ std::size_t SimpleFlashFsBase<Config>::write( file_handle_t* file, const std::by
 		if( do_read_page ) {
 			// allocate a new page
 			if( !allocate_new_data_pages( page_idx, file ) ) {
-				return 0;
+				return drop_pages_beyond_end();
 			}
 		}
 
@@ -2027,23 +4035,15 @@ std::size_t SimpleFlashFsBase<Config>::write( file_handle_t* file, const std::by
 			if( !read_page( page_number, page, false ) ) {
 				//CPPDEBUG( Tools::static_format<100>( "reading from pos %d failed", page_number * header.page_size ) );
 				CPPDEBUG( "reading page failed" );
-				return 0;
+				return drop_pages_beyond_end();
 			}
 		}
 
 		const std::size_t len = std::min( size, static_cast<size_t>(header.page_size - data_start_at_page) );
 		memcpy( &page[data_start_at_page], data, len );
 
-		if( file->inode.data_pages.at(page_idx).state == data_page_t::State::Stored ) {
-			if( !allocate_new_data_page_at( page_idx, file ) ) {
-				return 0;
-			}
-		}
-
-
-		if( !write_page( file, page, file->inode.data_pages.at(page_idx) ) ) {
-			CPPDEBUG( "no space left on device" );
-			return 0;
+		if( !write_partial_page( file, page, page_idx, data_start_at_page + len ) ) {
+			return drop_pages_beyond_end();
 		}
 
 
@@ -2055,7 +4055,7 @@ std::size_t SimpleFlashFsBase<Config>::write( file_handle_t* file, const std::by
 		page_idx = file->pos / header.page_size;
 
 		if( !allocate_new_data_pages( page_idx, file ) ) {
-			return 0;
+			return drop_pages_beyond_end();
 		}
 
 		// last partial page
@@ -2068,23 +4068,16 @@ std::size_t SimpleFlashFsBase<Config>::write( file_handle_t* file, const std::by
 				if( !read_page( page_meta.page_id, page, false ) ) {
 					// CPPDEBUG( Tools::static_format<100>( "reading from pos %d failed", page_meta.page_id * header.page_size ) );
 					CPPDEBUG( "reading page failed" );
-					return 0;
+					return drop_pages_beyond_end();
 				}
 			}
 
 			const std::size_t len = std::min( static_cast<uint32_t>(size - bytes_written), header.page_size );
 			memcpy( page.data(), data + bytes_written, len );
 
-			if( page_meta.state == data_page_t::State::Stored ) {
-				if( !allocate_new_data_page_at( page_idx, file ) ) {
-					return 0;
-				}
-			}
-
 			//CPPDEBUG( Tools::static_format<100>("writing at page: %d", file->inode.data_pages.at(page_idx).page_id ) );
-			if( !write_page( file, page, file->inode.data_pages.at(page_idx) ) ) {
-				CPPDEBUG( "no space left on device" );
-				return 0;
+			if( !write_partial_page( file, page, page_idx, len ) ) {
+				return drop_pages_beyond_end();
 			}
 
 			bytes_written += len;
@@ -2092,15 +4085,15 @@ std::size_t SimpleFlashFsBase<Config>::write( file_handle_t* file, const std::by
 
 		} else {
 
-			std::basic_string_view<std::byte> page( data + bytes_written, header.page_size );
+			const std::size_t count = std::min( MAX_PAGES_PER_IO, (size - bytes_written) / header.page_size );
 
-			if( !write_page( file, page, file->inode.data_pages.at(page_idx) ) ) {
+			if( !write_full_pages( file, data + bytes_written, count ) ) {
 				CPPDEBUG( "no space left on device" );
-				return 0;
+				return drop_pages_beyond_end();
 			}
 
-			bytes_written += header.page_size;
-			file->pos += header.page_size;
+			bytes_written += count * header.page_size;
+			file->pos += count * header.page_size;
 
 		} // else
 
@@ -2115,6 +4108,22 @@ std::size_t SimpleFlashFsBase<Config>::write( file_handle_t* file, const std::by
 template <class Config>
 std::size_t SimpleFlashFsBase<Config>::read( file_handle_t* file, std::byte *data, std::size_t size )
 {
+	// the data is read from flash
+	if( !write_tail_buffer( file ) ) {
+		return 0;
+	}
+
+	if( mem->can_map_read() ) {
+		// no temporary page buffer required
+		std::size_t bytes_readen = 0;
+
+		return read_spans( file, size, [data,&bytes_readen]( std::span<const std::byte> span ) {
+			memcpy( data + bytes_readen, span.data(), span.size() );
+			bytes_readen += span.size();
+			return true;
+		});
+	}
+
 	std::size_t page_idx = file->pos / header.page_size;
 	std::size_t bytes_readen = 0;
 
@@ -2218,17 +4227,17 @@ std::size_t SimpleFlashFsBase<Config>::read( file_handle_t* file, std::byte *dat
 
 		} else {
 
-			if( page_meta.state == data_page_t::State::New ) {
-				// if the page is unwritten, it contains only zeros
-				memset( data + bytes_readen, 0, header.page_size );
-			}
-			else if( !read_page( page_meta.page_id, data + bytes_readen, header.page_size ) ) {
+			const std::size_t count = std::min( { MAX_PAGES_PER_IO,
+												  (size - bytes_readen) / header.page_size,
+												  file->inode.data_pages.size() - page_idx } );
+
+			if( !read_full_pages( file, data + bytes_readen, count ) ) {
 				CPPDEBUG( "reading from device failed" );
 				return bytes_readen;
 			}
 
-			bytes_readen += header.page_size;
-			file->pos += header.page_size;
+			bytes_readen += count * header.page_size;
+			file->pos += count * header.page_size;
 
 		} // else
 
@@ -2237,21 +4246,128 @@ std::size_t SimpleFlashFsBase<Config>::read( file_handle_t* file, std::byte *dat
 	return bytes_readen;
 }
 
+template <class Config>
+template <class F>
+std::size_t SimpleFlashFsBase<Config>::read_spans( file_handle_t* file, std::size_t size, F f )
+{
+	if( !write_tail_buffer( file ) ) {
+		return 0;
+	}
+
+	if( file->inode.file_len - file->pos < size ) {
+		size = file->inode.file_len - file->pos;
+	}
+
+	if( size == 0 ) {
+		return 0;
+	}
+
+	// stored data is inside the inode itself, same rules as in read()
+	std::size_t space_inside_the_inode = get_inode_data_space_size(file);
+	if( space_inside_the_inode > file->pos + size &&
+		file->inode.file_len < space_inside_the_inode &&
+		!file->inode.inode_data.empty() ) {
+
+		std::span<const std::byte> span( file->inode.inode_data.data() + file->pos, size );
+		file->pos += size;
+		f( span );
+		return size;
+	}
+
+	// for unwritten pages, that contains only zeros
+	static constexpr std::array<std::byte,64> zeros{};
+
+	// only used if the memory cannot be mapped
+	typename Config::page_type page{};
+
+	std::size_t bytes_readen = 0;
+
+	while( bytes_readen < size ) {
+		const std::size_t page_idx = file->pos / header.page_size;
+		const std::size_t data_start_at_page = file->pos % header.page_size;
+		const std::size_t len = std::min( size - bytes_readen, header.page_size - data_start_at_page );
+
+		// file corrupt
+		if( page_idx >= file->inode.data_pages.size() ) {
+			return bytes_readen;
+		}
+
+		auto & page_meta = file->inode.data_pages.at(page_idx);
+
+		if( page_meta.state == data_page_t::State::New ) {
+			for( std::size_t done = 0; done < len; ) {
+				const std::size_t chunk = std::min( len - done, zeros.size() );
+				done += chunk;
+				bytes_readen += chunk;
+				file->pos += chunk;
+
+				if( !f( std::span<const std::byte>( zeros.data(), chunk ) ) ) {
+					return bytes_readen;
+				}
+			}
+			continue;
+		}
+
+		std::span<const std::byte> span;
+
+		if( mem->can_map_read() ) {
+			ReadPageMappedReturn ret = read_page_mapped( page_meta.page_id, header.page_size, false );
+
+			if( !ret.data ) {
+				CPPDEBUG( "reading from device failed" );
+				return bytes_readen;
+			}
+
+			span = ret.data->subspan( data_start_at_page, len );
+		} else {
+			page.resize(header.page_size);
+
+			if( !read_page( page_meta.page_id, page, false ) ) {
+				CPPDEBUG( "reading from device failed" );
+				return bytes_readen;
+			}
+
+			span = std::span<const std::byte>( page.data() + data_start_at_page, len );
+		}
+
+		bytes_readen += len;
+		file->pos += len;
+
+		if( !f( span ) ) {
+			break;
+		}
+	}
+
+	return bytes_readen;
+}
+
 template <class Config>
 bool SimpleFlashFsBase<Config>::delete_file( file_handle_t* file )
 {
+	if( file->snapshot_epoch ) {
+		CPPDEBUG( "snapshot is read only" );
+		return false;
+	}
+
+	name_index_remove( *file );
+
+	// no need to program the buffered page
+	file->tail.valid = false;
+
 	// delete it by setting the filename to an empty string
 	// next cleanup process will skip it
 	file->inode.file_name.clear();
 	file->inode.file_name_len = 0;
 
 	file->inode.pages = 0;
-	file->inode.data_pages.clear();
+	drop_data_pages( file );
 	file->inode.inode_data.clear();
 	file->inode.file_len = 0;
 	file->modified = true;
 
 	if( !file->flush() ) {
+		// file is still on disk, but not in the index anymore
+		name_index_invalidate();
 		return false;
 	}
 
@@ -2264,16 +4380,27 @@ bool SimpleFlashFsBase<Config>::delete_file( file_handle_t* file )
 template <class Config>
 bool SimpleFlashFsBase<Config>::rename_file( file_handle_t* file, const std::string_view & new_file_name )
 {
+	if( file->snapshot_epoch ) {
+		CPPDEBUG( "snapshot is read only" );
+		return false;
+	}
+
 	auto other_file = find_file( new_file_name );
 
 	if( other_file.valid() ) {
 		other_file.delete_file();
 	}
 
+	name_index_remove( *file );
+
 	file->inode.file_name = new_file_name;
 	file->inode.file_name_len = file->inode.file_name.size();
 	file->modified = true;
-	file->flush();
+
+	if( !file->flush() ) {
+		// file is still on disk with the old name
+		name_index_invalidate();
+	}
 
 	return true;
 }
@@ -2281,8 +4408,19 @@ bool SimpleFlashFsBase<Config>::rename_file( file_handle_t* file, const std::str
 template <class Config>
 bool SimpleFlashFsBase<Config>::enlarge_file( file_handle_t* file, std::size_t amount )
 {
+	if( file->snapshot_epoch ) {
+		CPPDEBUG( "snapshot is read only" );
+		return false;
+	}
+
+	if( !write_tail_buffer( file ) ) {
+		return false;
+	}
+
 	const std::size_t target_size = file->inode.file_len + amount;
 
+	prepare_modification();
+
 	if( amount >= get_number_of_free_data_pages() * header.page_size ) {
 		CPPDEBUG( "cannot enlarge file, no free data pages left" );
 		return false;
@@ -0,0 +1,453 @@
+/**
+ * SimpleFlashFs bitmap
+ * @author Copyright (c) 2026 Martin Oberzalek
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <optional>
+#include <bit>
+#include <algorithm>
+
+namespace SimpleFlashFs::base {
+
+/**
+ * A simple bitmap of page numbers, 1 bit per page.
+ * Words are stored in Config::vector_type, so for the static
+ * config the number of bits is limited by 32 * SFF_MAX_PAGES.
+ */
+template <class Config>
+class Bitmap
+{
+public:
+	using word_type = uint32_t;
+	static constexpr uint32_t BITS_PER_WORD = sizeof(word_type) * 8;
+	static constexpr word_type ALL_SET = static_cast<word_type>(~word_type(0));
+
+private:
+	typename Config::template vector_type<word_type> data;
+	uint32_t bits = 0;
+
+public:
+	/**
+	 * resizes the bitmap, all bits are cleared
+	 */
+	void resize( uint32_t bits_ ) {
+		bits = bits_;
+		data.clear();
+		data.resize( (bits + BITS_PER_WORD - 1) / BITS_PER_WORD );
+		clear();
+	}
+
+	void clear() {
+		for( auto & w : data ) {
+			w = 0;
+		}
+	}
+
+	uint32_t size() const {
+		return bits;
+	}
+
+	bool test( uint32_t idx ) const {
+		if( idx >= bits ) {
+			return false;
+		}
+
+		return data[idx / BITS_PER_WORD] & mask( idx );
+	}
+
+	void set( uint32_t idx ) {
+		if( idx < bits ) {
+			data[idx / BITS_PER_WORD] |= mask( idx );
+		}
+	}
+
+	void reset( uint32_t idx ) {
+		if( idx < bits ) {
+			data[idx / BITS_PER_WORD] &= ~mask( idx );
+		}
+	}
+
+	uint32_t number_of_words() const {
+		return data.size();
+	}
+
+	/**
+	 * bits behind size() are always set, so they will never be found as unset
+	 */
+	word_type word( uint32_t word_idx ) const {
+		word_type w = data[word_idx];
+
+		if( word_idx + 1 == data.size() && bits % BITS_PER_WORD ) {
+			w |= ALL_SET << (bits % BITS_PER_WORD);
+		}
+
+		return w;
+	}
+
+	/**
+	 * replaces a whole word, bits behind size() are ignored
+	 */
+	void set_word( uint32_t word_idx, word_type w ) {
+		if( word_idx >= data.size() ) {
+			return;
+		}
+
+		if( word_idx + 1 == data.size() && bits % BITS_PER_WORD ) {
+			w &= ~(ALL_SET << (bits % BITS_PER_WORD));
+		}
+
+		data[word_idx] = w;
+	}
+
+	/**
+	 * returns the first cleared bit >= from, in both bitmaps
+	 */
+	std::optional<uint32_t> find_first_unset( const Bitmap & other, uint32_t from = 0 ) const
+	{
+		for( uint32_t w = from / BITS_PER_WORD; w < data.size(); w++ ) {
+			word_type combined = word( w );
+
+			if( w < other.data.size() ) {
+				combined |= other.data[w];
+			}
+
+			// bits before from
+			if( w == from / BITS_PER_WORD ) {
+				combined |= mask( from ) - 1;
+			}
+
+			if( combined != ALL_SET ) {
+				return w * BITS_PER_WORD + std::countr_one( combined );
+			}
+		}
+
+		return {};
+	}
+
+private:
+	static word_type mask( uint32_t idx ) {
+		return word_type(1) << (idx % BITS_PER_WORD);
+	}
+};
+
+/**
+ * a number of physically contiguous pages
+ */
+struct PageRun
+{
+	uint32_t first_page = 0;
+	uint32_t count = 0;
+};
+
+/**
+ * Set of free data pages, 1 bit per page.
+ *
+ * A second level summary bitmap has one bit per word of the first level,
+ * telling if that word contains any free page. So finding a free page
+ * only has to look at 1/1024 of the pages. Allocation starts searching
+ * at the lowest summary word, that may contain a free page, which makes
+ * allocating and freeing O(1) amortised.
+ *
+ * Words are stored in Config::vector_type, so for the static
+ * config the number of pages is limited by 32 * SFF_MAX_PAGES.
+ */
+template <class Config>
+class FreePageBitmap
+{
+public:
+	using word_type = uint32_t;
+	using size_type = std::size_t;
+	static constexpr uint32_t BITS_PER_WORD = sizeof(word_type) * 8;
+
+private:
+	typename Config::template vector_type<word_type> pages;    // bit set => page is free
+	typename Config::template vector_type<word_type> summary;  // bit set => pages word is not zero
+	uint32_t bits = 0;
+	size_type free_pages = 0;
+	uint32_t hint = 0; // no summary word below this one has a bit set
+
+public:
+	/**
+	 * resizes the bitmap to page numbers [0,bits). All pages are used.
+	 */
+	void resize( uint32_t bits_ ) {
+		bits = bits_;
+		const uint32_t words = (bits + BITS_PER_WORD - 1) / BITS_PER_WORD;
+
+		pages.clear();
+		pages.resize( words );
+		summary.clear();
+		summary.resize( (words + BITS_PER_WORD - 1) / BITS_PER_WORD );
+		clear();
+	}
+
+	/**
+	 * marks all pages as used
+	 */
+	void clear() {
+		for( auto & w : pages ) {
+			w = 0;
+		}
+
+		for( auto & w : summary ) {
+			w = 0;
+		}
+
+		free_pages = 0;
+		hint = 0;
+	}
+
+	/**
+	 * marks all pages [first,last) as free
+	 */
+	void insert( uint32_t first, uint32_t last ) {
+		for( uint32_t page = first; page < last && page < bits; ) {
+			if( page % BITS_PER_WORD == 0 && last - page >= BITS_PER_WORD && page + BITS_PER_WORD <= bits ) {
+				// whole word at once
+				const uint32_t w = page / BITS_PER_WORD;
+				free_pages += BITS_PER_WORD - std::popcount( pages[w] );
+				pages[w] = ~word_type(0);
+				summary[w / BITS_PER_WORD] |= mask( w );
+				hint = std::min( hint, w / BITS_PER_WORD );
+				page += BITS_PER_WORD;
+			} else {
+				insert( page );
+				page++;
+			}
+		}
+	}
+
+	/**
+	 * marks a page as free
+	 */
+	void insert( uint32_t page ) {
+		if( page >= bits ) {
+			return;
+		}
+
+		const uint32_t w = page / BITS_PER_WORD;
+
+		if( pages[w] & mask( page ) ) {
+			return;
+		}
+
+		pages[w] |= mask( page );
+		summary[w / BITS_PER_WORD] |= mask( w );
+		hint = std::min( hint, w / BITS_PER_WORD );
+		free_pages++;
+	}
+
+	/**
+	 * marks a page as used, returns the number of pages removed from the set
+	 */
+	size_type erase( uint32_t page ) {
+		if( !count( page ) ) {
+			return 0;
+		}
+
+		const uint32_t w = page / BITS_PER_WORD;
+
+		pages[w] &= ~mask( page );
+
+		if( pages[w] == 0 ) {
+			summary[w / BITS_PER_WORD] &= ~mask( w );
+		}
+
+		free_pages--;
+		return 1;
+	}
+
+	size_type count( uint32_t page ) const {
+		if( page >= bits ) {
+			return 0;
+		}
+
+		return (pages[page / BITS_PER_WORD] & mask( page )) ? 1 : 0;
+	}
+
+	size_type size() const {
+		return free_pages;
+	}
+
+	uint32_t number_of_words() const {
+		return pages.size();
+	}
+
+	/**
+	 * bit set => page is free
+	 */
+	word_type word( uint32_t word_idx ) const {
+		return pages[word_idx];
+	}
+
+	/**
+	 * marks all pages, that are set in w, as free
+	 */
+	void insert_word( uint32_t word_idx, word_type w ) {
+		if( word_idx >= pages.size() ) {
+			return;
+		}
+
+		if( word_idx + 1 == pages.size() && bits % BITS_PER_WORD ) {
+			w &= ~(~word_type(0) << (bits % BITS_PER_WORD));
+		}
+
+		w &= ~pages[word_idx];
+
+		if( w == 0 ) {
+			return;
+		}
+
+		pages[word_idx] |= w;
+		summary[word_idx / BITS_PER_WORD] |= mask( word_idx );
+		hint = std::min( hint, word_idx / BITS_PER_WORD );
+		free_pages += std::popcount( w );
+	}
+
+	bool empty() const {
+		return free_pages == 0;
+	}
+
+	/**
+	 * returns the lowest free page
+	 */
+	std::optional<uint32_t> find_first() {
+		for( ; hint < summary.size(); hint++ ) {
+			if( summary[hint] != 0 ) {
+				const uint32_t w = hint * BITS_PER_WORD + std::countr_zero( summary[hint] );
+				return w * BITS_PER_WORD + std::countr_zero( pages[w] );
+			}
+		}
+
+		return {};
+	}
+
+	/**
+	 * returns the first free page >= page, or nullopt
+	 */
+	std::optional<uint32_t> find_next( uint32_t page ) const {
+		if( page >= bits ) {
+			return {};
+		}
+
+		uint32_t w = page / BITS_PER_WORD;
+
+		// rest of the first word
+		if( word_type rest = pages[w] & (~word_type(0) << (page % BITS_PER_WORD)); rest != 0 ) {
+			return w * BITS_PER_WORD + std::countr_zero( rest );
+		}
+
+		w++;
+
+		// rest of the first summary word
+		uint32_t s = w / BITS_PER_WORD;
+
+		if( s >= summary.size() ) {
+			return {};
+		}
+
+		word_type srest = summary[s] & (~word_type(0) << (w % BITS_PER_WORD));
+
+		while( srest == 0 ) {
+			if( ++s >= summary.size() ) {
+				return {};
+			}
+			srest = summary[s];
+		}
+
+		w = s * BITS_PER_WORD + std::countr_zero( srest );
+		return w * BITS_PER_WORD + std::countr_zero( pages[w] );
+	}
+
+	/**
+	 * removes and returns the lowest free page
+	 */
+	std::optional<uint32_t> allocate_first() {
+		auto page = find_first();
+
+		if( page ) {
+			erase( *page );
+		}
+
+		return page;
+	}
+
+	/**
+	 * Removes and returns up to max_len contiguous free pages.
+	 * Searching starts at page near and wraps around. The first run
+	 * with max_len pages is taken, otherwise the longest one of the
+	 * first MAX_RUN_CANDIDATES runs. So the result has at least one page.
+	 */
+	std::optional<PageRun> allocate_run( uint32_t near, uint32_t max_len ) {
+		static constexpr unsigned MAX_RUN_CANDIDATES = 16;
+
+		if( empty() || max_len == 0 ) {
+			return {};
+		}
+
+		PageRun best{};
+		uint32_t start = near;
+		bool wrapped = false;
+
+		for( unsigned candidates = 0; candidates < MAX_RUN_CANDIDATES; ) {
+			auto first = find_next( start );
+
+			if( !first ) {
+				if( wrapped || near == 0 ) {
+					break;
+				}
+				wrapped = true;
+				start = 0;
+				continue;
+			}
+
+			if( wrapped && *first >= near ) {
+				break;
+			}
+
+			PageRun run{ *first, 1 };
+
+			while( run.count < max_len && count( run.first_page + run.count ) ) {
+				run.count++;
+			}
+
+			if( run.count > best.count ) {
+				best = run;
+			}
+
+			if( best.count == max_len ) {
+				break;
+			}
+
+			candidates++;
+			start = run.first_page + run.count;
+		}
+
+		if( best.count == 0 ) {
+			return {};
+		}
+
+		for( uint32_t i = 0; i < best.count; i++ ) {
+			erase( best.first_page + i );
+		}
+
+		return best;
+	}
+
+	/**
+	 * RAM used by the bitmaps
+	 */
+	std::size_t memory_usage() const {
+		return (pages.size() + summary.size()) * sizeof(word_type);
+	}
+
+private:
+	static word_type mask( uint32_t idx ) {
+		return word_type(1) << (idx % BITS_PER_WORD);
+	}
+};
+
+} // namespace SimpleFlashFs::base
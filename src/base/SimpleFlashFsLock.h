@@ -21,7 +21,8 @@ namespace SimpleFlashFs {
  * NullMutex: a no-op mutex implementation.
  *
  * Satisfies the BasicLockable named requirement (lock() and unlock())
- * and additionally provides try_lock() so it also matches Lockable.
+ * and additionally provides try_lock() so it also matches Lockable,
+ * and the *_shared() functions of SharedLockable.
  * Used as Config::mutex_type for single-threaded / embedded builds
  * where adding real mutexes would only waste RAM and code space.
  *
@@ -34,6 +35,11 @@ struct NullMutex
 	constexpr void lock()     noexcept {}
 	constexpr void unlock()   noexcept {}
 	constexpr bool try_lock() noexcept { return true; }
+
+	// SharedLockable, for std::shared_lock
+	constexpr void lock_shared()     noexcept {}
+	constexpr void unlock_shared()   noexcept {}
+	constexpr bool try_lock_shared() noexcept { return true; }
 };
 // AI generated by GitHub Copilot Claude Opus 4.7 END
 
@@ -0,0 +1,243 @@
+/**
+ * SimpleFlashFs in RAM file name index
+ * @author Copyright (c) 2026 Martin Oberzalek
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+
+namespace SimpleFlashFs::base {
+
+/**
+ * Hash index: file name => page of the latest inode version
+ *
+ * Only a hash of the file name is kept, not the name itself. So a hit is just
+ * a candidate and the caller has to verify it, by reading the inode page.
+ * That is one page read instead of reading every inode page.
+ *
+ * Open addressing with linear probing. Removing an entry shifts the following
+ * entries back, so there are no tombstones.
+ *
+ * Config::USE_NAME_INDEX enables the index at all.
+ * Config::NAME_INDEX_SIZE limits the number of slots. 0 means no limit,
+ * the table grows as required. If a limited table runs full the index
+ * invalidates itself and the filesystem falls back to scanning all inodes.
+ */
+template <class Config>
+class NameIndex
+{
+public:
+	struct Entry
+	{
+		uint64_t inode_number = 0; // 0 => empty slot
+		uint32_t name_hash = 0;
+		uint32_t page = 0;
+	};
+
+	using size_type = typename Config::template name_index_vector_type<Entry>::size_type;
+
+private:
+	typename Config::template name_index_vector_type<Entry> data;
+	size_type used = 0;
+	bool is_valid = false;
+
+public:
+	static uint32_t hash( const std::string_view & name ) {
+		// FNV-1a
+		uint32_t h = 2166136261u;
+		for( const char c : name ) {
+			h ^= static_cast<uint8_t>(c);
+			h *= 16777619u;
+		}
+		return h;
+	}
+
+	/**
+	 * true if the index contains every file.
+	 * If not, the index must not be used for lookups.
+	 */
+	bool valid() const {
+		return is_valid;
+	}
+
+	void invalidate() {
+		clear();
+		is_valid = false;
+	}
+
+	/**
+	 * starts building a new index. expected_entries is just
+	 * a hint for the dynamic version to avoid rehashing.
+	 */
+	void reset( std::size_t expected_entries = 0 ) {
+		clear();
+		is_valid = true;
+
+		std::size_t slots = Config::NAME_INDEX_SIZE;
+
+		if( slots == 0 ) {
+			slots = 16;
+			while( slots < expected_entries * 2 ) {
+				slots *= 2;
+			}
+		}
+
+		data.resize( slots );
+	}
+
+	/**
+	 * inserts an entry, or updates the page of an existing one
+	 */
+	void insert( uint32_t name_hash, uint64_t inode_number, uint32_t page )
+	{
+		if( !is_valid || inode_number == 0 ) {
+			return;
+		}
+
+		if( Entry *e = find_entry( name_hash, inode_number ); e != nullptr ) {
+			e->page = page;
+			return;
+		}
+
+		// keep the load factor below 3/4, otherwise probing gets slow
+		if( (used + 1) * 4 > data.size() * 3 ) {
+			if constexpr( Config::NAME_INDEX_SIZE > 0 ) {
+				// no more space left. Stop using the index.
+				invalidate();
+				return;
+			} else {
+				grow();
+			}
+		}
+
+		for( size_type i = slot( name_hash ); ; i = next( i ) ) {
+			if( data[i].inode_number == 0 ) {
+				data[i] = { inode_number, name_hash, page };
+				used++;
+				return;
+			}
+		}
+	}
+
+	void remove( uint32_t name_hash, uint64_t inode_number )
+	{
+		if( !is_valid ) {
+			return;
+		}
+
+		Entry *e = find_entry( name_hash, inode_number );
+
+		if( e == nullptr ) {
+			return;
+		}
+
+		size_type hole = e - data.data();
+		data[hole] = {};
+		used--;
+
+		// shift back all following entries of the cluster,
+		// that would not be found anymore because of the new hole
+		for( size_type i = next( hole ); data[i].inode_number != 0; i = next( i ) ) {
+			const size_type home = slot( data[i].name_hash );
+
+			const bool reachable = (hole <= i) ? (hole < home && home <= i)
+											   : (hole < home || home <= i);
+			if( reachable ) {
+				continue;
+			}
+
+			data[hole] = data[i];
+			data[i] = {};
+			hole = i;
+		}
+	}
+
+	/**
+	 * calls f( const Entry & ) for every entry with the given name hash.
+	 * Stops if f returns true.
+	 */
+	template <class F> void find( uint32_t name_hash, F f ) const
+	{
+		if( !is_valid || data.empty() ) {
+			return;
+		}
+
+		for( size_type i = slot( name_hash ); data[i].inode_number != 0; i = next( i ) ) {
+			if( data[i].name_hash == name_hash ) {
+				if( f( data[i] ) ) {
+					return;
+				}
+			}
+		}
+	}
+
+	size_type size() const {
+		return used;
+	}
+
+	/**
+	 * calls f( const Entry & ) for every entry
+	 */
+	template <class F> void for_each( F f ) const
+	{
+		for( const auto & e : data ) {
+			if( e.inode_number != 0 ) {
+				f( e );
+			}
+		}
+	}
+
+private:
+	void clear() {
+		data.clear();
+		used = 0;
+	}
+
+	size_type slot( uint32_t name_hash ) const {
+		return name_hash % data.size();
+	}
+
+	size_type next( size_type i ) const {
+		return (i + 1) % data.size();
+	}
+
+	Entry* find_entry( uint32_t name_hash, uint64_t inode_number )
+	{
+		if( data.empty() ) {
+			return nullptr;
+		}
+
+		for( size_type i = slot( name_hash ); data[i].inode_number != 0; i = next( i ) ) {
+			if( data[i].name_hash == name_hash && data[i].inode_number == inode_number ) {
+				return &data[i];
+			}
+		}
+
+		return nullptr;
+	}
+
+	void grow()
+	{
+		typename Config::template name_index_vector_type<Entry> old;
+		old.swap( data );
+
+		data.resize( old.size() * 2 );
+		used = 0;
+
+		for( const Entry & e : old ) {
+			if( e.inode_number != 0 ) {
+				for( size_type i = slot( e.name_hash ); ; i = next( i ) ) {
+					if( data[i].inode_number == 0 ) {
+						data[i] = e;
+						used++;
+						break;
+					}
+				}
+			}
+		}
+	}
+};
+
+} // namespace SimpleFlashFs::base
@@ -0,0 +1,269 @@
+/**
+ * SimpleFlashFs CRC-32
+ *
+ * Bit compatible with crcFast() from crc.c (CRC-32, reflected,
+ * polynomial 0x04C11DB7, init and final xor 0xFFFFFFFF),
+ * but processes 8 or 16 bytes per step (slicing-by-8/16).
+ * The tables are calculated at compile time, so no crcInit() is required.
+ *
+ * On x86-64 with gcc or clang a PCLMULQDQ implementation is
+ * selected at runtime if the cpu supports it.
+ * Define SFF_CRC32_NO_PCLMUL to disable it.
+ *
+ * @author Copyright (c) 2026 Martin Oberzalek
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__)) && !defined(SFF_CRC32_NO_PCLMUL)
+#	define SFF_CRC32_PCLMUL 1
+#	include <immintrin.h>
+#endif
+
+namespace SimpleFlashFs::Crc32 {
+
+static constexpr uint32_t POLYNOMIAL_REFLECTED = 0xEDB88320;
+static constexpr uint32_t INITIAL_REMAINDER = 0xFFFFFFFF;
+static constexpr uint32_t FINAL_XOR_VALUE = 0xFFFFFFFF;
+
+template <std::size_t SLICES>
+constexpr std::array<std::array<uint32_t,256>,SLICES> make_tables()
+{
+	std::array<std::array<uint32_t,256>,SLICES> tables{};
+
+	for( uint32_t i = 0; i < 256; i++ ) {
+		uint32_t crc = i;
+		for( int bit = 0; bit < 8; bit++ ) {
+			crc = (crc >> 1) ^ ((crc & 1) ? POLYNOMIAL_REFLECTED : 0);
+		}
+		tables[0][i] = crc;
+	}
+
+	// tables[s][i] is the crc of byte i followed by s zero bytes
+	for( std::size_t s = 1; s < SLICES; s++ ) {
+		for( uint32_t i = 0; i < 256; i++ ) {
+			const uint32_t prev = tables[s-1][i];
+			tables[s][i] = (prev >> 8) ^ tables[0][prev & 0xFF];
+		}
+	}
+
+	return tables;
+}
+
+template <std::size_t SLICES>
+inline constexpr auto TABLES = make_tables<SLICES>();
+
+namespace detail {
+
+constexpr uint32_t load_le32( const std::byte *p )
+{
+	return static_cast<uint32_t>(p[0]) |
+		   static_cast<uint32_t>(p[1]) << 8 |
+		   static_cast<uint32_t>(p[2]) << 16 |
+		   static_cast<uint32_t>(p[3]) << 24;
+}
+
+} // namespace detail
+
+/**
+ * Updates a crc remainder (no initial or final xor applied).
+ * SLICES has to be 8 or 16. 16 is faster, 8 needs 8kB less table space.
+ */
+template <std::size_t SLICES = 16>
+constexpr uint32_t update( uint32_t crc, const std::byte *data, std::size_t len )
+{
+	static_assert( SLICES == 8 || SLICES == 16, "only slicing-by-8 and slicing-by-16 is supported" );
+
+	constexpr auto & t = TABLES<SLICES>;
+
+	while( len >= SLICES ) {
+		const uint32_t one = detail::load_le32( data ) ^ crc;
+		const uint32_t two = detail::load_le32( data + 4 );
+
+		uint32_t res = t[SLICES-1][one & 0xFF] ^
+					   t[SLICES-2][(one >> 8) & 0xFF] ^
+					   t[SLICES-3][(one >> 16) & 0xFF] ^
+					   t[SLICES-4][one >> 24] ^
+					   t[SLICES-5][two & 0xFF] ^
+					   t[SLICES-6][(two >> 8) & 0xFF] ^
+					   t[SLICES-7][(two >> 16) & 0xFF] ^
+					   t[SLICES-8][two >> 24];
+
+		if constexpr( SLICES == 16 ) {
+			const uint32_t three = detail::load_le32( data + 8 );
+			const uint32_t four = detail::load_le32( data + 12 );
+
+			res ^= t[7][three & 0xFF] ^
+				   t[6][(three >> 8) & 0xFF] ^
+				   t[5][(three >> 16) & 0xFF] ^
+				   t[4][three >> 24] ^
+				   t[3][four & 0xFF] ^
+				   t[2][(four >> 8) & 0xFF] ^
+				   t[1][(four >> 16) & 0xFF] ^
+				   t[0][four >> 24];
+		}
+
+		crc = res;
+		data += SLICES;
+		len -= SLICES;
+	}
+
+	while( len-- ) {
+		crc = (crc >> 8) ^ t[0][(crc ^ static_cast<uint32_t>(*data++)) & 0xFF];
+	}
+
+	return crc;
+}
+
+/**
+ * portable version, usable at compile time
+ */
+template <std::size_t SLICES = 16>
+constexpr uint32_t crc32_slicing( const std::byte *data, std::size_t len )
+{
+	return update<SLICES>( INITIAL_REMAINDER, data, len ) ^ FINAL_XOR_VALUE;
+}
+
+#ifdef SFF_CRC32_PCLMUL
+
+namespace detail {
+
+/**
+ * Folds 64 bytes per step with carry-less multiplication.
+ * Requires len >= 64. Processes a multiple of 16 bytes,
+ * returns the number of bytes processed.
+ */
+__attribute__((target("pclmul,sse4.1")))
+inline std::size_t update_pclmul( uint32_t & crc, const std::byte *buf, std::size_t len )
+{
+	// folding constants for the reflected polynomial
+	alignas(16) static constexpr uint64_t k1k2[] = { 0x0154442bd4, 0x01c6e41596 };
+	alignas(16) static constexpr uint64_t k3k4[] = { 0x01751997d0, 0x00ccaa009e };
+	alignas(16) static constexpr uint64_t k5k0[] = { 0x0163cd6124, 0x0000000000 };
+	alignas(16) static constexpr uint64_t poly[] = { 0x01db710641, 0x01f7011641 };
+
+	const std::size_t start_len = len;
+
+	__m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+	x1 = _mm_loadu_si128( reinterpret_cast<const __m128i*>(buf + 0x00) );
+	x2 = _mm_loadu_si128( reinterpret_cast<const __m128i*>(buf + 0x10) );
+	x3 = _mm_loadu_si128( reinterpret_cast<const __m128i*>(buf + 0x20) );
+	x4 = _mm_loadu_si128( reinterpret_cast<const __m128i*>(buf + 0x30) );
+
+	x1 = _mm_xor_si128( x1, _mm_cvtsi32_si128( static_cast<int>(crc) ) );
+	x0 = _mm_load_si128( reinterpret_cast<const __m128i*>(k1k2) );
+
+	buf += 64;
+	len -= 64;
+
+	// fold 4 x 128 bits in parallel
+	while( len >= 64 ) {
+		x5 = _mm_clmulepi64_si128( x1, x0, 0x00 );
+		x6 = _mm_clmulepi64_si128( x2, x0, 0x00 );
+		x7 = _mm_clmulepi64_si128( x3, x0, 0x00 );
+		x8 = _mm_clmulepi64_si128( x4, x0, 0x00 );
+
+		x1 = _mm_clmulepi64_si128( x1, x0, 0x11 );
+		x2 = _mm_clmulepi64_si128( x2, x0, 0x11 );
+		x3 = _mm_clmulepi64_si128( x3, x0, 0x11 );
+		x4 = _mm_clmulepi64_si128( x4, x0, 0x11 );
+
+		y5 = _mm_loadu_si128( reinterpret_cast<const __m128i*>(buf + 0x00) );
+		y6 = _mm_loadu_si128( reinterpret_cast<const __m128i*>(buf + 0x10) );
+		y7 = _mm_loadu_si128( reinterpret_cast<const __m128i*>(buf + 0x20) );
+		y8 = _mm_loadu_si128( reinterpret_cast<const __m128i*>(buf + 0x30) );
+
+		x1 = _mm_xor_si128( _mm_xor_si128( x1, x5 ), y5 );
+		x2 = _mm_xor_si128( _mm_xor_si128( x2, x6 ), y6 );
+		x3 = _mm_xor_si128( _mm_xor_si128( x3, x7 ), y7 );
+		x4 = _mm_xor_si128( _mm_xor_si128( x4, x8 ), y8 );
+
+		buf += 64;
+		len -= 64;
+	}
+
+	// fold into 128 bits
+	x0 = _mm_load_si128( reinterpret_cast<const __m128i*>(k3k4) );
+
+	for( __m128i next : { x2, x3, x4 } ) {
+		x5 = _mm_clmulepi64_si128( x1, x0, 0x00 );
+		x1 = _mm_clmulepi64_si128( x1, x0, 0x11 );
+		x1 = _mm_xor_si128( _mm_xor_si128( x1, next ), x5 );
+	}
+
+	// single fold blocks of 128 bits
+	while( len >= 16 ) {
+		x2 = _mm_loadu_si128( reinterpret_cast<const __m128i*>(buf) );
+
+		x5 = _mm_clmulepi64_si128( x1, x0, 0x00 );
+		x1 = _mm_clmulepi64_si128( x1, x0, 0x11 );
+		x1 = _mm_xor_si128( _mm_xor_si128( x1, x2 ), x5 );
+
+		buf += 16;
+		len -= 16;
+	}
+
+	// fold 128 bits to 64 bits
+	x2 = _mm_clmulepi64_si128( x1, x0, 0x10 );
+	x3 = _mm_setr_epi32( ~0, 0, ~0, 0 );
+	x1 = _mm_srli_si128( x1, 8 );
+	x1 = _mm_xor_si128( x1, x2 );
+
+	x0 = _mm_loadl_epi64( reinterpret_cast<const __m128i*>(k5k0) );
+
+	x2 = _mm_srli_si128( x1, 4 );
+	x1 = _mm_and_si128( x1, x3 );
+	x1 = _mm_clmulepi64_si128( x1, x0, 0x00 );
+	x1 = _mm_xor_si128( x1, x2 );
+
+	// barrett reduce to 32 bits
+	x0 = _mm_load_si128( reinterpret_cast<const __m128i*>(poly) );
+
+	x2 = _mm_and_si128( x1, x3 );
+	x2 = _mm_clmulepi64_si128( x2, x0, 0x10 );
+	x2 = _mm_and_si128( x2, x3 );
+	x2 = _mm_clmulepi64_si128( x2, x0, 0x00 );
+	x1 = _mm_xor_si128( x1, x2 );
+
+	crc = static_cast<uint32_t>( _mm_extract_epi32( x1, 1 ) );
+
+	return start_len - len;
+}
+
+inline bool has_pclmul()
+{
+	static const bool ret = __builtin_cpu_supports( "pclmul" ) && __builtin_cpu_supports( "sse4.1" );
+	return ret;
+}
+
+} // namespace detail
+
+#endif
+
+/**
+ * Drop in replacement for crcFast()
+ */
+inline uint32_t crc32( const std::byte *data, std::size_t len )
+{
+	uint32_t crc = INITIAL_REMAINDER;
+
+#ifdef SFF_CRC32_PCLMUL
+	if( len >= 64 && detail::has_pclmul() ) {
+		const std::size_t done = detail::update_pclmul( crc, data, len );
+		data += done;
+		len -= done;
+	}
+#endif
+
+	return update<16>( crc, data, len ) ^ FINAL_XOR_VALUE;
+}
+
+static_assert( crc32_slicing<8>( std::array<std::byte,9>{
+		std::byte('1'), std::byte('2'), std::byte('3'), std::byte('4'), std::byte('5'),
+		std::byte('6'), std::byte('7'), std::byte('8'), std::byte('9') }.data(), 9 ) == 0xCBF43926 );
+
+} // namespace SimpleFlashFs::Crc32
@@ -0,0 +1,84 @@
+/**
+ * Checks SimpleFlashFsCrc32.h against crcFast() from crc.c
+ * and compares the throughput.
+ *
+ * g++ -std=c++20 -O2 crc32_bench.cc crc.c -o crc32_bench
+ *
+ * @author Copyright (c) 2026 Martin Oberzalek
+ */
+#include "SimpleFlashFsCrc32.h"
+#include "crc.h"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace SimpleFlashFs;
+
+namespace {
+
+uint32_t crc_fast( const std::byte *data, std::size_t len )
+{
+	return crcFast( reinterpret_cast<unsigned char const*>(data), static_cast<int>(len) );
+}
+
+template <class F>
+void bench( const char *name, F f, const std::vector<std::byte> & buffer, std::size_t block_size )
+{
+	const std::size_t rounds = std::max<std::size_t>( 1, (64 * 1024 * 1024) / buffer.size() );
+	uint32_t sum = 0;
+
+	auto start = std::chrono::steady_clock::now();
+
+	for( std::size_t r = 0; r < rounds; r++ ) {
+		for( std::size_t pos = 0; pos + block_size <= buffer.size(); pos += block_size ) {
+			sum += f( buffer.data() + pos, block_size );
+		}
+	}
+
+	std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+	const double mb = static_cast<double>( rounds * (buffer.size() / block_size) * block_size ) / (1024 * 1024);
+
+	std::printf( "%-20s block %5zu: %8.1f MB/s (%08x)\n", name, block_size, mb / duration.count(), sum );
+}
+
+} // namespace
+
+int main()
+{
+	crcInit();
+
+	std::mt19937 rng( 42 );
+	std::vector<std::byte> buffer( 64 * 1024 );
+
+	for( auto & b : buffer ) {
+		b = static_cast<std::byte>( rng() );
+	}
+
+	// all lengths and alignments have to produce the same result
+	for( std::size_t offset = 0; offset < 16; offset++ ) {
+		for( std::size_t len = 0; len < 1100; len++ ) {
+			const std::byte *data = buffer.data() + offset;
+			const uint32_t expected = crc_fast( data, len );
+
+			if( Crc32::crc32( data, len ) != expected ||
+				Crc32::crc32_slicing<8>( data, len ) != expected ||
+				Crc32::crc32_slicing<16>( data, len ) != expected ) {
+				std::printf( "mismatch at offset %zu len %zu\n", offset, len );
+				return 1;
+			}
+		}
+	}
+
+	std::printf( "all results match crcFast()\n" );
+
+	// 256 bytes FM25W256, 528 bytes AT45DB321E, 8192 bytes STM32H7
+	for( std::size_t block_size : { 256, 528, 8192 } ) {
+		bench( "crcFast", crc_fast, buffer, block_size );
+		bench( "slicing-by-8", Crc32::crc32_slicing<8>, buffer, block_size );
+		bench( "slicing-by-16", Crc32::crc32_slicing<16>, buffer, block_size );
+		bench( "Crc32::crc32", Crc32::crc32, buffer, block_size );
+	}
+
+	return 0;
+}
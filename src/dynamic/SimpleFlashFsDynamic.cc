@@ -10,15 +10,39 @@
 #include <string_utils.h>
 #include <map>
 #include <type_traits>
-#include "../crc/crc.h"
+#include <chrono>
+#include <algorithm>
+#include <iterator>
+#include "../crc/SimpleFlashFsCrc32.h"
 
 using namespace Tools;
 
 namespace SimpleFlashFs::dynamic {
 
+namespace {
+
+const char CHECKPOINT_MAGIC[8] = { 'S', 'F', 'F', 'C', 'H', 'K', 'P', 'T' };
+const char WEAR_TABLE_MAGIC[8] = { 'S', 'F', 'F', 'W', 'E', 'A', 'R', 'T' };
+
+// magic, version, generation, number of pages, lowest counter
+constexpr std::size_t WEAR_TABLE_HEAD_SIZE = sizeof(WEAR_TABLE_MAGIC) + sizeof(uint16_t) + sizeof(uint64_t) + 2 * sizeof(uint32_t);
+
+// magic, version, generation, body length
+constexpr std::size_t CHECKPOINT_HEAD_SIZE = sizeof(CHECKPOINT_MAGIC) + sizeof(uint16_t) + sizeof(uint64_t) + sizeof(uint32_t);
+
+// page, checksum
+constexpr std::size_t CHECKPOINT_LOG_ENTRY_SIZE = 2 * sizeof(uint32_t);
+
+std::size_t align_checkpoint_log( std::size_t pos )
+{
+	return (pos + CHECKPOINT_LOG_ENTRY_SIZE - 1) / CHECKPOINT_LOG_ENTRY_SIZE * CHECKPOINT_LOG_ENTRY_SIZE;
+}
+
+} // namespace
+
 uint32_t Config::crc32( const std::byte *bytes, size_t len )
 {
-	return crcFast( reinterpret_cast<unsigned const char*>(bytes), len );
+	return Crc32::crc32( bytes, len );
 }
 
 
@@ -26,11 +50,35 @@ uint32_t Config::crc32( const std::byte *bytes, size_t len )
 SimpleFlashFs::SimpleFlashFs( FlashMemoryInterface *mem_interface_ )
 : base::SimpleFlashFsBase<Config>(mem_interface_)
 {
-	crcInit();
 }
 
-bool SimpleFlashFs::create( const Header & h )
+SimpleFlashFs::~SimpleFlashFs()
+{
+	stop_reclamation_worker();
+}
+
+bool SimpleFlashFs::create( const Header & header_ )
 {
+	Header h = header_;
+
+	if( h.erase_block_size > 1 ) {
+		const uint32_t block_pages = h.erase_block_size;
+
+		// whole blocks only, the inode pages end at a block boundary
+		h.filesystem_size = h.filesystem_size / block_pages * block_pages;
+		h.max_inodes = ( h.max_inodes + block_pages ) / block_pages * block_pages - 1;
+
+		// the header block and two blocks of inode pages,
+		// so the cleaner can move the inodes of one block
+		h.max_inodes = std::max( h.max_inodes, 3 * block_pages - 1 );
+
+		// two blocks of data pages, one is reserved for the cleaner
+		if( h.filesystem_size < h.max_inodes + 1 + 2 * static_cast<uint64_t>(block_pages) ) {
+			CPPDEBUG( "filesystem too small for the erase block size" );
+			return false;
+		}
+	}
+
 	if( h.page_size * h.filesystem_size > mem->size() ) {
 		CPPDEBUG( "filesystem too large for memory" );
 		return false;
@@ -58,49 +106,156 @@ bool SimpleFlashFs::create( const Header & h )
 		return false;
 	}
 
+	// the snapshot belongs to the old filesystem
+	discard_checkpoint();
+
 	return init();
 }
 
 
 
+void SimpleFlashFs::set_mount_threads( unsigned threads )
+{
+	m_mount_threads = threads;
+}
+
+std::vector<SimpleFlashFs::ScannedPage> SimpleFlashFs::scan_inode_pages( uint32_t first_page, uint32_t last_page, bool do_error_corrections )
+{
+	// pages per read() call
+	static constexpr uint32_t SCAN_BLOCK_PAGES = 64;
+
+	unsigned threads = m_mount_threads;
+
+	if( threads == 0 ) {
+		threads = std::max( 1U, std::thread::hardware_concurrency() );
+	}
+
+	// at least one block per thread
+	const uint32_t pages = last_page - first_page;
+	threads = std::min<unsigned>( threads, (pages + SCAN_BLOCK_PAGES - 1) / SCAN_BLOCK_PAGES );
+	threads = std::max( 1U, threads );
+
+	// reads, verifies and decodes the pages [first,last) into result
+	auto scan = [this,do_error_corrections]( uint32_t first, uint32_t last, std::vector<ScannedPage> & result ) {
+		std::vector<std::byte> buffer;
+
+		auto decode = [this,do_error_corrections,&result]( uint32_t page, std::span<const std::byte> data ) {
+			if( get_page_checksum( data.data(), data.size() ) != calc_page_checksum( data.data(), data.size() ) ) {
+				// a page with a crc error is free
+				return;
+			}
+
+			auto inode = std::make_shared<FileHandle>( get_inode( data, do_error_corrections ) );
+			inode->page = page;
+			result.push_back( { page, false, inode } );
+		};
+
+		for( uint32_t block = first; block < last; block += SCAN_BLOCK_PAGES ) {
+			const uint32_t count = std::min( SCAN_BLOCK_PAGES, last - block );
+			const std::size_t offset = header.page_size + static_cast<std::size_t>(block) * header.page_size;
+			const std::size_t size = static_cast<std::size_t>(count) * header.page_size;
+
+			if( mem->can_map_read() ) {
+				if( const std::byte *data = mem->map_read( offset, size ); data != nullptr ) {
+					for( uint32_t i = 0; i < count; i++ ) {
+						decode( block + i, { data + i * header.page_size, header.page_size } );
+					}
+					continue;
+				}
+			} else {
+				buffer.resize( size );
+
+				if( mem->read( offset, buffer.data(), size ) == size ) {
+					for( uint32_t i = 0; i < count; i++ ) {
+						decode( block + i, { buffer.data() + i * header.page_size, header.page_size } );
+					}
+					continue;
+				}
+			}
+
+			// find the pages, that cannot be read
+			buffer.resize( header.page_size );
+
+			for( uint32_t i = block; i < block + count; i++ ) {
+				ReadPageReturn ret = read_page( i, buffer.data(), buffer.size() );
+
+				if( !ret ) {
+					result.push_back( { i, true, {} } );
+				} else {
+					decode( i, buffer );
+				}
+			}
+		}
+	};
+
+	std::vector<std::vector<ScannedPage>> results( threads );
+
+	if( threads == 1 ) {
+		scan( first_page, last_page, results[0] );
+	} else {
+		const uint32_t pages_per_thread = (pages + threads - 1) / threads;
+		std::vector<std::thread> workers;
+
+		for( unsigned t = 0; t < threads; t++ ) {
+			const uint32_t first = std::min( last_page, first_page + t * pages_per_thread );
+			const uint32_t last = std::min( last_page, first + pages_per_thread );
+
+			workers.emplace_back( scan, first, last, std::ref( results[t] ) );
+		}
+
+		for( auto & worker : workers ) {
+			worker.join();
+		}
+	}
+
+	// ordered by page number, like a single threaded scan
+	std::vector<ScannedPage> ret;
+
+	for( auto & result : results ) {
+		std::move( result.begin(), result.end(), std::back_inserter( ret ) );
+	}
+
+	return ret;
+}
+
 void SimpleFlashFs::read_all_free_data_pages()
 {
+	merge_scanned_inode_pages( scan_inode_pages( 0, header.max_inodes, false ) );
+}
+
+void SimpleFlashFs::merge_scanned_inode_pages( const std::vector<ScannedPage> & scanned_pages )
+{
+	if( is_block_mode() ) {
+		init_erase_blocks();
+	} else {
+		// the erases of the merge mark their pages as verified again
+		set_all_pages_unverified();
+	}
+
 	free_data_pages.clear();
 
 	// -1 for the header page
-	for( unsigned i = header.max_inodes; i < (header.filesystem_size - 1); i++ ) {
-		free_data_pages.unordered_insert(i);
-	}
+	free_data_pages.insert( header.max_inodes, static_cast<uint32_t>( header.filesystem_size - 1 ) );
 
 	std::map<uint64_t,std::list<std::shared_ptr<FileHandle>>> inodes;
 
-	for( unsigned i = 0; i < header.max_inodes; i++ ) {
+	for( auto & scanned : scanned_pages ) {
 
-		std::vector<std::byte> page(header.page_size);
+		// a page with a crc error is free, but a page that cannot
+		// be read at all must not be allocated
+		used_inode_pages.set( scanned.page );
 
-		if( read_page( i, page, true ) ) {
-			/*
-			CPPDEBUG( format( "inode page: %d data %x%x%x%x%x%x%x%x", i,
-					static_cast<unsigned>(page[0]),
-					static_cast<unsigned>(page[1]),
-					static_cast<unsigned>(page[2]),
-					static_cast<unsigned>(page[3]),
-					static_cast<unsigned>(page[4]),
-					static_cast<unsigned>(page[5]),
-					static_cast<unsigned>(page[6]),
-					static_cast<unsigned>(page[7]) ) );
-					*/
-			FileHandle inode = get_inode( page, false );
-			inode.page = i;
-			max_inode_number = std::max( max_inode_number, inode.inode.inode_number );
-			CPPDEBUG( Tools::format( "found inode %d,%d at page: %d (%s) attributes: %d",
-					inode.inode.inode_number, inode.inode.inode_version_number, i,
-					inode.inode.file_name, static_cast<uint64_t>(inode.inode.attributes)) );
-
-			auto dyn_inode = std::shared_ptr<FileHandle>(new FileHandle(std::move(inode)));
-			inodes[inode.inode.inode_number].push_back(dyn_inode);
-			//free_data_pages.insert(inode->inode.data_pages.begin(), inode->inode.data_pages.end());
+		if( scanned.read_error ) {
+			continue;
 		}
+
+		auto & inode = scanned.inode;
+		max_inode_number = std::max( max_inode_number, inode->inode.inode_number );
+		CPPDEBUG( Tools::format( "found inode %d,%d at page: %d (%s) attributes: %d",
+				inode->inode.inode_number, inode->inode.inode_version_number, scanned.page,
+				inode->inode.file_name, static_cast<uint64_t>(inode->inode.attributes)) );
+
+		inodes[inode->inode.inode_number].push_back(inode);
 	}
 
 	// clear all old inodes
@@ -113,7 +268,15 @@ void SimpleFlashFs::read_all_free_data_pages()
 
 			while( list.size() > 1 ) {
 				auto inode_it = list.begin();
-				erase_inode_and_unused_pages( *(*inode_it), *(*(++list.begin())) );
+
+				if( is_block_mode() ) {
+					// the pages of an old version could be used by an other file already,
+					// find_dead_pages() checks the pages, that are not used by the latest versions
+					erase_and_free_page( (*inode_it)->page );
+				} else {
+					erase_inode_and_unused_pages( *(*inode_it), *(*(++list.begin())) );
+				}
+
 				list.erase( inode_it );
 			}
 		}
@@ -125,40 +288,2290 @@ void SimpleFlashFs::read_all_free_data_pages()
 		for( auto page : list.front()->inode.data_pages ) {
 			free_data_pages.erase(page.page_id);
 		}
+
+		for( auto page : list.front()->inode.indirect_pages ) {
+			free_data_pages.erase(page);
+		}
+
+		for( auto page : list.front()->inode.double_indirect_pages ) {
+			free_data_pages.erase(page);
+		}
 	}
 
-	std::size_t mem_footprint = free_data_pages.size() * sizeof(uint32_t) + sizeof(decltype(free_data_pages));
+	if( is_block_mode() ) {
+		find_dead_pages();
+	}
+
+	// erase_inode_and_unused_pages() kept used_inode_pages up to date
+	set_used_inode_pages_valid();
+
+	// only the latest version of each inode is left
+	if constexpr( Config::USE_NAME_INDEX ) {
+		name_index.reset( inodes.size() );
+
+		for( auto & pair : inodes ) {
+			name_index_insert( *pair.second.front() );
+		}
+	}
+
+	std::size_t mem_footprint = free_data_pages.memory_usage() + sizeof(decltype(free_data_pages));
 
 	CPPDEBUG( Tools::format( "%d free Data pages mem footprint  %d kb", free_data_pages.size(), mem_footprint / 1024) );
-	//CPPDEBUG( Tools::format( "free Data pages: %s", IterableToCommaSeparatedString(free_data_pages.get_sorted_data()) ) );
 }
 
 
 
+void SimpleFlashFs::set_all_pages_unverified()
+{
+	std::lock_guard<std::mutex> lock( m_unverified_mutex );
+
+	m_unverified_pages.resize( header.filesystem_size );
+
+	for( uint32_t i = 0; i < m_unverified_pages.number_of_words(); i++ ) {
+		m_unverified_pages.set_word( i, base::Bitmap<Config>::ALL_SET );
+	}
+}
+
+void SimpleFlashFs::verify_allocated_page( uint32_t page )
+{
+	{
+		std::lock_guard<std::mutex> lock( m_unverified_mutex );
+
+		if( !m_unverified_pages.test( page ) ) {
+			return;
+		}
+
+		m_unverified_pages.reset( page );
+	}
+
+	typename Config::page_type buffer;
+
+	if( is_page_erased( page, buffer ) ) {
+		return;
+	}
+
+	CPPDEBUG( Tools::format( "erasing page %d, it is free, but not erased", page ) );
+
+	const std::size_t address = header.page_size + static_cast<std::size_t>(page) * header.page_size;
+
+	{
+		BankLock lock( *this, get_bank_mask( address, header.page_size ) );
+		mem->erase( address, header.page_size );
+	}
+
+	page_erased( page );
+}
+
+void SimpleFlashFs::page_allocated( uint32_t page )
+{
+	// a power loss can leave an allocated page half written, so it is logged like a change
+	page_changed( page );
+	verify_allocated_page( page );
+}
+
 std::list<std::shared_ptr<::SimpleFlashFs::dynamic::SimpleFlashFs::FileHandle>> SimpleFlashFs::get_all_inodes( bool do_error_corrections )
 {
 	std::list<std::shared_ptr<FileHandle>> ret;
 
-	for( unsigned i = 0; i < header.max_inodes; i++ ) {
+	for( auto & scanned : scan_inode_pages( 0, header.max_inodes, do_error_corrections ) ) {
+
+		if( scanned.read_error ) {
+			continue;
+		}
+
+		auto & inode = scanned.inode;
+
+		CPPDEBUG( Tools::format( "found inode %d,%d at page: %d (%s) attributes: %d",
+							inode->inode.inode_number, inode->inode.inode_version_number, scanned.page,
+							inode->inode.file_name, static_cast<uint64_t>(inode->inode.attributes)) );
+
+		ret.push_back(inode);
+	}
+
+	return ret;
+}
+
+void SimpleFlashFs::set_lazy_mount( bool lazy )
+{
+	m_lazy_mount = lazy;
+}
 
-		std::vector<std::byte> page(header.page_size);
+void SimpleFlashFs::start_lazy_mount()
+{
+	std::lock_guard<std::mutex> lock( m_mount_mutex );
 
-		if( read_page( i, page, true ) ) {
+	m_mount_scanned_pages.clear();
+	m_mount_next_page = 0;
+	m_mount_scans = 0;
+	m_mount_merging.reset();
+	m_mount_pending = true;
+}
 
-			auto inode = get_inode( page, do_error_corrections );
-			inode.page = i;
+bool SimpleFlashFs::scan_next_inode_pages( uint32_t pages )
+{
+	uint32_t first_page = 0;
+	uint32_t last_page = 0;
 
-			CPPDEBUG( Tools::format( "found inode %d,%d at page: %d (%s) attributes: %d",
-								inode.inode.inode_number, inode.inode.inode_version_number, i,
-								inode.inode.file_name, static_cast<uint64_t>(inode.inode.attributes)) );
+	{
+		std::lock_guard<std::mutex> lock( m_mount_mutex );
 
-			auto dyn_inode = std::shared_ptr<FileHandle>(new FileHandle(std::move(inode)));
-			ret.push_back(dyn_inode);
+		if( m_mount_next_page >= header.max_inodes ) {
+			return false;
 		}
+
+		first_page = m_mount_next_page;
+		last_page = std::min( header.max_inodes, first_page + std::min( pages, header.max_inodes ) );
+		m_mount_next_page = last_page;
+		m_mount_scans++;
 	}
 
-	return ret;
+	auto scanned_pages = scan_inode_pages( first_page, last_page, false );
+
+	{
+		std::lock_guard<std::mutex> lock( m_mount_mutex );
+
+		std::move( scanned_pages.begin(), scanned_pages.end(), std::back_inserter( m_mount_scanned_pages ) );
+		m_mount_scans--;
+	}
+
+	m_mount_cv.notify_all();
+
+	return true;
 }
 
-} // namespace SimpleFlashFs::dynamic
+void SimpleFlashFs::complete_lazy_mount()
+{
+	while( scan_next_inode_pages( header.max_inodes ) ) {
+	}
 
+	std::vector<ScannedPage> scanned_pages;
+
+	{
+		std::unique_lock<std::mutex> lock( m_mount_mutex );
+
+		// erasing old inode versions calls prepare_modification() again
+		if( m_mount_merging == std::this_thread::get_id() ) {
+			return;
+		}
+
+		m_mount_cv.wait( lock, [this]() {
+			return !m_mount_pending || ( !m_mount_merging && m_mount_scans == 0 );
+		});
+
+		if( !m_mount_pending ) {
+			// completed by an other thread
+			return;
+		}
+
+		m_mount_merging = std::this_thread::get_id();
+		scanned_pages.swap( m_mount_scanned_pages );
+	}
+
+	merge_scanned_inode_pages( scanned_pages );
+
+	{
+		std::lock_guard<std::mutex> lock( m_mount_mutex );
+
+		m_mount_merging.reset();
+		m_mount_pending = false;
+	}
+
+	m_mount_cv.notify_all();
+
+	CPPDEBUG( "lazy mount complete" );
+
+	write_checkpoint();
+}
+
+bool SimpleFlashFs::mount_step( std::size_t pages )
+{
+	if( !m_mount_pending ) {
+		return true;
+	}
+
+	if( scan_next_inode_pages( static_cast<uint32_t>( std::min<std::size_t>( pages, header.max_inodes ) ) ) ) {
+		return false;
+	}
+
+	// the last step builds the free data pages
+	complete_lazy_mount();
+	return true;
+}
+
+void SimpleFlashFs::finish_mount()
+{
+	if( !m_mount_pending ) {
+		return;
+	}
+
+	complete_lazy_mount();
+}
+
+void SimpleFlashFs::prepare_modification()
+{
+	if( m_mount_pending ) {
+		finish_mount();
+	}
+}
+
+bool SimpleFlashFs::unscanned_newer_inode_version( uint32_t first_page, uint64_t inode_number, uint64_t version_number )
+{
+	// inode number and version number
+	static constexpr std::size_t PREFIX_SIZE = 2 * sizeof(uint64_t);
+
+	// pages per read_v() call
+	static constexpr uint32_t BLOCK_PAGES = 64;
+
+	auto is_newer_version = [this,inode_number,version_number]( const std::byte *data ) {
+		uint64_t number = 0;
+		uint64_t version = 0;
+
+		std::memcpy( &number, data, sizeof(number) );
+		std::memcpy( &version, data + sizeof(number), sizeof(version) );
+		auto_endianess( number );
+		auto_endianess( version );
+
+		// the crc is not checked, the mount will do this
+		return number == inode_number && version > version_number;
+	};
+
+	auto page_address = [this]( uint32_t page ) {
+		return header.page_size + static_cast<std::size_t>(page) * header.page_size;
+	};
+
+	if( mem->can_map_read() ) {
+		for( uint32_t page = first_page; page < header.max_inodes; page++ ) {
+			if( const std::byte *data = mem->map_read( page_address( page ), PREFIX_SIZE ); data != nullptr && is_newer_version( data ) ) {
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	std::vector<std::byte> buffer( BLOCK_PAGES * PREFIX_SIZE );
+	std::vector<FlashMemoryInterface::ReadVec> vec( BLOCK_PAGES );
+
+	for( uint32_t block = first_page; block < header.max_inodes; block += BLOCK_PAGES ) {
+		const uint32_t count = std::min( BLOCK_PAGES, header.max_inodes - block );
+
+		for( uint32_t i = 0; i < count; i++ ) {
+			vec[i] = { page_address( block + i ), buffer.data() + i * PREFIX_SIZE, PREFIX_SIZE };
+		}
+
+		if( mem->read_v( std::span<const FlashMemoryInterface::ReadVec>( vec.data(), count ) ) != count * PREFIX_SIZE ) {
+			// a page, that cannot be read, cannot contain an inode
+			for( uint32_t i = 0; i < count; i++ ) {
+				if( mem->read( vec[i].address, vec[i].data, PREFIX_SIZE ) != PREFIX_SIZE ) {
+					std::memset( vec[i].data, 0xFF, PREFIX_SIZE );
+				}
+			}
+		}
+
+		for( uint32_t i = 0; i < count; i++ ) {
+			if( is_newer_version( buffer.data() + i * PREFIX_SIZE ) ) {
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+std::optional<SimpleFlashFs::FileHandle> SimpleFlashFs::find_file_lazy( const Config::string_view_type & name )
+{
+	// pages per scan step
+	static constexpr uint32_t LOOKUP_STEP_PAGES = 64;
+
+	if( !m_mount_pending ) {
+		return {};
+	}
+
+	// latest version of each inode scanned so far, index into m_mount_scanned_pages
+	std::map<uint64_t,std::size_t> latest;
+	std::optional<std::size_t> found;
+	uint64_t inode_number = 0;
+	uint64_t version_number = 0;
+	uint32_t found_page = 0;
+	uint32_t scanned_end = 0;
+
+	for( std::size_t idx = 0; !found; ) {
+		{
+			std::unique_lock<std::mutex> lock( m_mount_mutex );
+
+			if( m_mount_merging == std::this_thread::get_id() ) {
+				// the merge is looking up a file, all inodes are read then
+				return {};
+			}
+
+			// the pages of a running scan could contain a newer version
+			m_mount_cv.wait( lock, [this]() {
+				return !m_mount_pending || ( !m_mount_merging && m_mount_scans == 0 );
+			});
+
+			if( !m_mount_pending ) {
+				// completed by an other thread
+				lock.unlock();
+				return find_file_indexed( name );
+			}
+
+			const std::size_t first_new = idx;
+
+			for( ; idx < m_mount_scanned_pages.size(); idx++ ) {
+				const auto & scanned = m_mount_scanned_pages[idx];
+
+				if( scanned.read_error ) {
+					continue;
+				}
+
+				const auto & inode = scanned.inode->inode;
+				auto it = latest.find( inode.inode_number );
+
+				if( it == latest.end() ) {
+					latest[inode.inode_number] = idx;
+				} else if( m_mount_scanned_pages[it->second].inode->inode.inode_version_number < inode.inode_version_number ) {
+					it->second = idx;
+				}
+			}
+
+			for( std::size_t i = first_new; i < idx && !found; i++ ) {
+				const auto & scanned = m_mount_scanned_pages[i];
+
+				if( !scanned.read_error &&
+					scanned.inode->inode.file_name == name &&
+					latest[scanned.inode->inode.inode_number] == i ) {
+					found = i;
+					inode_number = scanned.inode->inode.inode_number;
+					version_number = scanned.inode->inode.inode_version_number;
+					found_page = scanned.page;
+				}
+			}
+
+			scanned_end = m_mount_next_page;
+		}
+
+		if( found ) {
+			break;
+		}
+
+		if( !scan_next_inode_pages( LOOKUP_STEP_PAGES ) ) {
+			// the file does not exist. All pages are read anyway.
+			complete_lazy_mount();
+			return find_file_indexed( name );
+		}
+	}
+
+	// after a power loss both versions of an inode can be on the flash
+	if( unscanned_newer_inode_version( scanned_end, inode_number, version_number ) ) {
+		CPPDEBUG( "newer inode version found, completing the mount" );
+		complete_lazy_mount();
+		return find_file_indexed( name );
+	}
+
+	// completed by an other thread, the file could have been changed since
+	if( !m_mount_pending ) {
+		return find_file_indexed( name );
+	}
+
+	// read it again, with error corrections
+	typename Config::page_type buffer;
+	auto page = read_inode_page( found_page, buffer );
+
+	if( page.empty() ) {
+		complete_lazy_mount();
+		return find_file_indexed( name );
+	}
+
+	auto file_handle = get_inode( page );
+	file_handle.page = found_page;
+
+	return std::optional<FileHandle>( std::move(file_handle) );
+}
+
+bool SimpleFlashFs::start_reclamation_worker( const ReclamationConfig & config )
+{
+	std::lock_guard<std::mutex> lock( m_reclamation_mutex );
+
+	if( m_reclamation_running ) {
+		return false;
+	}
+
+	m_reclamation_config = config;
+	m_reclamation_stop = false;
+	m_reclamation_running = true;
+	m_reclamation_thread = std::thread( [this]() { reclamation_worker(); } );
+
+	return true;
+}
+
+void SimpleFlashFs::stop_reclamation_worker()
+{
+	{
+		std::lock_guard<std::mutex> lock( m_reclamation_mutex );
+
+		if( !m_reclamation_running ) {
+			return;
+		}
+
+		m_reclamation_stop = true;
+	}
+
+	m_reclamation_cv.notify_all();
+	m_reclamation_thread.join();
+
+	std::deque<uint32_t> pages;
+
+	{
+		std::lock_guard<std::mutex> lock( m_reclamation_mutex );
+		pages.swap( m_reclamation_queue );
+		m_reclamation_running = false;
+	}
+
+	for( auto page : pages ) {
+		erase_and_free_page( page );
+	}
+}
+
+std::size_t SimpleFlashFs::get_number_of_pending_erase_pages() const
+{
+	std::lock_guard<std::mutex> lock( m_reclamation_mutex );
+	return m_reclamation_queue.size();
+}
+
+void SimpleFlashFs::erase_pages( base::PageSet<Config> & pages_to_erase )
+{
+	erase_pages_now_or_queued( pages_to_erase );
+
+	bool rewrite = false;
+
+	{
+		std::lock_guard<std::mutex> lock( m_checkpoint_mutex );
+		rewrite = std::exchange( m_checkpoint_rewrite, false );
+	}
+
+	// page_changed() cannot write the snapshot itself
+	if( rewrite ) {
+		write_checkpoint();
+	}
+
+	if( m_wear_config.enabled && m_wear_config.write_interval > 0 ) {
+		bool write = false;
+
+		{
+			std::lock_guard<std::mutex> lock( m_wear_mutex );
+			write = m_wear_table.get_erases_since_write() >= m_wear_config.write_interval;
+		}
+
+		if( write ) {
+			write_wear_table();
+		}
+	}
+}
+
+void SimpleFlashFs::erase_pages_now_or_queued( base::PageSet<Config> & pages_to_erase )
+{
+	bool queued = false;
+
+	{
+		std::lock_guard<std::mutex> lock( m_reclamation_mutex );
+
+		if( m_reclamation_running && !m_reclamation_stop ) {
+			for( auto page : pages_to_erase.get_data() ) {
+				if( page >= header.max_inodes ) {
+					m_reclamation_queue.push_back( page );
+				}
+			}
+
+			queued = true;
+		}
+	}
+
+	if( queued ) {
+		m_reclamation_cv.notify_one();
+	}
+
+	for( auto page : pages_to_erase.get_data() ) {
+		// there are only a few inode pages and there is no
+		// fallback for allocating them, so they are erased now
+		if( !queued || page < header.max_inodes ) {
+			erase_and_free_page( page );
+		}
+	}
+}
+
+bool SimpleFlashFs::reclaim_pages_now( std::size_t count )
+{
+	std::deque<uint32_t> pages;
+
+	{
+		std::lock_guard<std::mutex> lock( m_reclamation_mutex );
+
+		while( pages.size() < count && !m_reclamation_queue.empty() ) {
+			pages.push_back( m_reclamation_queue.front() );
+			m_reclamation_queue.pop_front();
+		}
+	}
+
+	for( auto page : pages ) {
+		erase_and_free_page( page );
+	}
+
+	return !pages.empty();
+}
+
+void SimpleFlashFs::reclamation_worker()
+{
+	std::unique_lock<std::mutex> lock( m_reclamation_mutex );
+
+	while( !m_reclamation_stop ) {
+
+		if( m_reclamation_queue.empty() ) {
+			m_reclamation_cv.wait( lock );
+			continue;
+		}
+
+		const uint32_t page = m_reclamation_queue.front();
+		m_reclamation_queue.pop_front();
+
+		lock.unlock();
+		erase_and_free_page( page );
+		lock.lock();
+
+		if( m_reclamation_config.max_erases_per_second ) {
+			const auto pause = std::chrono::microseconds( 1000000 / m_reclamation_config.max_erases_per_second );
+			m_reclamation_cv.wait_for( lock, pause, [this]() { return m_reclamation_stop; } );
+		}
+	}
+}
+
+void SimpleFlashFs::set_checkpoint( const CheckpointConfig & config )
+{
+	std::lock_guard<std::mutex> lock( m_checkpoint_mutex );
+	m_checkpoint_config = config;
+	m_checkpoint_active = false;
+}
+
+FlashMemoryInterface *SimpleFlashFs::get_checkpoint_mem() const
+{
+	const auto & config = m_checkpoint_config;
+
+	if( config.size == 0 ) {
+		return nullptr;
+	}
+
+	FlashMemoryInterface *cmem = config.mem ? config.mem : mem;
+
+	if( config.address + config.size > cmem->size() ) {
+		CPPDEBUG( "checkpoint region behind the end of the memory" );
+		return nullptr;
+	}
+
+	if( cmem == mem && config.address < header.page_size * header.filesystem_size ) {
+		CPPDEBUG( "checkpoint region overlaps the filesystem" );
+		return nullptr;
+	}
+
+	return cmem;
+}
+
+std::size_t SimpleFlashFs::get_checkpoint_slot_size() const
+{
+	return m_checkpoint_config.size / 2;
+}
+
+std::size_t SimpleFlashFs::get_checkpoint_slot_address( unsigned slot ) const
+{
+	return m_checkpoint_config.address + slot * get_checkpoint_slot_size();
+}
+
+std::size_t SimpleFlashFs::checkpoint_read( std::size_t address, std::byte *data, std::size_t size )
+{
+	return region_read( get_checkpoint_mem(), address, data, size );
+}
+
+std::size_t SimpleFlashFs::checkpoint_write( std::size_t address, const std::byte *data, std::size_t size )
+{
+	return region_write( get_checkpoint_mem(), address, data, size );
+}
+
+void SimpleFlashFs::checkpoint_erase( std::size_t address, std::size_t size )
+{
+	region_erase( get_checkpoint_mem(), address, size );
+}
+
+std::size_t SimpleFlashFs::region_read( FlashMemoryInterface *region_mem, std::size_t address, std::byte *data, std::size_t size )
+{
+	if( region_mem == mem ) {
+		BankLock lock( *this, get_bank_mask( address, size ) );
+		return region_mem->read( address, data, size );
+	}
+
+	return region_mem->read( address, data, size );
+}
+
+std::size_t SimpleFlashFs::region_write( FlashMemoryInterface *region_mem, std::size_t address, const std::byte *data, std::size_t size )
+{
+	if( region_mem == mem ) {
+		BankLock lock( *this, get_bank_mask( address, size ) );
+		return region_mem->write( address, data, size );
+	}
+
+	return region_mem->write( address, data, size );
+}
+
+void SimpleFlashFs::region_erase( FlashMemoryInterface *region_mem, std::size_t address, std::size_t size )
+{
+	if( region_mem == mem ) {
+		BankLock lock( *this, get_bank_mask( address, size ) );
+		region_mem->erase( address, size );
+		return;
+	}
+
+	region_mem->erase( address, size );
+}
+
+uint32_t SimpleFlashFs::checkpoint_log_checksum( uint64_t generation, uint32_t page ) const
+{
+	// an entry of an older generation is not valid
+	std::array<std::byte,sizeof(uint64_t) + sizeof(uint32_t)> data;
+
+	auto_endianess( generation );
+	auto_endianess( page );
+
+	std::memcpy( data.data(), &generation, sizeof(generation) );
+	std::memcpy( data.data() + sizeof(generation), &page, sizeof(page) );
+
+	return Config::crc32( data.data(), data.size() );
+}
+
+void SimpleFlashFs::invalidate_checkpoint_slot( unsigned slot )
+{
+	// possible without erasing, bits are only cleared
+	const std::array<std::byte,sizeof(CHECKPOINT_MAGIC)> zeros{};
+	checkpoint_write( get_checkpoint_slot_address( slot ), zeros.data(), zeros.size() );
+}
+
+void SimpleFlashFs::discard_checkpoint()
+{
+	std::lock_guard<std::mutex> lock( m_checkpoint_mutex );
+
+	m_checkpoint_active = false;
+	m_checkpoint_rewrite = false;
+
+	if( !get_checkpoint_mem() ) {
+		return;
+	}
+
+	invalidate_checkpoint_slot( 0 );
+	invalidate_checkpoint_slot( 1 );
+}
+
+std::optional<std::vector<std::byte>> SimpleFlashFs::read_checkpoint_snapshot( unsigned slot, uint64_t & generation )
+{
+	const std::size_t address = get_checkpoint_slot_address( slot );
+	std::vector<std::byte> data( CHECKPOINT_HEAD_SIZE );
+
+	if( checkpoint_read( address, data.data(), data.size() ) != data.size() ) {
+		return {};
+	}
+
+	if( std::memcmp( data.data(), CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC) ) != 0 ) {
+		return {};
+	}
+
+	std::size_t pos = sizeof(CHECKPOINT_MAGIC);
+
+	auto get = [this,&pos,&data]( auto & t ) {
+		std::memcpy( &t, &data[pos], sizeof(t) );
+		auto_endianess( t );
+		pos += sizeof(t);
+	};
+
+	uint16_t version = 0;
+	uint32_t body_len = 0;
+
+	get( version );
+	get( generation );
+	get( body_len );
+
+	if( version != CHECKPOINT_VERSION ) {
+		CPPDEBUG( "unknown checkpoint version" );
+		return {};
+	}
+
+	if( CHECKPOINT_HEAD_SIZE + body_len + sizeof(uint32_t) > get_checkpoint_slot_size() ) {
+		return {};
+	}
+
+	data.resize( CHECKPOINT_HEAD_SIZE + body_len + sizeof(uint32_t) );
+
+	if( checkpoint_read( address + CHECKPOINT_HEAD_SIZE, data.data() + CHECKPOINT_HEAD_SIZE, data.size() - CHECKPOINT_HEAD_SIZE ) !=
+		data.size() - CHECKPOINT_HEAD_SIZE ) {
+		return {};
+	}
+
+	uint32_t chksum = 0;
+	pos = data.size() - sizeof(uint32_t);
+	get( chksum );
+
+	if( chksum != Config::crc32( data.data(), data.size() - sizeof(uint32_t) ) ) {
+		CPPDEBUG( "checkpoint crc error" );
+		return {};
+	}
+
+	// without the checksum
+	data.resize( data.size() - sizeof(uint32_t) );
+
+	return data;
+}
+
+bool SimpleFlashFs::load_checkpoint()
+{
+	{
+		std::lock_guard<std::mutex> lock( m_checkpoint_mutex );
+		m_checkpoint_active = false;
+		m_checkpoint_rewrite = false;
+	}
+
+	{
+		// the replay of the log erases the pages, a power loss left dirty
+		std::lock_guard<std::mutex> lock( m_unverified_mutex );
+		m_unverified_pages.clear();
+	}
+
+	if( !get_checkpoint_mem() ) {
+		return false;
+	}
+
+	// the slot with the latest snapshot
+	std::optional<std::vector<std::byte>> snapshot;
+	unsigned slot = 0;
+	uint64_t generation = 0;
+
+	for( unsigned s = 0; s < 2; s++ ) {
+		uint64_t g = 0;
+		auto data = read_checkpoint_snapshot( s, g );
+
+		if( data && (!snapshot || g > generation) ) {
+			snapshot = std::move( data );
+			slot = s;
+			generation = g;
+		}
+	}
+
+	if( !snapshot ) {
+		return false;
+	}
+
+	// a new snapshot has to get a higher generation, even if this one is unusable
+	m_checkpoint_slot = slot;
+	m_checkpoint_generation = generation;
+
+	const auto & data = *snapshot;
+	std::size_t pos = CHECKPOINT_HEAD_SIZE;
+
+	auto get = [this,&pos,&data]( auto & t ) {
+		if( pos + sizeof(t) > data.size() ) {
+			return false;
+		}
+
+		std::memcpy( &t, &data[pos], sizeof(t) );
+		auto_endianess( t );
+		pos += sizeof(t);
+		return true;
+	};
+
+	Header h{};
+	uint64_t max_inode_number_ = 0;
+	uint32_t used_words = 0;
+
+	if( !get( h.version ) ||
+		!get( h.page_size ) ||
+		!get( h.filesystem_size ) ||
+		!get( h.max_inodes ) ||
+		!get( max_inode_number_ ) ||
+		!get( used_words ) ) {
+		return false;
+	}
+
+	if( h.version != header.version ||
+		h.page_size != header.page_size ||
+		h.filesystem_size != header.filesystem_size ||
+		h.max_inodes != header.max_inodes ||
+		used_words != used_inode_pages.number_of_words() ) {
+		CPPDEBUG( "checkpoint does not match the filesystem" );
+		return false;
+	}
+
+	for( uint32_t i = 0; i < used_words; i++ ) {
+		uint32_t w = 0;
+
+		if( !get( w ) ) {
+			return false;
+		}
+
+		used_inode_pages.set_word( i, w );
+	}
+
+	uint32_t free_words = 0;
+
+	if( !get( free_words ) || free_words != free_data_pages.number_of_words() ) {
+		return false;
+	}
+
+	free_data_pages.clear();
+
+	for( uint32_t i = 0; i < free_words; i++ ) {
+		uint32_t w = 0;
+
+		if( !get( w ) ) {
+			return false;
+		}
+
+		free_data_pages.insert_word( i, w );
+	}
+
+	uint32_t number_of_inodes = 0;
+
+	if( !get( number_of_inodes ) ) {
+		return false;
+	}
+
+	std::vector<base::NameIndex<Config>::Entry> inodes( number_of_inodes );
+
+	for( auto & e : inodes ) {
+		if( !get( e.inode_number ) || !get( e.name_hash ) || !get( e.page ) ) {
+			return false;
+		}
+	}
+
+	max_inode_number = max_inode_number_;
+
+	// the log behind the snapshot
+	const std::size_t log_start = align_checkpoint_log( data.size() + sizeof(uint32_t) );
+	const std::size_t slot_size = get_checkpoint_slot_size();
+	std::vector<std::byte> log( slot_size > log_start ? slot_size - log_start : 0 );
+
+	if( checkpoint_read( get_checkpoint_slot_address( slot ) + log_start, log.data(), log.size() ) != log.size() ) {
+		return false;
+	}
+
+	std::vector<uint32_t> pages;
+
+	for( std::size_t i = 0; i + CHECKPOINT_LOG_ENTRY_SIZE <= log.size(); i += CHECKPOINT_LOG_ENTRY_SIZE ) {
+		uint32_t page = 0;
+		uint32_t chksum = 0;
+
+		std::memcpy( &page, &log[i], sizeof(page) );
+		std::memcpy( &chksum, &log[i + sizeof(page)], sizeof(chksum) );
+		auto_endianess( page );
+		auto_endianess( chksum );
+
+		// end of the log, or an interrupted write
+		if( chksum != checkpoint_log_checksum( generation, page ) ) {
+			break;
+		}
+
+		pages.push_back( page );
+	}
+
+	CPPDEBUG( Tools::format( "checkpoint generation %d: %d inodes, %d log entries",
+			generation, inodes.size(), pages.size() ) );
+
+	// an interrupted write cannot be overwritten by the next entry
+	const std::size_t log_end = pages.size() * CHECKPOINT_LOG_ENTRY_SIZE;
+	const bool log_torn = log_end + CHECKPOINT_LOG_ENTRY_SIZE <= log.size() &&
+		!std::all_of( log.begin() + log_end, log.begin() + log_end + CHECKPOINT_LOG_ENTRY_SIZE,
+					  []( std::byte b ) { return b == std::byte(0xFF); } );
+
+	const bool repaired = replay_checkpoint_log( inodes, pages );
+
+	{
+		std::lock_guard<std::mutex> lock( m_checkpoint_mutex );
+		m_checkpoint_log_start = log_start;
+		m_checkpoint_log_pos = log_start + log_end;
+		m_checkpoint_active = true;
+	}
+
+	// start with a short log again
+	if( repaired || log_torn || log_end * 2 > log.size() ) {
+		if( !write_checkpoint() && log_torn ) {
+			std::lock_guard<std::mutex> lock( m_checkpoint_mutex );
+			invalidate_checkpoint_slot( m_checkpoint_slot );
+			m_checkpoint_active = false;
+			m_checkpoint_rewrite = true;
+		}
+	}
+
+	return true;
+}
+
+bool SimpleFlashFs::replay_checkpoint_log( std::vector<base::NameIndex<Config>::Entry> & inodes, const std::vector<uint32_t> & pages )
+{
+	std::vector<uint32_t> inode_pages;
+	std::vector<uint32_t> data_pages;
+
+	for( auto page : pages ) {
+		if( page < header.max_inodes ) {
+			inode_pages.push_back( page );
+		} else {
+			// the log is in allocation order, so a page that is in use
+			// again is also used by an inode page of the log
+			free_data_pages.insert( page );
+			data_pages.push_back( page );
+		}
+	}
+
+	std::sort( inode_pages.begin(), inode_pages.end() );
+	inode_pages.erase( std::unique( inode_pages.begin(), inode_pages.end() ), inode_pages.end() );
+
+	std::sort( data_pages.begin(), data_pages.end() );
+	data_pages.erase( std::unique( data_pages.begin(), data_pages.end() ), data_pages.end() );
+
+	// these inode pages have changed, they are read again
+	std::erase_if( inodes, [&inode_pages]( const auto & e ) {
+		return std::binary_search( inode_pages.begin(), inode_pages.end(), e.page );
+	});
+
+	std::vector<std::byte> page(header.page_size);
+	std::vector<uint32_t> dirty_inode_pages;
+
+	for( auto i : inode_pages ) {
+		ReadPageReturn ret = read_page( i, page, true );
+
+		if( !ret ) {
+			if( *ret.error == ReadError::ReadError ) {
+				used_inode_pages.set(i);
+			} else {
+				// allocated, but the write was interrupted
+				used_inode_pages.reset(i);
+				dirty_inode_pages.push_back(i);
+			}
+			continue;
+		}
+
+		used_inode_pages.set(i);
+
+		FileHandle inode = get_inode( page, false );
+		max_inode_number = std::max( max_inode_number, inode.inode.inode_number );
+
+		for( auto data_page : inode.inode.data_pages ) {
+			free_data_pages.erase( data_page.page_id );
+		}
+
+		for( auto table_page : inode.inode.indirect_pages ) {
+			free_data_pages.erase( table_page );
+		}
+
+		for( auto table_page : inode.inode.double_indirect_pages ) {
+			free_data_pages.erase( table_page );
+		}
+
+		inodes.push_back( { inode.inode.inode_number, base::NameIndex<Config>::hash( inode.inode.file_name ), i } );
+	}
+
+	// a power loss between writing the new inode version
+	// and erasing the old one, see read_all_free_data_pages()
+	bool repaired = false;
+
+	std::sort( inodes.begin(), inodes.end(), []( const auto & a, const auto & b ) {
+		return a.inode_number < b.inode_number;
+	});
+
+	for( auto it = inodes.begin(); it != inodes.end(); ) {
+		auto end = std::find_if( it, inodes.end(), [it]( const auto & e ) {
+			return e.inode_number != it->inode_number;
+		});
+
+		if( end - it > 1 ) {
+			std::list<std::shared_ptr<FileHandle>> list;
+
+			for( auto e = it; e != end; e++ ) {
+				if( read_page( e->page, page, true ) ) {
+					auto inode = std::make_shared<FileHandle>( get_inode( page, false ) );
+					inode->page = e->page;
+					list.push_back( inode );
+				}
+			}
+
+			list.sort([]( auto a, auto b ) {
+				return a->inode.inode_version_number < b->inode.inode_version_number;
+			});
+
+			while( list.size() > 1 ) {
+				auto inode_it = list.begin();
+				erase_inode_and_unused_pages( *(*inode_it), *(*(++list.begin())) );
+				list.erase( inode_it );
+			}
+
+			const uint32_t latest = list.empty() ? it->page : list.front()->page;
+			const auto e = *std::find_if( it, end, [latest]( const auto & e ) { return e.page == latest; } );
+
+			it = inodes.erase( it, end );
+			it = inodes.insert( it, e ) + 1;
+			repaired = true;
+		} else {
+			it = end;
+		}
+	}
+
+	// a page with a crc error is only free, if it is erased
+	typename Config::page_type buffer;
+
+	for( auto i : dirty_inode_pages ) {
+		if( !is_page_erased( i, buffer ) ) {
+			erase_inode_page( i );
+			repaired = true;
+		}
+	}
+
+	// written data pages of a file, that was never flushed
+	for( auto i : data_pages ) {
+		if( free_data_pages.count( i ) > 0 && !is_page_erased( i, buffer ) ) {
+			erase_and_free_page( i );
+			repaired = true;
+		}
+	}
+
+	set_used_inode_pages_valid();
+
+	if constexpr( Config::USE_NAME_INDEX ) {
+		name_index.reset( inodes.size() );
+
+		for( const auto & e : inodes ) {
+			name_index.insert( e.name_hash, e.inode_number, e.page );
+		}
+	}
+
+	return repaired;
+}
+
+bool SimpleFlashFs::write_checkpoint()
+{
+	if( !get_checkpoint_mem() ) {
+		return false;
+	}
+
+	// the snapshot and the log have to match, so no page may change, until the
+	// snapshot is taken. The flash is written without holding the page locks,
+	// page_changed() waits for m_checkpoint_mutex and logs into the new slot.
+	std::unique_lock<Config::mutex_type> inode_lock( m_inode_meta_mutex );
+	std::unique_lock<Config::mutex_type> free_lock( m_free_data_pages_mutex );
+	std::shared_lock<Config::mutex_type> name_lock( m_name_index_mutex );
+	std::lock_guard<std::mutex> lock( m_checkpoint_mutex );
+
+	std::vector<std::byte> data;
+
+	if( !build_checkpoint( data ) ) {
+		return false;
+	}
+
+	// these pages are free in the snapshot, but could be written any time
+	std::vector<uint32_t> pending_pages;
+
+	for( uint32_t page = 0; page < header.max_inodes; page++ ) {
+		if( allocated_unwritten_pages.test( page ) ) {
+			pending_pages.push_back( page );
+		}
+	}
+
+	name_lock.unlock();
+	free_lock.unlock();
+	inode_lock.unlock();
+
+	return write_checkpoint_locked( data, pending_pages );
+}
+
+bool SimpleFlashFs::build_checkpoint( std::vector<std::byte> & data )
+{
+	if( !name_index.valid() ) {
+		CPPDEBUG( "no name index, cannot write checkpoint" );
+		return false;
+	}
+
+	const uint64_t generation = m_checkpoint_generation + 1;
+
+	auto add = [this,&data]( auto t ) {
+		auto_endianess( t );
+		const std::size_t pos = data.size();
+		data.resize( pos + sizeof(t) );
+		std::memcpy( &data[pos], &t, sizeof(t) );
+	};
+
+	data.insert( data.end(), reinterpret_cast<const std::byte*>(CHECKPOINT_MAGIC),
+				 reinterpret_cast<const std::byte*>(CHECKPOINT_MAGIC) + sizeof(CHECKPOINT_MAGIC) );
+	add( CHECKPOINT_VERSION );
+	add( generation );
+	add( uint32_t(0) ); // body length
+
+	add( header.version );
+	add( header.page_size );
+	add( header.filesystem_size );
+	add( header.max_inodes );
+	add( max_inode_number );
+
+	add( used_inode_pages.number_of_words() );
+	for( uint32_t i = 0; i < used_inode_pages.number_of_words(); i++ ) {
+		add( used_inode_pages.word( i ) );
+	}
+
+	add( free_data_pages.number_of_words() );
+	for( uint32_t i = 0; i < free_data_pages.number_of_words(); i++ ) {
+		add( free_data_pages.word( i ) );
+	}
+
+	add( static_cast<uint32_t>( name_index.size() ) );
+	name_index.for_each( [&add]( const auto & e ) {
+		add( e.inode_number );
+		add( e.name_hash );
+		add( e.page );
+	});
+
+	uint32_t body_len = data.size() - CHECKPOINT_HEAD_SIZE;
+	auto_endianess( body_len );
+	std::memcpy( &data[CHECKPOINT_HEAD_SIZE - sizeof(body_len)], &body_len, sizeof(body_len) );
+
+	add( Config::crc32( data.data(), data.size() ) );
+
+	return true;
+}
+
+bool SimpleFlashFs::write_checkpoint_locked( const std::vector<std::byte> & data, const std::vector<uint32_t> & pending_pages )
+{
+	const uint64_t generation = m_checkpoint_generation + 1;
+	const unsigned slot = 1 - m_checkpoint_slot;
+
+	const std::size_t log_start = align_checkpoint_log( data.size() );
+	const std::size_t log_pos = log_start + pending_pages.size() * CHECKPOINT_LOG_ENTRY_SIZE;
+
+	if( log_pos + CHECKPOINT_LOG_ENTRY_SIZE > get_checkpoint_slot_size() ) {
+		CPPDEBUG( "checkpoint region too small" );
+		return false;
+	}
+
+	const std::size_t address = get_checkpoint_slot_address( slot );
+
+	checkpoint_erase( address, get_checkpoint_slot_size() );
+
+	// the log is written first, the slot is not valid without the snapshot
+	for( std::size_t i = 0; i < pending_pages.size(); i++ ) {
+		if( !write_checkpoint_log_entry( slot, generation, log_start + i * CHECKPOINT_LOG_ENTRY_SIZE, pending_pages[i] ) ) {
+			CPPDEBUG( "cannot write checkpoint log" );
+			return false;
+		}
+	}
+
+	if( checkpoint_write( address, data.data(), data.size() ) != data.size() ) {
+		CPPDEBUG( "cannot write checkpoint" );
+		return false;
+	}
+
+	// the new snapshot is complete, the old one must not be used anymore
+	invalidate_checkpoint_slot( m_checkpoint_slot );
+
+	m_checkpoint_slot = slot;
+	m_checkpoint_generation = generation;
+	m_checkpoint_log_start = log_start;
+	m_checkpoint_log_pos = log_pos;
+	m_checkpoint_active = true;
+	m_checkpoint_rewrite = false;
+
+	return true;
+}
+
+bool SimpleFlashFs::write_checkpoint_log_entry( unsigned slot, uint64_t generation, std::size_t pos, uint32_t page )
+{
+	std::array<std::byte,CHECKPOINT_LOG_ENTRY_SIZE> entry;
+	uint32_t chksum = checkpoint_log_checksum( generation, page );
+
+	auto_endianess( page );
+	auto_endianess( chksum );
+	std::memcpy( entry.data(), &page, sizeof(page) );
+	std::memcpy( entry.data() + sizeof(page), &chksum, sizeof(chksum) );
+
+	return checkpoint_write( get_checkpoint_slot_address( slot ) + pos, entry.data(), entry.size() ) == entry.size();
+}
+
+void SimpleFlashFs::page_changed( uint32_t page )
+{
+	std::lock_guard<std::mutex> lock( m_checkpoint_mutex );
+
+	if( !m_checkpoint_active ) {
+		return;
+	}
+
+	const std::size_t slot_size = get_checkpoint_slot_size();
+
+	if( m_checkpoint_log_pos + CHECKPOINT_LOG_ENTRY_SIZE <= slot_size ) {
+		if( write_checkpoint_log_entry( m_checkpoint_slot, m_checkpoint_generation, m_checkpoint_log_pos, page ) ) {
+			m_checkpoint_log_pos += CHECKPOINT_LOG_ENTRY_SIZE;
+
+			// the last quarter of the log is a reserve for the time until the next erase_pages() call
+			if( (slot_size - m_checkpoint_log_pos) * 4 < slot_size - m_checkpoint_log_start ) {
+				m_checkpoint_rewrite = true;
+			}
+			return;
+		}
+	}
+
+	// this change would get lost, the next init() has to scan all inodes
+	CPPDEBUG( "checkpoint log full" );
+	invalidate_checkpoint_slot( m_checkpoint_slot );
+	m_checkpoint_active = false;
+	m_checkpoint_rewrite = true;
+}
+
+void SimpleFlashFs::set_wear_leveling( const WearLevelingConfig & config )
+{
+	std::lock_guard<std::mutex> lock( m_wear_mutex );
+	m_wear_config = config;
+}
+
+uint32_t SimpleFlashFs::get_erase_count( uint32_t page ) const
+{
+	std::lock_guard<std::mutex> lock( m_wear_mutex );
+	return m_wear_table.count( page );
+}
+
+FlashMemoryInterface *SimpleFlashFs::get_wear_table_mem() const
+{
+	const auto & config = m_wear_config;
+
+	if( config.size == 0 ) {
+		return nullptr;
+	}
+
+	FlashMemoryInterface *wmem = config.mem ? config.mem : mem;
+
+	if( config.address + config.size > wmem->size() ) {
+		CPPDEBUG( "wear table region behind the end of the memory" );
+		return nullptr;
+	}
+
+	if( wmem == mem && config.address < header.page_size * header.filesystem_size ) {
+		CPPDEBUG( "wear table region overlaps the filesystem" );
+		return nullptr;
+	}
+
+	return wmem;
+}
+
+std::size_t SimpleFlashFs::get_wear_table_slot_address( unsigned slot ) const
+{
+	return m_wear_config.address + slot * (m_wear_config.size / 2);
+}
+
+void SimpleFlashFs::load_wear_table()
+{
+	std::lock_guard<std::mutex> lock( m_wear_mutex );
+
+	// -1 for the header page
+	m_wear_table.resize( static_cast<uint32_t>( header.filesystem_size - 1 ), header.max_inodes );
+	m_wear_slot = 0;
+	m_wear_generation = 0;
+
+	FlashMemoryInterface *wmem = get_wear_table_mem();
+
+	if( !wmem ) {
+		return;
+	}
+
+	const std::size_t table_size = WEAR_TABLE_HEAD_SIZE + m_wear_table.size() * sizeof(uint16_t) + sizeof(uint32_t);
+	std::optional<std::vector<std::byte>> newest;
+
+	for( unsigned slot = 0; slot < 2; slot++ ) {
+		std::vector<std::byte> data( table_size );
+
+		if( table_size > m_wear_config.size / 2 ||
+			region_read( wmem, get_wear_table_slot_address( slot ), data.data(), data.size() ) != data.size() ||
+			std::memcmp( data.data(), WEAR_TABLE_MAGIC, sizeof(WEAR_TABLE_MAGIC) ) != 0 ) {
+			continue;
+		}
+
+		std::size_t pos = sizeof(WEAR_TABLE_MAGIC);
+
+		auto get = [this,&pos,&data]( auto & t ) {
+			std::memcpy( &t, &data[pos], sizeof(t) );
+			auto_endianess( t );
+			pos += sizeof(t);
+		};
+
+		uint16_t version = 0;
+		uint64_t generation = 0;
+		uint32_t pages = 0;
+		uint32_t chksum = 0;
+
+		get( version );
+		get( generation );
+		get( pages );
+
+		pos = data.size() - sizeof(chksum);
+		get( chksum );
+
+		if( version != WEAR_TABLE_VERSION ||
+			pages != m_wear_table.size() ||
+			chksum != Config::crc32( data.data(), data.size() - sizeof(chksum) ) ) {
+			continue;
+		}
+
+		if( !newest || generation > m_wear_generation ) {
+			newest = std::move( data );
+			m_wear_generation = generation;
+			m_wear_slot = slot;
+		}
+	}
+
+	if( !newest ) {
+		CPPDEBUG( "no valid wear table" );
+		return;
+	}
+
+	const auto & data = *newest;
+	std::size_t pos = WEAR_TABLE_HEAD_SIZE - sizeof(uint32_t);
+
+	auto get = [this,&pos,&data]( auto & t ) {
+		std::memcpy( &t, &data[pos], sizeof(t) );
+		auto_endianess( t );
+		pos += sizeof(t);
+	};
+
+	uint32_t lowest = 0;
+	get( lowest );
+
+	for( uint32_t page = 0; page < m_wear_table.size(); page++ ) {
+		uint16_t diff = 0;
+		get( diff );
+		m_wear_table.set_count( page, lowest + diff );
+	}
+}
+
+bool SimpleFlashFs::write_wear_table()
+{
+	FlashMemoryInterface *wmem = get_wear_table_mem();
+
+	if( !wmem ) {
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock( m_wear_mutex );
+
+	const uint64_t generation = m_wear_generation + 1;
+	const unsigned slot = 1 - m_wear_slot;
+	const uint32_t lowest = m_wear_table.min_count();
+
+	std::vector<std::byte> data;
+
+	auto add = [this,&data]( auto t ) {
+		auto_endianess( t );
+		const std::size_t pos = data.size();
+		data.resize( pos + sizeof(t) );
+		std::memcpy( &data[pos], &t, sizeof(t) );
+	};
+
+	data.insert( data.end(), reinterpret_cast<const std::byte*>(WEAR_TABLE_MAGIC),
+				 reinterpret_cast<const std::byte*>(WEAR_TABLE_MAGIC) + sizeof(WEAR_TABLE_MAGIC) );
+	add( WEAR_TABLE_VERSION );
+	add( generation );
+	add( m_wear_table.size() );
+	add( lowest );
+
+	for( uint32_t page = 0; page < m_wear_table.size(); page++ ) {
+		// keeps the order of the pages, if one is worn much more than the others
+		add( static_cast<uint16_t>( std::min<uint32_t>( m_wear_table.count( page ) - lowest, std::numeric_limits<uint16_t>::max() ) ) );
+	}
+
+	add( Config::crc32( data.data(), data.size() ) );
+
+	if( data.size() > m_wear_config.size / 2 ) {
+		CPPDEBUG( "wear table region too small" );
+		return false;
+	}
+
+	const std::size_t address = get_wear_table_slot_address( slot );
+
+	region_erase( wmem, address, m_wear_config.size / 2 );
+
+	if( region_write( wmem, address, data.data(), data.size() ) != data.size() ) {
+		CPPDEBUG( "cannot write wear table" );
+		return false;
+	}
+
+	m_wear_slot = slot;
+	m_wear_generation = generation;
+	m_wear_table.written();
+
+	return true;
+}
+
+void SimpleFlashFs::page_erased( uint32_t page )
+{
+	{
+		std::lock_guard<std::mutex> lock( m_unverified_mutex );
+		m_unverified_pages.reset( page );
+	}
+
+	if( !m_wear_config.enabled ) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock( m_wear_mutex );
+	m_wear_table.erased( page );
+}
+
+std::optional<uint32_t> SimpleFlashFs::find_least_worn_free_data_page()
+{
+	auto is_free = [this]( uint32_t page ) {
+		return free_data_pages.count( page ) > 0;
+	};
+
+	if( auto page = m_wear_table.find_least_worn( false, is_free ); page ) {
+		return page;
+	}
+
+	if( free_data_pages.empty() ) {
+		return {};
+	}
+
+	// pages, that were given back without an erase, are not in the table
+	for( auto page = free_data_pages.find_next( header.max_inodes ); page; page = free_data_pages.find_next( *page + 1 ) ) {
+		m_wear_table.add_free_page( *page );
+	}
+
+	return m_wear_table.find_least_worn( false, is_free );
+}
+
+std::optional<uint32_t> SimpleFlashFs::allocate_free_data_page()
+{
+	if( is_block_mode() ) {
+		if( auto run = allocate_block_data_pages( 1 ); run ) {
+			return run->first_page;
+		}
+		return {};
+	}
+
+	if( !m_wear_config.enabled ) {
+		return base::SimpleFlashFsBase<Config>::allocate_free_data_page();
+	}
+
+	reclaim_if_no_free_data_pages( 1 );
+
+	std::optional<uint32_t> page;
+
+	{
+		std::lock_guard<Config::mutex_type> free_lock( m_free_data_pages_mutex );
+		std::lock_guard<std::mutex> lock( m_wear_mutex );
+
+		page = find_least_worn_free_data_page();
+
+		if( page ) {
+			free_data_pages.erase( *page );
+		}
+	}
+
+	if( !page ) {
+		CPPDEBUG( "no free data pages left" );
+		return {};
+	}
+
+	page_allocated( *page );
+
+	return page;
+}
+
+std::optional<base::PageRun> SimpleFlashFs::allocate_free_data_page_run( uint32_t near_page, uint32_t count )
+{
+	if( is_block_mode() ) {
+		return allocate_block_data_pages( count );
+	}
+
+	if( !m_wear_config.enabled ) {
+		return base::SimpleFlashFsBase<Config>::allocate_free_data_page_run( near_page, count );
+	}
+
+	reclaim_if_no_free_data_pages( count );
+
+	std::optional<base::PageRun> ret;
+
+	{
+		std::lock_guard<Config::mutex_type> free_lock( m_free_data_pages_mutex );
+		std::lock_guard<std::mutex> lock( m_wear_mutex );
+
+		// a new file starts at the least worn page, an existing one grows in place
+		if( near_page == 0 ) {
+			if( auto page = find_least_worn_free_data_page(); page ) {
+				near_page = *page;
+			}
+		}
+
+		ret = free_data_pages.allocate_run( near_page, count );
+	}
+
+	if( !ret ) {
+		CPPDEBUG( "no free data pages left" );
+		return {};
+	}
+
+	for( uint32_t i = 0; i < ret->count; i++ ) {
+		page_allocated( ret->first_page + i );
+	}
+
+	return ret;
+}
+
+bool SimpleFlashFs::steer_writers_to_banks() const
+{
+	if( m_wear_config.enabled || is_block_mode() ) {
+		return false;
+	}
+
+	return base::SimpleFlashFsBase<Config>::steer_writers_to_banks();
+}
+
+bool SimpleFlashFs::WearInodeRange::is_free( uint32_t page ) const
+{
+	return !fs.used_inode_pages.test( page ) && !fs.allocated_unwritten_pages.test( page );
+}
+
+bool SimpleFlashFs::WearInodeRange::has_next() const
+{
+	// m_inode_meta_mutex is locked by the allocator
+	std::lock_guard<std::mutex> lock( fs.m_wear_mutex );
+
+	if( next_page < fs.header.max_inodes ) {
+		return true;
+	}
+
+	// outdated entries are dropped here, so next() finds the page too
+	return fs.m_wear_table.find_least_worn( true, [this]( uint32_t page ) { return is_free( page ); } ).has_value();
+}
+
+uint32_t SimpleFlashFs::WearInodeRange::next()
+{
+	// m_inode_meta_mutex is locked by the allocator
+	std::lock_guard<std::mutex> lock( fs.m_wear_mutex );
+
+	auto free = [this]( uint32_t page ) {
+		return is_free( page );
+	};
+
+	if( auto page = fs.m_wear_table.take_least_worn( true, free ); page ) {
+		return *page;
+	}
+
+	if( next_page == 0 ) {
+		// pages, that were never erased since init(), are not in the table
+		for( uint32_t page = 0; page < fs.header.max_inodes; page++ ) {
+			if( is_free( page ) ) {
+				fs.m_wear_table.add_free_page( page );
+			}
+		}
+
+		if( auto page = fs.m_wear_table.take_least_worn( true, free ); page ) {
+			return *page;
+		}
+	}
+
+	// all pages in order. Behind the last one has_next() is only true,
+	// while the table has a free page.
+	return next_page++;
+}
+
+void SimpleFlashFs::BlockInodeRange::reset()
+{
+	// m_inode_meta_mutex is locked by the allocator
+	const uint32_t first_page = fs.get_erase_block_pages() - 1;
+	const uint32_t max_inodes = fs.header.max_inodes;
+
+	next_page = fs.m_next_inode_page;
+
+	if( next_page < first_page || next_page >= max_inodes ) {
+		next_page = first_page;
+	}
+
+	left = max_inodes - first_page;
+
+	if( fs.m_cleaning ) {
+		return;
+	}
+
+	// one block is reserved for the cleaner
+	uint32_t free_pages = 0;
+
+	for( uint32_t i = 0, page = next_page; i < left && free_pages <= fs.get_erase_block_pages(); i++ ) {
+		if( fs.is_free_inode_page( page ) ) {
+			free_pages++;
+		}
+
+		page = page + 1 < max_inodes ? page + 1 : first_page;
+	}
+
+	if( free_pages <= fs.get_erase_block_pages() ) {
+		CPPDEBUG( "no free inode pages left, clean_segments() has to be called" );
+		left = 0;
+	}
+}
+
+uint32_t SimpleFlashFs::BlockInodeRange::next()
+{
+	const uint32_t page = next_page;
+
+	next_page = next_page + 1 < fs.header.max_inodes ? next_page + 1 : fs.get_erase_block_pages() - 1;
+	left--;
+
+	// the allocator takes the first free page, the next allocation starts behind it
+	if( fs.is_free_inode_page( page ) ) {
+		fs.m_next_inode_page = next_page;
+
+		std::lock_guard<std::mutex> lock( fs.m_block_mutex );
+		fs.block_written( fs.get_block_of_page( page ) );
+	}
+
+	return page;
+}
+
+void SimpleFlashFs::init_erase_blocks()
+{
+	std::lock_guard<std::mutex> lock( m_block_mutex );
+
+	// -1 for the header page
+	m_dead_pages.resize( static_cast<uint32_t>( header.filesystem_size - 1 ) );
+	m_block_written.assign( get_number_of_blocks(), 0 );
+	m_block_erases.assign( get_number_of_blocks(), 0 );
+	m_block_clock = 0;
+	m_block_mounting = true;
+	m_next_data_page = header.max_inodes;
+	m_next_inode_page = 0;
+}
+
+bool SimpleFlashFs::is_page_erased( uint32_t page, Config::page_type & buffer )
+{
+	const std::size_t address = header.page_size + static_cast<std::size_t>(page) * header.page_size;
+	const std::byte *data = nullptr;
+
+	if( mem->can_map_read() ) {
+		data = mem->map_read( address, header.page_size );
+	}
+
+	if( !data ) {
+		buffer.resize( header.page_size );
+
+		if( mem->read( address, buffer.data(), buffer.size() ) != buffer.size() ) {
+			return false;
+		}
+
+		data = buffer.data();
+	}
+
+	return std::all_of( data, data + header.page_size, []( std::byte b ) { return b == std::byte(0xFF); } );
+}
+
+void SimpleFlashFs::find_dead_pages()
+{
+	const uint32_t block_pages = get_erase_block_pages();
+	typename Config::page_type buffer;
+	std::vector<uint32_t> dead_pages;
+
+	{
+		std::lock_guard<Config::mutex_type> lock( m_inode_meta_mutex );
+
+		// shared with the header, so they are never erased
+		for( uint32_t page = 0; page < block_pages - 1; page++ ) {
+			used_inode_pages.set( page );
+		}
+
+		// a page with a crc error is only free, if it is erased
+		for( uint32_t page = block_pages - 1; page < header.max_inodes; page++ ) {
+			if( !used_inode_pages.test( page ) && !is_page_erased( page, buffer ) ) {
+				used_inode_pages.set( page );
+				dead_pages.push_back( page );
+			}
+		}
+	}
+
+	{
+		std::lock_guard<Config::mutex_type> lock( m_free_data_pages_mutex );
+		std::lock_guard<std::mutex> block_lock( m_block_mutex );
+
+		for( auto page = free_data_pages.find_next( header.max_inodes ); page; page = free_data_pages.find_next( *page + 1 ) ) {
+			if( !is_page_erased( *page, buffer ) ) {
+				dead_pages.push_back( *page );
+			}
+		}
+
+		for( auto page : dead_pages ) {
+			free_data_pages.erase( page );
+			m_dead_pages.set( page );
+		}
+
+		m_block_mounting = false;
+	}
+
+	for( uint32_t block = 1; block < get_number_of_blocks(); block++ ) {
+		const uint32_t first_page = get_first_page_of_block( block );
+		bool dead = true;
+
+		{
+			std::lock_guard<std::mutex> lock( m_block_mutex );
+
+			for( uint32_t page = first_page; page < first_page + block_pages && dead; page++ ) {
+				dead = m_dead_pages.test( page );
+			}
+
+			if( dead ) {
+				for( uint32_t page = first_page; page < first_page + block_pages; page++ ) {
+					m_dead_pages.reset( page );
+				}
+			}
+		}
+
+		if( dead ) {
+			erase_block( block );
+		}
+	}
+
+	CPPDEBUG( Tools::format( "%d dead pages", get_number_of_dead_pages() ) );
+}
+
+std::size_t SimpleFlashFs::get_number_of_dead_pages() const
+{
+	std::lock_guard<std::mutex> lock( m_block_mutex );
+
+	std::size_t count = 0;
+
+	for( uint32_t page = 0; page < m_dead_pages.size(); page++ ) {
+		if( m_dead_pages.test( page ) ) {
+			count++;
+		}
+	}
+
+	return count;
+}
+
+void SimpleFlashFs::block_written( uint32_t block )
+{
+	if( block < m_block_written.size() ) {
+		m_block_written[block] = ++m_block_clock;
+	}
+}
+
+std::optional<base::PageRun> SimpleFlashFs::allocate_block_data_pages( uint32_t count )
+{
+	reclaim_if_no_free_data_pages( count );
+
+	std::lock_guard<Config::mutex_type> lock( m_free_data_pages_mutex );
+
+	std::size_t available = free_data_pages.size();
+
+	// one block is reserved for the cleaner
+	if( !m_cleaning ) {
+		available = available > get_erase_block_pages() ? available - get_erase_block_pages() : 0;
+	}
+
+	if( available == 0 ) {
+		CPPDEBUG( "no free data pages left, clean_segments() has to be called" );
+		return {};
+	}
+
+	// continue behind the last allocated page
+	auto first = free_data_pages.find_next( m_next_data_page );
+
+	if( !first ) {
+		first = free_data_pages.find_first();
+	}
+
+	if( !first ) {
+		CPPDEBUG( "no free data pages left" );
+		return {};
+	}
+
+	base::PageRun run{ *first, 1 };
+
+	while( run.count < count && run.count < available && free_data_pages.count( run.first_page + run.count ) ) {
+		run.count++;
+	}
+
+	std::lock_guard<std::mutex> block_lock( m_block_mutex );
+
+	for( uint32_t page = run.first_page; page < run.first_page + run.count; page++ ) {
+		free_data_pages.erase( page );
+		block_written( get_block_of_page( page ) );
+	}
+
+	m_next_data_page = run.first_page + run.count;
+
+	return run;
+}
+
+void SimpleFlashFs::mark_page_dead( uint32_t page )
+{
+	const uint32_t block = get_block_of_page( page );
+	const uint32_t first_page = get_first_page_of_block( block );
+	bool dead = true;
+
+	{
+		std::lock_guard<std::mutex> lock( m_block_mutex );
+
+		m_dead_pages.set( page );
+
+		// all blocks are checked at the end of the mount
+		if( m_block_mounting || block == 0 ) {
+			return;
+		}
+
+		for( uint32_t p = first_page; p < first_page + get_erase_block_pages() && dead; p++ ) {
+			dead = m_dead_pages.test( p );
+		}
+
+		// nobody else erases the block
+		if( dead ) {
+			for( uint32_t p = first_page; p < first_page + get_erase_block_pages(); p++ ) {
+				m_dead_pages.reset( p );
+			}
+		}
+	}
+
+	if( dead ) {
+		erase_block( block );
+	}
+}
+
+void SimpleFlashFs::erase_block( uint32_t block )
+{
+	const uint32_t block_pages = get_erase_block_pages();
+	const uint32_t first_page = get_first_page_of_block( block );
+
+	{
+		const std::size_t address = header.page_size + static_cast<std::size_t>(first_page) * header.page_size;
+		const std::size_t size = static_cast<std::size_t>(block_pages) * header.page_size;
+		BankLock lock( *this, get_bank_mask( address, size ) );
+		mem->erase( address, size );
+	}
+
+	if( first_page < header.max_inodes ) {
+		std::lock_guard<Config::mutex_type> lock( m_inode_meta_mutex );
+
+		for( uint32_t page = first_page; page < first_page + block_pages; page++ ) {
+			allocated_unwritten_pages.reset( page );
+			used_inode_pages.reset( page );
+			page_erased( page );
+			page_changed( page );
+		}
+	} else {
+		std::lock_guard<Config::mutex_type> lock( m_free_data_pages_mutex );
+
+		for( uint32_t page = first_page; page < first_page + block_pages; page++ ) {
+			free_data_pages.insert( page );
+			page_erased( page );
+			page_changed( page );
+		}
+	}
+
+	std::lock_guard<std::mutex> lock( m_block_mutex );
+	m_block_erases[block]++;
+}
+
+void SimpleFlashFs::erase_and_free_page( uint32_t page )
+{
+	if( !is_block_mode() ) {
+		base::SimpleFlashFsBase<Config>::erase_and_free_page( page );
+		return;
+	}
+
+	// the page is erased together with its block
+	if( page < header.max_inodes ) {
+		std::lock_guard<Config::mutex_type> lock( m_inode_meta_mutex );
+		allocated_unwritten_pages.reset( page );
+		used_inode_pages.set( page );
+	}
+
+	mark_page_dead( page );
+}
+
+void SimpleFlashFs::erase_inode_page( uint32_t page )
+{
+	if( !is_block_mode() ) {
+		base::SimpleFlashFsBase<Config>::erase_inode_page( page );
+		return;
+	}
+
+	// a deleted file hides its older versions, that are still on the flash.
+	// clean_segments() drops it, if there are no older versions left.
+}
+
+bool SimpleFlashFs::page_is_relocated( uint32_t page ) const
+{
+	const uint32_t block = m_cleaning_block;
+
+	return block != 0 && get_block_of_page( page ) == block;
+}
+
+bool SimpleFlashFs::handle_opened( file_handle_t * file )
+{
+	if( !is_block_mode() ) {
+		return true;
+	}
+
+	// the cleaner does not relocate the inode after this
+	std::lock_guard<std::mutex> clean_lock( m_clean_mutex );
+	std::lock_guard<std::mutex> lock( m_block_mutex );
+
+	// the cleaner has written a newer version, after the file was found
+	if( m_dead_pages.test( file->page ) ) {
+		return false;
+	}
+
+	m_open_inodes[file->inode.inode_number]++;
+
+	return true;
+}
+
+void SimpleFlashFs::handle_closed( file_handle_t * file )
+{
+	std::lock_guard<std::mutex> lock( m_block_mutex );
+
+	// a new file, that was never flushed, has no inode number
+	auto it = m_open_inodes.find( file->inode.inode_number );
+
+	if( it == m_open_inodes.end() ) {
+		return;
+	}
+
+	if( --it->second == 0 ) {
+		m_open_inodes.erase( it );
+	}
+}
+
+std::size_t SimpleFlashFs::clean_segments( std::size_t max_blocks )
+{
+	if( !is_block_mode() ) {
+		return 0;
+	}
+
+	std::lock_guard<std::mutex> lock( m_clean_mutex );
+
+	m_cleaning = true;
+
+	std::set<uint32_t> skipped;
+	std::size_t erased = 0;
+
+	while( erased < max_blocks ) {
+		auto block = choose_victim_block( skipped );
+
+		if( !block ) {
+			break;
+		}
+
+		if( clean_block( *block ) ) {
+			erased++;
+		} else {
+			skipped.insert( *block );
+		}
+	}
+
+	m_cleaning = false;
+
+	return erased;
+}
+
+std::optional<uint32_t> SimpleFlashFs::choose_victim_block( const std::set<uint32_t> & skipped )
+{
+	const uint32_t block_pages = get_erase_block_pages();
+	std::optional<uint32_t> victim;
+	double victim_score = 0;
+
+	for( uint32_t block = 1; block < get_number_of_blocks(); block++ ) {
+		if( skipped.count( block ) ) {
+			continue;
+		}
+
+		const uint32_t first_page = get_first_page_of_block( block );
+		uint32_t free_pages = 0;
+		uint32_t dead_pages = 0;
+		uint64_t age = 0;
+
+		if( first_page < header.max_inodes ) {
+			std::lock_guard<Config::mutex_type> lock( m_inode_meta_mutex );
+
+			for( uint32_t page = first_page; page < first_page + block_pages; page++ ) {
+				free_pages += is_free_inode_page( page );
+			}
+		} else {
+			std::lock_guard<Config::mutex_type> lock( m_free_data_pages_mutex );
+
+			for( uint32_t page = first_page; page < first_page + block_pages; page++ ) {
+				free_pages += free_data_pages.count( page );
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock( m_block_mutex );
+
+			for( uint32_t page = first_page; page < first_page + block_pages; page++ ) {
+				dead_pages += m_dead_pages.test( page );
+			}
+
+			age = m_block_clock - m_block_written[block];
+		}
+
+		// the allocator is still filling the block, or there is nothing to gain
+		if( free_pages > 0 || dead_pages == 0 ) {
+			continue;
+		}
+
+		const double u = static_cast<double>( block_pages - dead_pages ) / block_pages;
+		const double score = ( 1.0 - u ) * static_cast<double>( age + 1 ) / ( 1.0 + u );
+
+		if( !victim || score > victim_score ) {
+			victim = block;
+			victim_score = score;
+		}
+	}
+
+	return victim;
+}
+
+bool SimpleFlashFs::clean_block( uint32_t block )
+{
+	const uint32_t first_page = get_first_page_of_block( block );
+	const uint32_t last_page = first_page + get_erase_block_pages();
+
+	auto in_block = [first_page,last_page]( uint32_t page ) {
+		return page >= first_page && page < last_page;
+	};
+
+	uint64_t erases = 0;
+
+	{
+		std::lock_guard<std::mutex> lock( m_block_mutex );
+		erases = m_block_erases[block];
+	}
+
+	const auto scanned_pages = scan_inode_pages( 0, header.max_inodes, false );
+
+	// latest version of each inode
+	std::map<uint64_t,const ScannedPage*> latest;
+	// inodes with a version outside of the block
+	std::set<uint64_t> outside;
+
+	for( const auto & scanned : scanned_pages ) {
+		if( scanned.read_error ) {
+			if( in_block( scanned.page ) ) {
+				CPPDEBUG( "cannot read an inode page of the block" );
+				return false;
+			}
+			continue;
+		}
+
+		const auto & inode = scanned.inode->inode;
+
+		if( !in_block( scanned.page ) ) {
+			outside.insert( inode.inode_number );
+		}
+
+		auto it = latest.find( inode.inode_number );
+
+		if( it == latest.end() || it->second->inode->inode.inode_version_number < inode.inode_version_number ) {
+			latest[inode.inode_number] = &scanned;
+		}
+	}
+
+	std::vector<const ScannedPage*> relocate;
+	std::set<uint32_t> live_pages;
+
+	for( const auto & [ inode_number, scanned ] : latest ) {
+		const auto & inode = scanned->inode->inode;
+		bool move = in_block( scanned->page );
+
+		if( inode.file_name.empty() ) {
+			// a deleted file has to hide its older versions
+			if( move && outside.count( inode_number ) ) {
+				relocate.push_back( scanned );
+			}
+			continue;
+		}
+
+		auto check = [&]( uint32_t page ) {
+			if( in_block( page ) ) {
+				live_pages.insert( page );
+				move = true;
+			}
+		};
+
+		for( const auto & page : inode.data_pages ) {
+			check( page.page_id );
+		}
+
+		for( auto page : inode.indirect_pages ) {
+			check( page );
+		}
+
+		for( auto page : inode.double_indirect_pages ) {
+			check( page );
+		}
+
+		if( move ) {
+			relocate.push_back( scanned );
+		}
+	}
+
+	// an open handle would flush the next version, referencing the old pages
+	{
+		std::lock_guard<std::mutex> lock( m_block_mutex );
+
+		for( auto scanned : relocate ) {
+			if( m_open_inodes.count( scanned->inode->inode.inode_number ) ) {
+				CPPDEBUG( "block contains pages of an open file" );
+				return false;
+			}
+		}
+	}
+
+	// a page, that is neither free, dead nor used by an inode,
+	// belongs to a file, that is not flushed yet
+	for( uint32_t page = first_page; page < last_page; page++ ) {
+		bool unflushed = false;
+
+		if( page < header.max_inodes ) {
+			std::lock_guard<Config::mutex_type> lock( m_inode_meta_mutex );
+			unflushed = allocated_unwritten_pages.test( page );
+		} else if( !live_pages.count( page ) ) {
+			std::lock_guard<Config::mutex_type> lock( m_free_data_pages_mutex );
+			std::lock_guard<std::mutex> block_lock( m_block_mutex );
+			unflushed = !free_data_pages.count( page ) && !m_dead_pages.test( page );
+		}
+
+		if( unflushed ) {
+			CPPDEBUG( "block contains pages of a file, that is not flushed" );
+			return false;
+		}
+	}
+
+	m_cleaning_block = block;
+
+	bool ok = true;
+
+	for( auto scanned : relocate ) {
+		if( !relocate_inode( *scanned ) ) {
+			ok = false;
+			break;
+		}
+	}
+
+	m_cleaning_block = 0;
+
+	if( !ok ) {
+		return false;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock( m_block_mutex );
+
+		if( m_block_erases[block] != erases ) {
+			return true;
+		}
+	}
+
+	// the remaining inode pages are old versions and deleted files without older versions
+	if( first_page < header.max_inodes ) {
+		std::vector<uint32_t> obsolete;
+
+		{
+			std::lock_guard<Config::mutex_type> lock( m_inode_meta_mutex );
+			std::lock_guard<std::mutex> block_lock( m_block_mutex );
+
+			for( uint32_t page = first_page; page < last_page; page++ ) {
+				if( used_inode_pages.test( page ) && !m_dead_pages.test( page ) ) {
+					obsolete.push_back( page );
+				}
+			}
+		}
+
+		for( auto page : obsolete ) {
+			mark_page_dead( page );
+		}
+	}
+
+	std::lock_guard<std::mutex> lock( m_block_mutex );
+
+	return m_block_erases[block] != erases;
+}
+
+bool SimpleFlashFs::relocate_inode( const ScannedPage & scanned )
+{
+	typename Config::page_type buffer;
+	auto inode_page = read_inode_page( scanned.page, buffer );
+
+	if( inode_page.empty() ) {
+		CPPDEBUG( "cannot read inode page" );
+		return false;
+	}
+
+	auto file = get_inode( inode_page );
+	file.page = scanned.page;
+
+	const uint32_t block = m_cleaning_block;
+	auto & data_pages = file.inode.data_pages;
+	std::vector<std::pair<uint32_t,uint32_t>> moved; // old page, new page
+	typename Config::page_type page( header.page_size );
+	bool ok = true;
+
+	for( std::size_t i = 0; i < data_pages.size(); i++ ) {
+		if( get_block_of_page( data_pages[i].page_id ) != block ) {
+			continue;
+		}
+
+		auto new_page = allocate_free_data_page();
+
+		if( !new_page ) {
+			ok = false;
+			break;
+		}
+
+		moved.emplace_back( data_pages[i].page_id, *new_page );
+
+		std::size_t ret = 0;
+
+		if( read_page( data_pages[i].page_id, page ) ) {
+			const std::size_t address = header.page_size + static_cast<std::size_t>(*new_page) * header.page_size;
+			BankLock lock( *this, get_bank_mask( address, page.size() ) );
+			ret = mem->write( address, page.data(), page.size() );
+		}
+
+		if( ret != page.size() ) {
+			CPPDEBUG( "cannot copy data page" );
+			ok = false;
+			break;
+		}
+
+		data_pages[i].page_id = *new_page;
+	}
+
+	// the new pages could need more extents
+	if( ok && get_inode_data_pages_entries( &file ) > get_max_inode_data_pages( &file ) ) {
+		CPPDEBUG( "relocated pages do not fit into the inode" );
+		ok = false;
+	}
+
+	if( ok ) {
+		// flush() releases the old pages
+		for( const auto & [ old_page, new_page ] : moved ) {
+			keep_replaced_data_page( &file, old_page );
+		}
+
+		file.modified = true;
+		ok = flush( &file );
+	}
+
+	if( !ok ) {
+		// the inode on the flash still uses the old pages
+		for( const auto & [ old_page, new_page ] : moved ) {
+			erase_and_free_page( new_page );
+		}
+
+		file.modified = false;
+	}
+
+	return ok;
+}
+
+} // namespace SimpleFlashFs::dynamic
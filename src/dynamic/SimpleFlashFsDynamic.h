@@ -7,9 +7,17 @@
 #define SRC_DYNAMIC_SIMPLEFLASHFSDYNAMIC_H_
 
 #include "../base/SimpleFlashFsBase.h"
+#include "SimpleFlashFsWearTable.h"
 #include <memory>
 #include <list>
 #include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <condition_variable>
+#include <deque>
+#include <atomic>
+#include <set>
+#include <map>
 
 namespace SimpleFlashFs {
 
@@ -26,23 +34,43 @@ struct Config
 
 	template<class T> class vector_type : public std::vector<T> {};
 
+	// in RAM file name index, see base/SimpleFlashFsNameIndex.h
+	static constexpr bool     USE_NAME_INDEX = true;
+	static constexpr uint32_t NAME_INDEX_SIZE = 0; // no limit
+
+	template<class T> class name_index_vector_type : public std::vector<T> {};
+
+	// read only snapshots, see SimpleFlashFsBase::open_snapshot()
+	static constexpr bool USE_SNAPSHOTS = true;
+
+	template<class T> class snapshot_vector_type : public std::vector<T> {};
+
+	// page tables of large files, see Header::VERSION_PAGE_TABLES
+	static constexpr bool USE_PAGE_TABLES = true;
+
+	template<class T> class page_table_vector_type : public std::vector<T> {};
+
+	// see FileHandle::set_tail_buffer()
+	static constexpr bool USE_TAIL_BUFFER = true;
+
+	using tail_page_type = page_type;
+
+	// banks of the memory, that are locked separately. See FlashMemoryInterface::get_bank_size()
+	// A device with more banks shares the locks, bank i uses lock i % MAX_BANKS.
+	static constexpr std::size_t MAX_BANKS = 8;
+
 	static uint32_t crc32( const std::byte *bytes, size_t len );
 
 	// AI generated by GitHub Copilot Claude Opus 4.7 START
 	// Real mutex so the dynamic/hosted build is safe against
 	// concurrent writers reaching the same SimpleFlashFs instance
 	// from multiple threads (e.g. via SimpleFlashFsThreadedVfsServer).
-	//
-	// MUST be recursive: code paths like find_file_*() iterate
-	// across freshly created FileHandle<> temporaries whose
-	// destructor calls fs->free_unwritten_pages() - which itself
-	// re-enters the same m_inode_meta_mutex. With a plain
-	// std::mutex that re-entry is undefined behaviour and in
-	// practice deadlocks the writer. A recursive_mutex makes the
-	// re-entry safe at the cost of a small per-lock overhead, which
-	// is irrelevant compared to the cost of touching flash.
-	using mutex_type = std::recursive_mutex;
 	// AI generated by GitHub Copilot Claude Opus 4.7 END
+	//
+	// Not recursive: no lock is held while a FileHandle is destroyed,
+	// the temporary handles of find_file_*() are disconnected.
+	// Lookups lock shared, so they do not block each other.
+	using mutex_type = std::shared_mutex;
 };
 
 
@@ -53,9 +81,171 @@ public:
 	using Inode = base::Inode<Config>;
 	using FileHandle = base::FileHandle<Config,base::SimpleFlashFsBase<Config>>;
 
+	/**
+	 * see start_reclamation_worker()
+	 */
+	struct ReclamationConfig
+	{
+		// maximum number of erased pages per second, 0: no limit
+		std::size_t max_erases_per_second = 0;
+	};
+
+	/**
+	 * see set_checkpoint()
+	 */
+	struct CheckpointConfig
+	{
+		// nullptr: the memory of the filesystem, behind the last page
+		FlashMemoryInterface *mem = nullptr;
+		std::size_t address = 0;
+		// 0: no checkpoint. The region is split into two slots.
+		std::size_t size = 0;
+	};
+
+	static constexpr uint16_t CHECKPOINT_VERSION = 1;
+
+	/**
+	 * see set_wear_leveling()
+	 */
+	struct WearLevelingConfig
+	{
+		bool enabled = false;
+		// persistent erase counters
+		// nullptr: the memory of the filesystem, behind the last page
+		FlashMemoryInterface *mem = nullptr;
+		std::size_t address = 0;
+		// 0: the counters are kept in RAM only. The region is split into two slots.
+		std::size_t size = 0;
+		// the table is written after this number of erases
+		std::size_t write_interval = 64;
+	};
+
+	static constexpr uint16_t WEAR_TABLE_VERSION = 1;
+
+protected:
+	// inode pages, least worn first, see set_wear_leveling()
+	class WearInodeRange : public base::HeaderInodeRangeInterface<Config>
+	{
+		SimpleFlashFs & fs;
+		uint32_t next_page = 0; // all pages in order, if no least worn page is known
+
+	public:
+		WearInodeRange( SimpleFlashFs & fs_ )
+		: fs( fs_ )
+		{
+		}
+
+		void reset() override {
+			next_page = 0;
+		}
+
+		bool has_next() const override;
+		uint32_t next() override;
+
+		uint32_t start() override {
+			reset();
+			return next();
+		}
+
+	private:
+		bool is_free( uint32_t page ) const;
+	};
+
+	// inode pages in the order they are written, see clean_segments()
+	class BlockInodeRange : public base::HeaderInodeRangeInterface<Config>
+	{
+		SimpleFlashFs & fs;
+		uint32_t next_page = 0;
+		uint32_t left = 0; // pages, that were not returned yet
+
+	public:
+		BlockInodeRange( SimpleFlashFs & fs_ )
+		: fs( fs_ )
+		{
+		}
+
+		void reset() override;
+
+		bool has_next() const override {
+			return left > 0;
+		}
+
+		uint32_t next() override;
+
+		uint32_t start() override {
+			reset();
+			return next();
+		}
+	};
+
+	struct ScannedPage
+	{
+		uint32_t page = 0;
+		bool read_error = false; // otherwise inode is valid
+		std::shared_ptr<FileHandle> inode;
+	};
+
+private:
+	ReclamationConfig			m_reclamation_config{};
+	std::thread					m_reclamation_thread;
+	mutable std::mutex			m_reclamation_mutex;
+	std::condition_variable		m_reclamation_cv;
+	std::deque<uint32_t>		m_reclamation_queue;
+	bool						m_reclamation_running = false;
+	bool						m_reclamation_stop = false;
+
+	CheckpointConfig			m_checkpoint_config{};
+	std::mutex					m_checkpoint_mutex;
+	bool						m_checkpoint_active = false;  // changes are logged
+	bool						m_checkpoint_rewrite = false; // log is running full
+	unsigned					m_checkpoint_slot = 0;
+	uint64_t					m_checkpoint_generation = 0;
+	std::size_t					m_checkpoint_log_start = 0;   // relative to the slot
+	std::size_t					m_checkpoint_log_pos = 0;     // relative to the slot
+
+	unsigned					m_mount_threads = 0;
+
+	// lazy mount, the flash is scanned without holding m_mount_mutex
+	bool						m_lazy_mount = false;
+	std::mutex					m_mount_mutex;
+	std::condition_variable		m_mount_cv;                   // a scan or the merge is done
+	std::atomic<bool>			m_mount_pending = false;
+	std::optional<std::thread::id> m_mount_merging;           // thread, that completes the mount
+	uint32_t					m_mount_next_page = 0;        // next inode page to scan
+	unsigned					m_mount_scans = 0;            // running scans, their pages are below m_mount_next_page
+	std::vector<ScannedPage>	m_mount_scanned_pages;
+
+	WearLevelingConfig			m_wear_config{};
+	mutable std::mutex			m_wear_mutex;
+	WearTable					m_wear_table;
+	WearInodeRange				m_wear_inode_range{*this};
+	unsigned					m_wear_slot = 0;
+	uint64_t					m_wear_generation = 0;
+
+	// pages, that could be dirty after a power loss, they are checked before they are written.
+	// m_unverified_mutex is locked after all other mutexes
+	std::mutex					m_unverified_mutex;
+	base::Bitmap<Config>		m_unverified_pages;
+
+	// erase block mode, m_block_mutex is locked after all other mutexes
+	mutable std::mutex			m_block_mutex;
+	base::Bitmap<Config>		m_dead_pages;                 // obsolete pages, that are not erased yet
+	std::vector<uint64_t>		m_block_written;              // m_block_clock at the last allocation in the block
+	std::vector<uint64_t>		m_block_erases;
+	uint64_t					m_block_clock = 0;
+	bool						m_block_mounting = false;     // blocks are not erased during the mount
+	uint32_t					m_next_data_page = 0;         // m_free_data_pages_mutex
+	uint32_t					m_next_inode_page = 0;        // m_inode_meta_mutex
+	BlockInodeRange				m_block_inode_range{*this};
+	std::map<uint64_t,unsigned>	m_open_inodes;                // inode number, number of open handles
+	std::mutex					m_clean_mutex;
+	std::atomic<bool>			m_cleaning = false;           // the reserved pages can be allocated
+	std::atomic<uint32_t>		m_cleaning_block = 0;
+
 public:
 
 	SimpleFlashFs( FlashMemoryInterface *mem_interface );
+	~SimpleFlashFs();
 
 	/** creates a new fs
 	 *
@@ -69,11 +259,39 @@ public:
 	// read the fs the memory interface points to
 	// starting at offset 0
 	bool init() {
+		// the lazy mount of a previous init() is dropped
+		m_mount_pending = false;
+
+		// pages, that are still waiting for erase
+		reclaim_pages_now( get_number_of_pending_erase_pages() );
+
 		if( !base::SimpleFlashFsBase<Config>::init() ) {
 			return false;
 		}
 
-		read_all_free_data_pages();
+		if( m_wear_config.enabled ) {
+			load_wear_table();
+			header_inode_range = &m_wear_inode_range;
+		}
+
+		if( is_block_mode() ) {
+			// the pages, that are not erased, have to be found, so all inodes are read
+			header_inode_range = &m_block_inode_range;
+			read_all_free_data_pages();
+			return true;
+		}
+
+		if( load_checkpoint() ) {
+			return true;
+		}
+
+		if( m_lazy_mount ) {
+			start_lazy_mount();
+		} else {
+			read_all_free_data_pages();
+			write_checkpoint();
+		}
+
 		return true;
 	}
 
@@ -81,8 +299,344 @@ public:
 
 	std::list<std::shared_ptr<FileHandle>> get_all_inodes( bool do_error_corrections = true );
 
+	/**
+	 * Number of threads, that are reading and verifying the inode pages
+	 * in init() and get_all_inodes(). 0: one per CPU core.
+	 */
+	void set_mount_threads( unsigned threads );
+
+	/**
+	 * Lazy mount: init() validates only the header. open() scans the
+	 * inode pages until the file is found. The first allocation, or
+	 * erase, reads the remaining inode pages and builds the free data
+	 * pages. mount_step() does this in small steps, in idle time.
+	 *
+	 * Until the mount is complete get_number_of_free_data_pages() returns 0.
+	 * Is ignored, if a valid checkpoint exists. Has to be called before init().
+	 */
+	void set_lazy_mount( bool lazy );
+
+	/**
+	 * reads the next pages inode pages of a lazy mount.
+	 * Returns true, if the mount is complete.
+	 */
+	bool mount_step( std::size_t pages );
+
+	/**
+	 * reads all remaining inode pages of a lazy mount
+	 */
+	void finish_mount();
+
+	bool is_mount_complete() const {
+		return !m_mount_pending;
+	}
+
+	/**
+	 * Starts a thread, that erases obsolete data pages in the background.
+	 * flush() only queues the pages. The worker erases them and puts them
+	 * back into free_data_pages, the pool of erased pages. If the pool is
+	 * empty, an allocation erases a queued page inline.
+	 *
+	 * The queue is only kept in RAM. After a power loss the queued pages
+	 * are not used by any inode, but they are not erased. After a mount reading
+	 * all inode pages they are erased before they are used, see verify_allocated_page().
+	 * A checkpoint does not contain them as free pages, so they are
+	 * not used until the next full mount.
+	 */
+	bool start_reclamation_worker( const ReclamationConfig & config );
+
+	bool start_reclamation_worker() {
+		return start_reclamation_worker( ReclamationConfig() );
+	}
+
+	/**
+	 * stops the worker and erases all queued pages
+	 */
+	void stop_reclamation_worker();
+
+	std::size_t get_number_of_pending_erase_pages() const override;
+
+	/**
+	 * Persistent mount checkpoint, for fast startup.
+	 *
+	 * A slot of the checkpoint region contains a CRC protected snapshot
+	 * of the inode table and of the free data pages, followed by a log.
+	 * Every written inode page and every erased page is appended to the log.
+	 * So init() reads the snapshot and only the inode pages of the log,
+	 * instead of reading every inode page.
+	 *
+	 * If the log runs full, a new snapshot is written into the other slot,
+	 * with the next generation number. The slot with the highest valid
+	 * generation is used. Without a valid checkpoint init() scans all
+	 * inodes and writes a new one.
+	 *
+	 * The log is written in small pieces, so the memory should be a FRAM.
+	 * Every instance, that is modifying the filesystem, has to use the same
+	 * checkpoint. Pages that were allocated, but not written before a power
+	 * loss, stay unused until the checkpoint is discarded.
+	 *
+	 * Has to be called before create() or init().
+	 */
+	void set_checkpoint( const CheckpointConfig & config );
+
+	/**
+	 * writes a new snapshot, all older ones are invalid afterwards
+	 */
+	bool write_checkpoint();
+
+	/**
+	 * invalidates both slots. The next init() scans all inodes.
+	 */
+	void discard_checkpoint();
+
+	/**
+	 * Wear leveling by erase counters. Every erase of a page is counted.
+	 * The least worn free page is allocated for data, a new file starts
+	 * at the least worn free page, and inode pages are allocated least
+	 * worn first.
+	 *
+	 * The counters are written into a CRC protected table after
+	 * write_interval erases, alternately into two slots. Each counter
+	 * is stored as a 16 bit difference to the lowest counter. Erases
+	 * since the last write are lost on a power loss. create() keeps
+	 * the table, the pages are still worn.
+	 *
+	 * Has to be called before create() or init().
+	 */
+	void set_wear_leveling( const WearLevelingConfig & config );
+
+	bool is_wear_leveling_enabled() const {
+		return m_wear_config.enabled;
+	}
+
+	uint32_t get_erase_count( uint32_t page ) const;
+
+	/**
+	 * writes the erase counters now
+	 */
+	bool write_wear_table();
+
+	/**
+	 * Erase block mode, for devices that cannot erase single pages.
+	 * Is enabled by header.erase_block_size > 1 at create(). The number
+	 * of inode pages and the filesystem size are adjusted to whole erase
+	 * blocks. The first block contains the header, its inode pages are
+	 * not used.
+	 *
+	 * Pages are allocated one after the other, so the blocks are filled
+	 * sequentially. An obsolete page is not erased, it is marked as dead.
+	 * If all pages of a block are dead, the block is erased.
+	 *
+	 * clean_segments() erases blocks, that still contain valid pages.
+	 * It chooses up to max_blocks full blocks by cost and benefit:
+	 * (1 - u) * age / (1 + u), u is the ratio of the valid pages, age
+	 * is the time since the last allocation in the block. The valid
+	 * pages are copied to free pages and new versions of their inodes
+	 * are written, then the block is erased. A deleted file is kept,
+	 * until no older version of it is left on the flash.
+	 *
+	 * One erase block of data pages and one of inode pages are reserved
+	 * for the cleaner, the allocations fail before. Blocks containing
+	 * pages of open files, or of files that are not flushed yet, are
+	 * skipped, a handle would still use the old pages. open() waits,
+	 * until the cleaner is done.
+	 *
+	 * init() reads all inode pages and checks, if the unused pages are
+	 * erased. The checkpoint and the lazy mount are not used. With wear
+	 * leveling the erases are counted, but the allocation is sequential.
+	 *
+	 * Returns the number of erased blocks.
+	 */
+	std::size_t clean_segments( std::size_t max_blocks = 1 );
+
+	bool is_block_mode() const {
+		return header.erase_block_size > 1;
+	}
+
+	uint32_t get_erase_block_pages() const {
+		return is_block_mode() ? header.erase_block_size : 1;
+	}
+
+	/**
+	 * obsolete pages, that are waiting for the erase of their block
+	 */
+	std::size_t get_number_of_dead_pages() const;
+
 protected:
+	/**
+	 * Reads and decodes the inode pages [first_page,last_page). The pages
+	 * are split into chunks, one per thread. Only pages with a valid inode
+	 * or a read error are returned, ordered by page number.
+	 */
+	std::vector<ScannedPage> scan_inode_pages( uint32_t first_page, uint32_t last_page, bool do_error_corrections );
+
 	void read_all_free_data_pages();
+
+	/**
+	 * keeps the latest version of each inode, erases the older ones
+	 * and builds free_data_pages, used_inode_pages and the name index
+	 */
+	void merge_scanned_inode_pages( const std::vector<ScannedPage> & scanned_pages );
+
+	/**
+	 * After a mount reading all inode pages, a free page could be dirty.
+	 * A power loss stopped its erase, or the write of a new page.
+	 * All pages are checked once, when they are allocated.
+	 */
+	void set_all_pages_unverified();
+
+	/**
+	 * erases an allocated page, if it is not checked yet and not erased
+	 */
+	void verify_allocated_page( uint32_t page );
+
+	std::optional<FileHandle> find_file_lazy( const Config::string_view_type & name ) override;
+
+	void prepare_modification() override;
+
+	std::optional<uint32_t> allocate_free_data_page() override;
+	std::optional<base::PageRun> allocate_free_data_page_run( uint32_t near_page, uint32_t count ) override;
+
+	// wear leveling and the erase block allocator place the pages by their own rules
+	bool steer_writers_to_banks() const override;
+
+	void page_erased( uint32_t page ) override;
+
+	void erase_pages( base::PageSet<Config> & pages_to_erase ) override;
+
+	bool reclaim_pages_now( std::size_t count ) override;
+
+	void page_changed( uint32_t page ) override;
+
+	void page_allocated( uint32_t page ) override;
+
+	bool supports_erase_blocks() const override {
+		return true;
+	}
+
+	bool page_is_relocated( uint32_t page ) const override;
+
+	bool handle_opened( file_handle_t * file ) override;
+	void handle_closed( file_handle_t * file ) override;
+
+	void erase_inode_page( uint32_t page ) override;
+	void erase_and_free_page( uint32_t page ) override;
+
+private:
+	void reclamation_worker();
+
+	FlashMemoryInterface *get_checkpoint_mem() const;
+	std::size_t get_checkpoint_slot_size() const;
+	std::size_t get_checkpoint_slot_address( unsigned slot ) const;
+
+	void erase_pages_now_or_queued( base::PageSet<Config> & pages_to_erase );
+
+	void start_lazy_mount();
+
+	/**
+	 * scans the next pages inode pages without holding m_mount_mutex.
+	 * Returns false, if all pages are scanned, or are being scanned.
+	 */
+	bool scan_next_inode_pages( uint32_t pages );
+
+	/**
+	 * scans the remaining pages and merges them. Other threads wait,
+	 * until the merge is done. The merging thread returns immediately,
+	 * if the merge calls prepare_modification() again.
+	 */
+	void complete_lazy_mount();
+
+	/**
+	 * reads only the inode number and version of the pages from first_page on,
+	 * that are not scanned yet. Returns true, if one of them could be a newer
+	 * version of the inode.
+	 */
+	bool unscanned_newer_inode_version( uint32_t first_page, uint64_t inode_number, uint64_t version_number );
+
+	std::optional<std::vector<std::byte>> read_checkpoint_snapshot( unsigned slot, uint64_t & generation );
+	bool load_checkpoint();
+
+	/**
+	 * reads the inode pages of the log again.
+	 * Returns true if old inode versions, or pages that were not
+	 * committed, had to be erased.
+	 */
+	bool replay_checkpoint_log( std::vector<base::NameIndex<Config>::Entry> & inodes, const std::vector<uint32_t> & pages );
+
+	// m_inode_meta_mutex, m_free_data_pages_mutex, m_name_index_mutex and m_checkpoint_mutex have to be locked
+	bool build_checkpoint( std::vector<std::byte> & data );
+
+	/**
+	 * m_checkpoint_mutex has to be locked.
+	 * pending_pages are allocated inode pages, that are not written yet.
+	 * They start the log of the new slot.
+	 */
+	bool write_checkpoint_locked( const std::vector<std::byte> & data, const std::vector<uint32_t> & pending_pages );
+	bool write_checkpoint_log_entry( unsigned slot, uint64_t generation, std::size_t pos, uint32_t page );
+	void invalidate_checkpoint_slot( unsigned slot );
+	uint32_t checkpoint_log_checksum( uint64_t generation, uint32_t page ) const;
+
+	// lock the banks, if the checkpoint is on the memory of the filesystem
+	std::size_t checkpoint_read( std::size_t address, std::byte *data, std::size_t size );
+	std::size_t checkpoint_write( std::size_t address, const std::byte *data, std::size_t size );
+	void checkpoint_erase( std::size_t address, std::size_t size );
+
+	// lock the banks, if region_mem is the memory of the filesystem
+	std::size_t region_read( FlashMemoryInterface *region_mem, std::size_t address, std::byte *data, std::size_t size );
+	std::size_t region_write( FlashMemoryInterface *region_mem, std::size_t address, const std::byte *data, std::size_t size );
+	void region_erase( FlashMemoryInterface *region_mem, std::size_t address, std::size_t size );
+
+	FlashMemoryInterface *get_wear_table_mem() const;
+	std::size_t get_wear_table_slot_address( unsigned slot ) const;
+	void load_wear_table();
+
+	// m_free_data_pages_mutex and m_wear_mutex have to be locked
+	std::optional<uint32_t> find_least_worn_free_data_page();
+
+	// block 0 contains the header
+	uint32_t get_block_of_page( uint32_t page ) const {
+		return ( page + 1 ) / get_erase_block_pages();
+	}
+
+	uint32_t get_first_page_of_block( uint32_t block ) const {
+		return block * get_erase_block_pages() - 1;
+	}
+
+	uint32_t get_number_of_blocks() const {
+		return static_cast<uint32_t>( header.filesystem_size / get_erase_block_pages() );
+	}
+
+	// m_inode_meta_mutex has to be locked
+	bool is_free_inode_page( uint32_t page ) const {
+		return !used_inode_pages.test( page ) && !allocated_unwritten_pages.test( page );
+	}
+
+	void init_erase_blocks();
+
+	/**
+	 * marks the pages, that are neither used nor erased, as dead
+	 * and erases the blocks containing only dead pages
+	 */
+	void find_dead_pages();
+
+	bool is_page_erased( uint32_t page, Config::page_type & buffer );
+
+	std::optional<base::PageRun> allocate_block_data_pages( uint32_t count );
+
+	// m_block_mutex has to be locked
+	void block_written( uint32_t block );
+
+	void mark_page_dead( uint32_t page );
+	void erase_block( uint32_t block );
+
+	std::optional<uint32_t> choose_victim_block( const std::set<uint32_t> & skipped );
+	bool clean_block( uint32_t block );
+
+	/**
+	 * copies the pages of the inode, that are inside of m_cleaning_block,
+	 * and writes the next version of the inode
+	 */
+	bool relocate_inode( const ScannedPage & scanned );
 };
 
 } // namespace dynamic
@@ -0,0 +1,151 @@
+/**
+ * erase counters for the wear leveling of the dynamic implementation
+ * @author Copyright (c) 2026 Martin Oberzalek
+ */
+
+#ifndef SRC_DYNAMIC_SIMPLEFLASHFSWEARTABLE_H_
+#define SRC_DYNAMIC_SIMPLEFLASHFSWEARTABLE_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace SimpleFlashFs::dynamic {
+
+/**
+ * Erase counter of each page, and the free pages ordered by their
+ * erase counter. Inode pages and data pages are kept in two sets.
+ *
+ * An erased page is added to its set. The owner does not remove
+ * allocated pages, an entry is dropped, if it is found at the front
+ * and the page is not free anymore, or was erased again meanwhile.
+ */
+class WearTable
+{
+public:
+	using count_type = uint32_t;
+
+private:
+	using entry_t = std::pair<count_type,uint32_t>; // erase count, page
+
+	std::vector<count_type> counts;
+	std::set<entry_t> free_inode_pages;
+	std::set<entry_t> free_data_pages;
+	uint32_t max_inodes = 0;
+	std::size_t erases_since_write = 0;
+
+public:
+	/**
+	 * pages: number of pages of the filesystem, without the header page
+	 */
+	void resize( uint32_t pages, uint32_t max_inodes_ ) {
+		counts.assign( pages, 0 );
+		free_inode_pages.clear();
+		free_data_pages.clear();
+		max_inodes = max_inodes_;
+		erases_since_write = 0;
+	}
+
+	uint32_t size() const {
+		return counts.size();
+	}
+
+	count_type count( uint32_t page ) const {
+		return page < counts.size() ? counts[page] : 0;
+	}
+
+	void set_count( uint32_t page, count_type count ) {
+		if( page < counts.size() ) {
+			counts[page] = count;
+		}
+	}
+
+	count_type min_count() const {
+		count_type ret = counts.empty() ? 0 : counts[0];
+
+		for( auto c : counts ) {
+			ret = std::min( ret, c );
+		}
+
+		return ret;
+	}
+
+	void erased( uint32_t page ) {
+		if( page >= counts.size() ) {
+			return;
+		}
+
+		counts[page]++;
+		erases_since_write++;
+		add_free_page( page );
+	}
+
+	void add_free_page( uint32_t page ) {
+		if( page >= counts.size() ) {
+			return;
+		}
+
+		get_set( page ).emplace( counts[page], page );
+	}
+
+	void clear_free_pages( bool inode_pages ) {
+		(inode_pages ? free_inode_pages : free_data_pages).clear();
+	}
+
+	bool has_free_pages( bool inode_pages ) const {
+		return !(inode_pages ? free_inode_pages : free_data_pages).empty();
+	}
+
+	/**
+	 * returns the least worn page, for which is_free( page ) is true.
+	 * The entry stays in the set. Outdated entries are removed.
+	 */
+	template<class F> std::optional<uint32_t> find_least_worn( bool inode_pages, F is_free ) {
+		auto & pages = inode_pages ? free_inode_pages : free_data_pages;
+
+		while( !pages.empty() ) {
+			const auto [count, page] = *pages.begin();
+
+			if( counts[page] == count && is_free( page ) ) {
+				return page;
+			}
+
+			pages.erase( pages.begin() );
+		}
+
+		return {};
+	}
+
+	/**
+	 * like find_least_worn(), but the entry is removed
+	 */
+	template<class F> std::optional<uint32_t> take_least_worn( bool inode_pages, F is_free ) {
+		auto page = find_least_worn( inode_pages, is_free );
+
+		if( page ) {
+			(inode_pages ? free_inode_pages : free_data_pages).erase( entry_t( counts[*page], *page ) );
+		}
+
+		return page;
+	}
+
+	std::size_t get_erases_since_write() const {
+		return erases_since_write;
+	}
+
+	void written() {
+		erases_since_write = 0;
+	}
+
+private:
+	std::set<entry_t> & get_set( uint32_t page ) {
+		return page < max_inodes ? free_inode_pages : free_data_pages;
+	}
+};
+
+} // namespace SimpleFlashFs::dynamic
+
+#endif /* SRC_DYNAMIC_SIMPLEFLASHFSWEARTABLE_H_ */
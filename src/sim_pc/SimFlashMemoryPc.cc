@@ -67,6 +67,47 @@ std::size_t SimFlashFsFlashMemory::read( std::size_t address, std::byte *data, s
 	return data_read;
 }
 
+std::size_t SimFlashFsFlashMemory::write_v( std::span<const WriteVec> vec )
+{
+	std::lock_guard<std::mutex> lock( m_mutex );
+
+	std::size_t ret = 0;
+
+	for( const auto & v : vec ) {
+		file.seekg(v.address);
+		file.write(reinterpret_cast<const char*>(v.data), v.size);
+		ret += v.size;
+	}
+
+	file.flush(); // to simplify external debugging
+	return ret;
+}
+
+std::size_t SimFlashFsFlashMemory::read_v( std::span<const ReadVec> vec )
+{
+	std::lock_guard<std::mutex> lock( m_mutex );
+
+	std::size_t ret = 0;
+
+	for( const auto & v : vec ) {
+		file.seekg(v.address);
+		file.clear();
+		file.read( reinterpret_cast<char*>(v.data), v.size );
+		const long data_read = static_cast<long>(file.tellg()) - static_cast<long>(v.address);
+
+		if( data_read < 0 || static_cast<std::size_t>(data_read) != v.size ) {
+			if( data_read > 0 ) {
+				ret += data_read;
+			}
+			break;
+		}
+
+		ret += v.size;
+	}
+
+	return ret;
+}
+
 void SimFlashFsFlashMemory::erase( std::size_t address, std::size_t size )
 {
 	// AI generated by GitHub Copilot Claude Opus 4.7 START
@@ -55,6 +55,9 @@ public:
 
 	void erase( std::size_t address, std::size_t size ) override;
 
+	// one lock and one flush for all pages
+	std::size_t write_v( std::span<const WriteVec> vec ) override;
+	std::size_t read_v( std::span<const ReadVec> vec ) override;
 };
 
 } // namespace SimPc
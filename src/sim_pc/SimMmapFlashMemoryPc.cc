@@ -0,0 +1,153 @@
+/**
+ * @author Copyright (c) 2026 Martin Oberzalek
+ */
+#include "SimMmapFlashMemoryPc.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <stderr_exception.h>
+#include <format.h>
+#include <CpputilsDebug.h>
+
+using namespace Tools;
+using namespace SimpleFlashFs::SimPc;
+
+SimMmapFlashMemory::SimMmapFlashMemory( const std::string & filename_, std::size_t file_size_ )
+: filename( filename_ ),
+  file_size( file_size_ )
+{
+	if( !std::filesystem::exists( std::filesystem::status(filename)) ) {
+		std::ofstream out(filename.c_str());
+	}
+
+	std::filesystem::resize_file(filename, file_size);
+	map();
+}
+
+SimMmapFlashMemory::SimMmapFlashMemory( const std::string & filename_, Access access_ )
+: filename( filename_ ),
+  access( access_ )
+{
+	file_size = std::filesystem::file_size(filename);
+	map();
+}
+
+SimMmapFlashMemory::~SimMmapFlashMemory()
+{
+	if( mem ) {
+		if( !is_read_only() ) {
+			msync( mem, file_size, MS_SYNC );
+		}
+		munmap( mem, file_size );
+	}
+
+	if( fd >= 0 ) {
+		close( fd );
+	}
+}
+
+void SimMmapFlashMemory::map()
+{
+	fd = open( filename.c_str(), is_read_only() ? O_RDONLY : O_RDWR );
+
+	if( fd < 0 ) {
+		throw STDERR_EXCEPTION( Tools::format( "cannot open file '%s'", filename ) );
+	}
+
+	if( file_size == 0 ) {
+		return;
+	}
+
+	const int prot = is_read_only() ? PROT_READ : PROT_READ | PROT_WRITE;
+	void *addr = mmap( nullptr, file_size, prot, MAP_SHARED, fd, 0 );
+
+	if( addr == MAP_FAILED ) {
+		close( fd );
+		fd = -1;
+		throw STDERR_EXCEPTION( Tools::format( "cannot map file '%s'", filename ) );
+	}
+
+	mem = static_cast<std::byte*>( addr );
+}
+
+bool SimMmapFlashMemory::can_write( std::size_t address, std::size_t size ) const
+{
+	if( is_read_only() ) {
+		CPPDEBUG( Tools::format( "'%s' is opened read only", filename ) );
+		return false;
+	}
+
+	if( !in_range( address, size ) ) {
+		CPPDEBUG( Tools::format( "address + size %d + %d is out of range", address, size ) );
+		return false;
+	}
+
+	return true;
+}
+
+std::size_t SimMmapFlashMemory::write( std::size_t address, const std::byte *data, std::size_t size )
+{
+	if( !can_write( address, size ) ) {
+		return 0;
+	}
+
+	std::memcpy( mem + address, data, size );
+	changed();
+	return size;
+}
+
+std::size_t SimMmapFlashMemory::read( std::size_t address, std::byte *data, std::size_t size )
+{
+	if( !in_range( address, size ) ) {
+		CPPDEBUG( Tools::format( "address + size %d + %d is out of range", address, size ) );
+		return 0;
+	}
+
+	std::memcpy( data, mem + address, size );
+	return size;
+}
+
+void SimMmapFlashMemory::erase( std::size_t address, std::size_t size )
+{
+	if( !can_write( address, size ) ) {
+		return;
+	}
+
+	std::memset( mem + address, 0xFF, size );
+	changed();
+}
+
+const std::byte* SimMmapFlashMemory::map_read( std::size_t address, std::size_t size )
+{
+	if( !in_range( address, size ) ) {
+		return nullptr;
+	}
+
+	return mem + address;
+}
+
+void SimMmapFlashMemory::changed()
+{
+	if( sync_interval > 0 && ++changes_since_sync >= sync_interval ) {
+		sync();
+	}
+}
+
+bool SimMmapFlashMemory::sync()
+{
+	changes_since_sync = 0;
+
+	if( !mem || is_read_only() ) {
+		return true;
+	}
+
+	if( msync( mem, file_size, MS_SYNC ) != 0 ) {
+		CPPDEBUG( Tools::format( "msync of '%s' failed", filename ) );
+		return false;
+	}
+
+	return true;
+}
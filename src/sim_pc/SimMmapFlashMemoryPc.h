@@ -0,0 +1,115 @@
+/**
+ * flash memory simulator, that maps the image file into
+ * the address space.
+ *
+ * Uses the same image format as SimFlashFsFlashMemory,
+ * the file is the raw content of the flash.
+ * Reads are a plain memcpy without any lock and map_read() is
+ * supported, so the filesystem can use its zero copy paths.
+ * Writes and erases of different addresses do not share any state,
+ * so the memory can be split into banks, see set_bank_size().
+ * A write protected image can be opened read only, writes and
+ * erases fail then.
+ *
+ * @author Copyright (c) 2026 Martin Oberzalek
+ */
+#pragma once
+
+#include "../SimpleFlashFsFlashMemoryInterface.h"
+
+#include <atomic>
+#include <string>
+
+namespace SimpleFlashFs {
+namespace SimPc {
+
+class SimMmapFlashMemory : public FlashMemoryInterface
+{
+public:
+	enum class Access
+	{
+		ReadWrite,
+		ReadOnly
+	};
+
+protected:
+	std::string filename;
+	int fd = -1;
+	std::byte *mem = nullptr;
+	std::size_t file_size = 0;
+	Access access = Access::ReadWrite;
+
+	// msync() after this number of writes and erases, 0 = only in sync() and on destruction
+	std::size_t sync_interval = 0;
+	std::atomic<std::size_t> changes_since_sync = 0;
+
+	std::size_t bank_size = 0;
+
+public:
+	// create a new file, if it does not exists.
+	// automatically resizes the file to the given size
+	SimMmapFlashMemory( const std::string & filename_, std::size_t size );
+
+	// opens a file
+	// size will be automatically detected
+	SimMmapFlashMemory( const std::string & filename_, Access access_ = Access::ReadWrite );
+
+	~SimMmapFlashMemory();
+
+	SimMmapFlashMemory( const SimMmapFlashMemory & other ) = delete;
+	SimMmapFlashMemory & operator=( const SimMmapFlashMemory & other ) = delete;
+
+	std::size_t size() const override {
+		return file_size;
+	}
+
+	std::size_t write( std::size_t address, const std::byte *data, std::size_t size ) override;
+	std::size_t read( std::size_t address, std::byte *data, std::size_t size ) override;
+
+	void erase( std::size_t address, std::size_t size ) override;
+
+	bool can_map_read() const override {
+		return true;
+	}
+
+	const std::byte* map_read( std::size_t address, std::size_t size ) override;
+
+	void set_sync_interval( std::size_t interval ) {
+		sync_interval = interval;
+	}
+
+	/**
+	 * simulate a device with banks of this size, that can be written in parallel.
+	 * Set it before the filesystem is created.
+	 */
+	void set_bank_size( std::size_t bank_size_ ) {
+		bank_size = bank_size_;
+	}
+
+	std::size_t get_bank_size() const override {
+		return bank_size;
+	}
+
+	bool is_read_only() const {
+		return access == Access::ReadOnly;
+	}
+
+	/**
+	 * writes all changes to the file
+	 */
+	bool sync();
+
+private:
+	void map();
+
+	bool in_range( std::size_t address, std::size_t size ) const {
+		return address <= file_size && size <= file_size - address;
+	}
+
+	bool can_write( std::size_t address, std::size_t size ) const;
+
+	void changed();
+};
+
+} // namespace SimPc
+} // namespace SimpleFlashFs
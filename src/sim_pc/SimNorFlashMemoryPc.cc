@@ -0,0 +1,156 @@
+/**
+ * @author Copyright (c) 2026 Martin Oberzalek
+ */
+#include "SimNorFlashMemoryPc.h"
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+#include <mutex>
+#include <CpputilsDebug.h>
+#include <format.h>
+
+using namespace Tools;
+using namespace SimpleFlashFs::SimPc;
+
+SimNorFlashMemory::SimNorFlashMemory( std::size_t size_, bool do_mem_mapping_ )
+: mem( size_, std::byte(0xFF) ),
+  do_mem_mapping( do_mem_mapping_ )
+{
+}
+
+void SimNorFlashMemory::program( std::size_t address, const std::byte *data, std::size_t size )
+{
+	std::size_t violations = 0;
+
+	for( std::size_t i = 0; i < size; i++ ) {
+		std::byte & b = mem[address + i];
+
+		if( (data[i] & ~b) != std::byte(0) ) {
+			violations++;
+		}
+
+		b &= data[i];
+	}
+
+	if( violations ) {
+		CPPDEBUG( Tools::format( "%d bytes at address %d are not erased", violations, address ) );
+		program_violations += violations;
+	}
+}
+
+std::size_t SimNorFlashMemory::write( std::size_t address, const std::byte *data, std::size_t size )
+{
+	if( !in_range( address, size ) ) {
+		CPPDEBUG( Tools::format( "address + size %d + %d is out of range", address, size ) );
+		return 0;
+	}
+
+	std::unique_lock<std::shared_mutex> lock( m_mutex );
+	program( address, data, size );
+	return size;
+}
+
+std::size_t SimNorFlashMemory::read( std::size_t address, std::byte *data, std::size_t size )
+{
+	if( !in_range( address, size ) ) {
+		CPPDEBUG( Tools::format( "address + size %d + %d is out of range", address, size ) );
+		return 0;
+	}
+
+	std::shared_lock<std::shared_mutex> lock( m_mutex );
+	std::memcpy( data, mem.data() + address, size );
+	return size;
+}
+
+void SimNorFlashMemory::erase( std::size_t address, std::size_t size )
+{
+	if( !in_range( address, size ) ) {
+		CPPDEBUG( Tools::format( "address + size %d + %d is out of range", address, size ) );
+		return;
+	}
+
+	std::unique_lock<std::shared_mutex> lock( m_mutex );
+	std::memset( mem.data() + address, 0xFF, size );
+}
+
+std::size_t SimNorFlashMemory::write_v( std::span<const WriteVec> vec )
+{
+	std::unique_lock<std::shared_mutex> lock( m_mutex );
+
+	std::size_t ret = 0;
+
+	for( const auto & v : vec ) {
+		if( !in_range( v.address, v.size ) ) {
+			break;
+		}
+
+		program( v.address, v.data, v.size );
+		ret += v.size;
+	}
+
+	return ret;
+}
+
+std::size_t SimNorFlashMemory::read_v( std::span<const ReadVec> vec )
+{
+	std::shared_lock<std::shared_mutex> lock( m_mutex );
+
+	std::size_t ret = 0;
+
+	for( const auto & v : vec ) {
+		if( !in_range( v.address, v.size ) ) {
+			break;
+		}
+
+		std::memcpy( v.data, mem.data() + v.address, v.size );
+		ret += v.size;
+	}
+
+	return ret;
+}
+
+const std::byte* SimNorFlashMemory::map_read( std::size_t address, std::size_t size )
+{
+	if( !do_mem_mapping || !in_range( address, size ) ) {
+		return nullptr;
+	}
+
+	return mem.data() + address;
+}
+
+bool SimNorFlashMemory::snapshot( const std::string & filename ) const
+{
+	std::ofstream out( filename, std::ios_base::trunc | std::ios_base::binary );
+
+	if( !out ) {
+		CPPDEBUG( Tools::format( "cannot open file '%s'", filename ) );
+		return false;
+	}
+
+	std::shared_lock<std::shared_mutex> lock( m_mutex );
+	out.write( reinterpret_cast<const char*>( mem.data() ), mem.size() );
+
+	return static_cast<bool>( out );
+}
+
+bool SimNorFlashMemory::load( const std::string & filename )
+{
+	std::error_code ec;
+
+	if( std::filesystem::file_size( filename, ec ) != mem.size() || ec ) {
+		CPPDEBUG( Tools::format( "file '%s' does not have the size %d", filename, mem.size() ) );
+		return false;
+	}
+
+	std::ifstream in( filename, std::ios_base::binary );
+
+	if( !in ) {
+		CPPDEBUG( Tools::format( "cannot open file '%s'", filename ) );
+		return false;
+	}
+
+	std::unique_lock<std::shared_mutex> lock( m_mutex );
+	in.read( reinterpret_cast<char*>( mem.data() ), mem.size() );
+
+	return static_cast<bool>( in );
+}
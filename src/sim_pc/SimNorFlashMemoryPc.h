@@ -0,0 +1,84 @@
+/**
+ * RAM only flash memory with the semantics of a NOR flash.
+ *
+ * Programming can only clear bits, so a write stores
+ * the old content AND the new data. Erasing sets all bytes to 0xFF.
+ * Nothing is written to disk, unless snapshot() is called, so
+ * benchmarks measure the filesystem and not the disk.
+ *
+ * @author Copyright (c) 2026 Martin Oberzalek
+ */
+#pragma once
+
+#include "../SimpleFlashFsFlashMemoryInterface.h"
+
+#include <atomic>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+namespace SimpleFlashFs {
+namespace SimPc {
+
+class SimNorFlashMemory : public FlashMemoryInterface
+{
+	std::vector<std::byte> mem;
+	bool do_mem_mapping;
+
+	// writes are exclusive, reads can run in parallel
+	mutable std::shared_mutex m_mutex;
+
+	// number of bytes, where a write tried to set a cleared bit
+	std::atomic<std::size_t> program_violations = 0;
+
+public:
+	// erased memory, all bytes are 0xFF
+	SimNorFlashMemory( std::size_t size, bool do_mem_mapping = false );
+
+	std::size_t size() const override {
+		return mem.size();
+	}
+
+	std::size_t write( std::size_t address, const std::byte *data, std::size_t size ) override;
+	std::size_t read( std::size_t address, std::byte *data, std::size_t size ) override;
+
+	void erase( std::size_t address, std::size_t size ) override;
+
+	// one lock for all pages
+	std::size_t write_v( std::span<const WriteVec> vec ) override;
+	std::size_t read_v( std::span<const ReadVec> vec ) override;
+
+	bool can_map_read() const override {
+		return do_mem_mapping;
+	}
+
+	const std::byte* map_read( std::size_t address, std::size_t size ) override;
+
+	/**
+	 * writes the whole memory into a file
+	 */
+	bool snapshot( const std::string & filename ) const;
+
+	/**
+	 * reads the memory from a file. The file has to have the size of the memory.
+	 */
+	bool load( const std::string & filename );
+
+	/**
+	 * number of bytes written, that tried to set a bit from 0 to 1.
+	 * The filesystem should always erase a page before writing it.
+	 */
+	std::size_t get_program_violations() const {
+		return program_violations;
+	}
+
+private:
+	bool in_range( std::size_t address, std::size_t size ) const {
+		return address <= mem.size() && size <= mem.size() - address;
+	}
+
+	void program( std::size_t address, const std::byte *data, std::size_t size );
+};
+
+} // namespace SimPc
+} // namespace SimpleFlashFs
@@ -43,6 +43,15 @@ public:
 
 	void erase( std::size_t address, std::size_t size ) override;
 
+	// has to go through write() and read() of this class, not directly to the file
+	std::size_t write_v( std::span<const WriteVec> vec ) override {
+		return FlashMemoryInterface::write_v( vec );
+	}
+
+	std::size_t read_v( std::span<const ReadVec> vec ) override {
+		return FlashMemoryInterface::read_v( vec );
+	}
+
 
 	/**
 	 * returns true if the flash memory is mapped into the address space,
@@ -13,7 +13,13 @@
 
 namespace SimpleFlashFs::static_memory {
 
-    template <size_t SFF_FILE_NAME_MAX, size_t SFF_PAGE_SIZE, size_t SFF_MAX_PAGES, size_t SFF_MAX_SIZE>
+    /**
+     * SFF_NAME_INDEX_SIZE: number of slots of the in RAM file name index.
+     *                      Each slot takes 16 bytes. 0 disables the index.
+     *                      Not more than 3/4 of the slots can be used, if there are
+     *                      more files, the fs falls back to scanning all inodes.
+     */
+    template <size_t SFF_FILE_NAME_MAX, size_t SFF_PAGE_SIZE, size_t SFF_MAX_PAGES, size_t SFF_MAX_SIZE, size_t SFF_NAME_INDEX_SIZE = SFF_MAX_PAGES>
     struct Config
     {
       using magic_string_type = Tools::static_string<MAGICK_STRING_LEN>;
@@ -27,6 +33,34 @@ namespace SimpleFlashFs::static_memory {
 
       template<class T> class vector_type : public Tools::static_vector<T,SFF_MAX_PAGES> {};
 
+      constexpr static bool USE_NAME_INDEX = SFF_NAME_INDEX_SIZE > 0;
+      constexpr static size_t NAME_INDEX_SIZE = USE_NAME_INDEX ? SFF_NAME_INDEX_SIZE : 1;
+
+      template<class T> class name_index_vector_type : public Tools::static_vector<T,NAME_INDEX_SIZE> {};
+
+      // read only snapshots, see SimpleFlashFsBase::open_snapshot()
+      // There is only one thread, so there is no writer to pin pages against.
+      constexpr static bool USE_SNAPSHOTS = false;
+
+      template<class T> class snapshot_vector_type : public Tools::static_vector<T,1> {};
+
+      // page tables of large files, see Header::VERSION_PAGE_TABLES
+      // Disabled, each file handle would need three lists of SFF_MAX_PAGES entries.
+      // A filesystem with page tables cannot be mounted.
+      constexpr static bool USE_PAGE_TABLES = false;
+
+      template<class T> class page_table_vector_type : public Tools::static_vector<T,1> {};
+
+      // see FileHandle::set_tail_buffer()
+      // Disabled, the buffer would take one page in each file handle.
+      constexpr static bool USE_TAIL_BUFFER = false;
+
+      using tail_page_type = Tools::static_vector<std::byte,1>;
+
+      // banks of the memory, that are locked separately. See FlashMemoryInterface::get_bank_size()
+      // One thread, so there is nothing to run in parallel.
+      constexpr static size_t MAX_BANKS = 1;
+
       static uint32_t crc32( const std::byte *bytes, size_t len );
 
       // AI generated by GitHub Copilot Claude Opus 4.7 START
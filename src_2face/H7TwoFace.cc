@@ -7,6 +7,7 @@
 #include "H7TwoFace.h"
 #include "H7TwoFaceConfig.h"
 #include "SimpleFlashFs2FlashPages.h"
+#include "../src/crc/SimpleFlashFsCrc32.h"
 #include <CpputilsDebug.h>
 #include <static_debug_exception.h>
 
@@ -145,7 +146,8 @@ static std::optional<SimpleFlashFs::FlashMemoryInterface*> fs_mem1;
 static std::optional<SimpleFlashFs::FlashMemoryInterface*> fs_mem2;
 static std::optional<H7TwoFaceImpl> fs_impl;
 static std::function<uint32_t(const std::byte* data, size_t len)> fs_crc32_func = [](const std::byte* data, size_t len) {
-	return crcFast( reinterpret_cast<unsigned char const*>(data), len );
+	// slicing-by-8 needs 8kB less table space in flash than slicing-by-16
+	return SimpleFlashFs::Crc32::crc32_slicing<8>( data, len );
 };
 
 class AutoFreeFs
@@ -15,10 +15,15 @@ static constexpr const std::size_t SFF_MAX_SIZE = 128*1024;
 
 // SFF_MAX_SIZE / SFF_PAGE_SIZE is the maximum file size that fits on a H7internal flash page
 // so 128*1024/512 = 256 is a good value.
-// sizeof(FileHandle) ~ SFF_MAX_PAGES * uint32_t(4) + SFF_FILE_NAME_MAX + SFF_PAGE_SIZE
+// sizeof(FileHandle) ~ SFF_MAX_PAGES * sizeof(data_page_t) + SFF_FILE_NAME_MAX + SFF_PAGE_SIZE
+// (the page table lists are disabled for the static config)
 static constexpr const std::size_t SFF_MAX_PAGES = 256;
 
-struct ConfigH7 : public SimpleFlashFs::static_memory::Config<SFF_FILE_NAME_MAX,SFF_PAGE_SIZE,SFF_MAX_PAGES,SFF_MAX_SIZE>
+// the fs is formatted with SFF_MAX_SIZE / SFF_PAGE_SIZE / 10 * 2 = 50 inodes.
+// Only 3/4 of the name index slots are used, so 128 slots (2 kb) are more than enough.
+static constexpr const std::size_t SFF_NAME_INDEX_SIZE = 128;
+
+struct ConfigH7 : public SimpleFlashFs::static_memory::Config<SFF_FILE_NAME_MAX,SFF_PAGE_SIZE,SFF_MAX_PAGES,SFF_MAX_SIZE,SFF_NAME_INDEX_SIZE>
 {
   static uint32_t crc32(const std::byte* bytes, size_t len);
 };
@@ -8,7 +8,6 @@
 #pragma once
 
 #include "../src/static/SimpleFlashFsStatic.h"
-#include "../src/crc/crc.h"
 #include <CpputilsDebug.h>
 
 namespace SimpleFlashFs::static_memory {
@@ -38,7 +37,6 @@ public:
 	: base_t(mem_interface_),
 	  do_debug( do_debug_ )
 	{
-		crcInit();
 	}
 
 	bool create()
@@ -67,7 +65,11 @@ public:
 protected:
 	void read_all_free_data_pages();
 
-	virtual void erase_inode_and_unused_pages( base_t::file_handle_t & inode_to_erase, base_t::file_handle_t & next_inode_version ) override {
+	virtual void erase_inode_and_unused_pages( base_t::file_handle_t & /*inode_to_erase*/, base_t::file_handle_t & /*next_inode_version*/ ) override {
+		// do nothing
+	}
+
+	virtual void erase_pages( base::PageSet<Config> & /*pages_to_erase*/ ) override {
 		// do nothing
 	}
 
@@ -164,12 +166,8 @@ void SimpleFsNoDel<Config>::read_all_free_data_pages()
 	base_t::free_data_pages.clear();
 	stat = {};
 
-	for( unsigned i = base_t::header.max_inodes; 
-		i < base_t::header.filesystem_size - 1; // -1 ... one page for the header itself
-		i++ ) {
-
-		base_t::free_data_pages.unordered_insert(i);
-	}
+	// -1 ... one page for the header itself
+	base_t::free_data_pages.insert( base_t::header.max_inodes, static_cast<uint32_t>( base_t::header.filesystem_size - 1 ) );
 
 	this->iv_storage.clear();
 
@@ -183,6 +181,8 @@ void SimpleFsNoDel<Config>::read_all_free_data_pages()
 				CPPDEBUG( Tools::static_format<100>( "read error at page: %d", i ) );
 			}
 			base_t::free_data_pages.erase(i);
+			// never allocate this inode page
+			base_t::used_inode_pages.set(i);
 			continue;
 		}
 
@@ -197,6 +197,7 @@ void SimpleFsNoDel<Config>::read_all_free_data_pages()
 		}
 
 		inode.page = i;
+		base_t::used_inode_pages.set(i);
 		base_t::max_inode_number = std::max( base_t::max_inode_number, inode.inode.inode_number );
 
 		if( do_debug ) {
@@ -218,6 +219,32 @@ void SimpleFsNoDel<Config>::read_all_free_data_pages()
 			stat.trash_size += base_t::header.page_size;
 			base_t::free_data_pages.erase(page.page_id);
 		}
+
+		for( auto page : inode.inode.indirect_pages ) {
+			stat.trash_size += base_t::header.page_size;
+			base_t::free_data_pages.erase(page);
+		}
+
+		for( auto page : inode.inode.double_indirect_pages ) {
+			stat.trash_size += base_t::header.page_size;
+			base_t::free_data_pages.erase(page);
+		}
+	}
+
+	this->set_used_inode_pages_valid();
+
+	// iv_storage contains the latest version of each inode
+	if constexpr( Config::USE_NAME_INDEX ) {
+		this->name_index.reset( this->iv_storage.get_data().size() );
+
+		for( const auto & iv : this->iv_storage.get_data() ) {
+			auto inode = read_inode( iv.page );
+
+			if( inode && inode->valid() ) {
+				inode->page = iv.page;
+				this->name_index_insert( *inode );
+			}
+		}
 	}
 
 	// CPPDEBUG( Tools::format( "max_inodes: %d", base_t::header.max_inodes ) );
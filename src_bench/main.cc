@@ -0,0 +1,545 @@
+/**
+ * Benchmarks of the core filesystem operations
+ *
+ * Measures open, read, write (aligned, unaligned, append), flush, rename_file,
+ * delete_file, truncate and init of the dynamic and of a static implementation
+ * on different devices, page sizes and fill levels.
+ *
+ * One CSV line is printed per measurement:
+ *   fs,device,page_size,fill,operation,iterations,seconds,ops_per_s,bytes_per_s,
+ *   reads_per_op,writes_per_op,erases_per_op,map_reads_per_op,device_us_per_op
+ *
+ * The device operations are counted with InstrumentedFlashMemory.
+ * With --profile the device is wrapped into a TimedFlashMemory and
+ * device_us_per_op is the simulated time of the device.
+ *
+ * g++ -std=c++20 -O2 -I src -I <tools> src_bench/main.cc src/dynamic/SimpleFlashFsDynamic.cc \
+ *     src/SimpleFlashFsTimedFlashMemory.cc src/sim_pc/SimNorFlashMemoryPc.cc src/sim_pc/SimMmapFlashMemoryPc.cc \
+ *     src/SimpleFlashFsConstants.cc src/SimpleFlashFsInstrumentedFlashMemory.cc \
+ *     src/sim_pc/SimFlashMemoryPc.cc src/sim_pc/SimSTM32InternalFlashPc.cc <tools libs> -o sff_bench
+ *
+ * ./sff_bench > bench_output.txt
+ *
+ * @author Copyright (c) 2026 Martin Oberzalek
+ */
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../src/dynamic/SimpleFlashFsDynamic.h"
+#include "../src/static/SimpleFlashFsStatic.h"
+#include "../src/static/SimpleFlashFsStaticConfig.h"
+#include "../src/crc/SimpleFlashFsCrc32.h"
+#include "../src/SimpleFlashFsInstrumentedFlashMemory.h"
+#include "../src/SimpleFlashFsTimedFlashMemory.h"
+#include "../src/sim_pc/SimFlashMemoryPc.h"
+#include "../src/sim_pc/SimSTM32InternalFlashPc.h"
+#include "../src/sim_pc/SimNorFlashMemoryPc.h"
+#include "../src/sim_pc/SimMmapFlashMemoryPc.h"
+#include "../src_2face/SimpleFlashFsNoDel.h"
+
+using namespace SimpleFlashFs;
+
+namespace {
+
+template<std::size_t PAGE_SIZE, std::size_t PAGES>
+struct StaticConfig : public static_memory::Config<64,PAGE_SIZE,PAGES,PAGE_SIZE * PAGES>
+{
+	static uint32_t crc32( const std::byte *bytes, size_t len ) {
+		return Crc32::crc32( bytes, len );
+	}
+};
+
+struct Params
+{
+	std::size_t pages = 512;
+	std::size_t iterations = 200;
+	std::vector<std::size_t> page_sizes { 256, 512 };
+	std::vector<unsigned> fill_levels { 0, 50, 90 }; // percent of the data pages
+	std::vector<std::string> devices { "ram", "ram_mapped", "file", "mmap", "stm32" };
+	std::vector<std::string> filesystems { "dynamic", "static" };
+	std::string profile; // TimedFlashMemory profile, empty = none
+};
+
+struct Device
+{
+	InstrumentedFlashMemory & mem;
+	TimedFlashMemory *timed = nullptr;
+};
+
+struct Result
+{
+	std::size_t iterations = 0;
+	std::size_t bytes = 0;
+	std::chrono::steady_clock::duration duration {};
+	uint64_t reads = 0;
+	uint64_t writes = 0;
+	uint64_t erases = 0;
+	uint64_t map_reads = 0;
+	uint64_t device_ns = 0;
+
+	void add( const InstrumentedFlashMemory::Snapshot & a, const InstrumentedFlashMemory::Snapshot & b ) {
+		reads += b.read.count - a.read.count;
+		writes += b.write.count - a.write.count;
+		erases += b.erase.count - a.erase.count;
+		map_reads += b.map_read.count - a.map_read.count;
+	}
+};
+
+/**
+ * measures f(), the device operations are only counted while f() runs
+ * returns the result of f()
+ */
+template<class F> bool measure( Result & result, Device & dev, std::size_t bytes, F f )
+{
+	const auto before = dev.mem.snapshot();
+	const uint64_t device_ns = dev.timed ? dev.timed->get_elapsed_ns() : 0;
+	const auto start = std::chrono::steady_clock::now();
+
+	const bool ok = f();
+
+	result.duration += std::chrono::steady_clock::now() - start;
+	result.add( before, dev.mem.snapshot() );
+
+	if( dev.timed ) {
+		result.device_ns += dev.timed->get_elapsed_ns() - device_ns;
+	}
+
+	result.iterations++;
+	result.bytes += bytes;
+
+	return ok;
+}
+
+std::vector<std::byte> pattern( std::size_t size, unsigned seed )
+{
+	std::vector<std::byte> data( size );
+
+	for( std::size_t i = 0; i < size; i++ ) {
+		data[i] = static_cast<std::byte>( ( i * 131 + seed ) & 0xFF );
+	}
+
+	return data;
+}
+
+void print_header()
+{
+	std::cout << "fs,device,page_size,fill,operation,iterations,seconds,ops_per_s,bytes_per_s,"
+			  << "reads_per_op,writes_per_op,erases_per_op,map_reads_per_op,device_us_per_op\n";
+}
+
+void print( const std::string_view & fs, const std::string_view & device, std::size_t page_size,
+		unsigned fill, const std::string_view & operation, const Result & r )
+{
+	if( r.iterations == 0 ) {
+		return;
+	}
+
+	const double seconds = std::chrono::duration<double>( r.duration ).count();
+	const double n = static_cast<double>( r.iterations );
+
+	std::cout << fs << ',' << device << ',' << page_size << ',' << fill << ',' << operation << ','
+			  << r.iterations << ',' << seconds << ','
+			  << ( seconds > 0 ? n / seconds : 0 ) << ','
+			  << ( seconds > 0 ? r.bytes / seconds : 0 ) << ','
+			  << r.reads / n << ','
+			  << r.writes / n << ','
+			  << r.erases / n << ','
+			  << r.map_reads / n << ','
+			  << r.device_ns / n / 1000 << '\n';
+}
+
+/**
+ * runs all operations on one filesystem type
+ * mkfs( mem ) returns a new, not initialized filesystem
+ */
+template<class MkFs>
+bool run( const Params & params, const std::string_view & fs_name, const std::string_view & device_name,
+		std::size_t page_size, unsigned fill, Device & dev, MkFs mkfs )
+{
+	auto & mem = dev.mem;
+
+	// working set
+	const std::size_t FILES = 8;
+	const auto data = pattern( page_size * 4, 2 );
+	const auto small = pattern( 64, 3 );
+	const auto unaligned = pattern( page_size * 2 + 17, 4 );
+	const auto filler = pattern( page_size * 8, 1 );
+
+	decltype( mkfs( &mem ) ) fs;
+
+	// creates the filesystem, fills it with files of 8 pages
+	// until the fill level is reached and writes the working set
+	auto format = [&]() {
+		fs = mkfs( &mem );
+
+		bool created = false;
+
+		if constexpr( requires { fs->create(); } ) {
+			// static: the size comes from the Config
+			created = fs->create();
+		} else {
+			created = fs->create( fs->create_default_header( page_size, params.pages ) );
+		}
+
+		if( !created ) {
+			std::cerr << fs_name << ": cannot create the filesystem\n";
+			return false;
+		}
+
+		fs = mkfs( &mem );
+
+		if( !fs->init() ) {
+			std::cerr << fs_name << ": init failed\n";
+			return false;
+		}
+
+		const std::size_t data_pages = fs->get_number_of_free_data_pages();
+
+		for( unsigned i = 0; data_pages - fs->get_number_of_free_data_pages() < data_pages * fill / 100; i++ ) {
+			auto file = fs->open( "fill" + std::to_string(i), std::ios_base::out | std::ios_base::trunc );
+
+			if( !file || file.write( filler.data(), filler.size() ) != filler.size() ) {
+				break;
+			}
+		}
+
+		for( std::size_t i = 0; i < FILES; i++ ) {
+			auto file = fs->open( "file" + std::to_string(i), std::ios_base::out | std::ios_base::trunc );
+
+			if( !file || file.write( data.data(), data.size() ) != data.size() ) {
+				std::cerr << fs_name << ": cannot create the working set\n";
+				return false;
+			}
+		}
+
+		return true;
+	};
+
+	// The static implementation never reuses a page, it is formatted
+	// again, before one iteration could run out of inodes or pages.
+	// The dynamic one keeps the inode page of a deleted file until
+	// the next mount, so it is mounted again.
+	auto exhausted = [&]() {
+		if constexpr( requires { fs->get_stat().free_inodes; } ) {
+			fs = mkfs( &mem );
+			fs->init();
+
+			return fs->get_stat().free_inodes < 12 || fs->get_number_of_free_data_pages() < 24;
+		} else {
+			if( fs->get_number_of_free_inode_pages() < 12 ) {
+				fs = mkfs( &mem );
+				fs->init();
+			}
+
+			return fs->get_number_of_free_inode_pages() < 12 || fs->get_number_of_free_data_pages() < 24;
+		}
+	};
+
+	if( !format() ) {
+		return false;
+	}
+
+	if( exhausted() ) {
+		std::cerr << fs_name << ": fill level " << fill << " leaves no space for the benchmark\n";
+		return true;
+	}
+
+	Result r_init, r_open, r_read, r_write_aligned, r_write_unaligned, r_append, r_flush, r_rename, r_delete, r_truncate;
+	std::vector<std::byte> buffer( data.size() );
+
+	for( std::size_t it = 0; it < params.iterations; it++ ) {
+		const std::string name = "file" + std::to_string( it % FILES );
+
+		// the timings of failed operations are not comparable
+		auto failed = [&]( const std::string_view & operation ) {
+			std::cerr << fs_name << ": " << operation << " failed in iteration " << it << '\n';
+			return false;
+		};
+
+		if( exhausted() && !format() ) {
+			return false;
+		}
+
+		if( !measure( r_open, dev, 0, [&]() {
+				return !!fs->open( name, std::ios_base::in );
+			} ) ) {
+			return failed( "open" );
+		}
+
+		{
+			auto file = fs->open( name, std::ios_base::in );
+
+			if( !file || !measure( r_read, dev, buffer.size(), [&]() {
+					return file.read( buffer.data(), buffer.size() ) == buffer.size();
+				} ) ) {
+				return failed( "read" );
+			}
+		}
+
+		{
+			auto file = fs->open( name, std::ios_base::in | std::ios_base::out );
+
+			if( !file || !measure( r_write_aligned, dev, data.size(), [&]() {
+					return file.seek( 0 ) && file.write( data.data(), data.size() ) == data.size();
+				} ) ) {
+				return failed( "write_aligned" );
+			}
+
+			if( !measure( r_flush, dev, 0, [&]() {
+					return file.flush();
+				} ) ) {
+				return failed( "flush" );
+			}
+		}
+
+		{
+			auto file = fs->open( name, std::ios_base::in | std::ios_base::out );
+
+			if( !file || !measure( r_write_unaligned, dev, unaligned.size(), [&]() {
+					return file.seek( page_size / 3 ) && file.write( unaligned.data(), unaligned.size() ) == unaligned.size();
+				} ) ) {
+				return failed( "write_unaligned" );
+			}
+
+			if( !file.flush() ) {
+				return failed( "flush" );
+			}
+		}
+
+		{
+			auto file = fs->open( name, std::ios_base::in | std::ios_base::out | std::ios_base::app );
+
+			if( !file || !measure( r_append, dev, small.size(), [&]() {
+					return file.write( small.data(), small.size() ) == small.size() && file.flush();
+				} ) ) {
+				return failed( "append" );
+			}
+		}
+
+		{
+			auto file = fs->open( name, std::ios_base::in | std::ios_base::out );
+
+			if( !file || !measure( r_truncate, dev, 0, [&]() {
+					return file.truncate( data.size() ) && file.flush();
+				} ) ) {
+				return failed( "truncate" );
+			}
+		}
+
+		{
+			auto file = fs->open( name, std::ios_base::in | std::ios_base::out );
+
+			if( !file || !measure( r_rename, dev, 0, [&]() {
+					return file.rename_file( "renamed" );
+				} ) ) {
+				return failed( "rename_file" );
+			}
+
+			if( !file.rename_file( name ) ) {
+				return failed( "rename_file" );
+			}
+		}
+
+		{
+			auto file = fs->open( "tmp", std::ios_base::out | std::ios_base::trunc );
+
+			if( !file || file.write( small.data(), small.size() ) != small.size() || !file.flush() ) {
+				return failed( "create" );
+			}
+
+			if( !measure( r_delete, dev, 0, [&]() {
+					return file.delete_file();
+				} ) ) {
+				return failed( "delete_file" );
+			}
+		}
+
+		if( it % 10 == 0 ) {
+			if( !measure( r_init, dev, 0, [&]() {
+					auto fs2 = mkfs( &mem );
+					return fs2->init();
+				} ) ) {
+				return failed( "init" );
+			}
+		}
+	}
+
+	print( fs_name, device_name, page_size, fill, "init", r_init );
+	print( fs_name, device_name, page_size, fill, "open", r_open );
+	print( fs_name, device_name, page_size, fill, "read", r_read );
+	print( fs_name, device_name, page_size, fill, "write_aligned", r_write_aligned );
+	print( fs_name, device_name, page_size, fill, "write_unaligned", r_write_unaligned );
+	print( fs_name, device_name, page_size, fill, "append", r_append );
+	print( fs_name, device_name, page_size, fill, "flush", r_flush );
+	print( fs_name, device_name, page_size, fill, "rename_file", r_rename );
+	print( fs_name, device_name, page_size, fill, "delete_file", r_delete );
+	print( fs_name, device_name, page_size, fill, "truncate", r_truncate );
+
+	return true;
+}
+
+std::unique_ptr<FlashMemoryInterface> create_device( const std::string & device, std::size_t page_size, std::size_t size )
+{
+	const auto file = std::filesystem::temp_directory_path() / ( "sff_bench_" + device );
+	std::filesystem::remove( file );
+
+	if( device == "ram" ) {
+		return std::make_unique<SimPc::SimNorFlashMemory>( size );
+	} else if( device == "ram_mapped" ) {
+		return std::make_unique<SimPc::SimNorFlashMemory>( size, true );
+	} else if( device == "file" ) {
+		return std::make_unique<SimPc::SimFlashFsFlashMemory>( file.string(), size );
+	} else if( device == "mmap" ) {
+		return std::make_unique<SimPc::SimMmapFlashMemory>( file.string(), size );
+	} else if( device == "stm32" ) {
+		return std::make_unique<SimPc::SimSTM32InternalFlashPc>( file.string(), page_size, size );
+	}
+
+	return {};
+}
+
+template<std::size_t PAGE_SIZE>
+bool run_static( const Params & params, const std::string & device_name, unsigned fill, Device & dev )
+{
+	using Config = StaticConfig<PAGE_SIZE,512>;
+
+	return run( params, "static", device_name, PAGE_SIZE, fill, dev, []( FlashMemoryInterface *m ) {
+		return std::make_unique<static_memory::SimpleFsNoDel<Config>>( m );
+	} );
+}
+
+std::vector<std::string> split( const std::string_view & s )
+{
+	std::vector<std::string> ret;
+	std::size_t start = 0;
+
+	while( start <= s.size() ) {
+		std::size_t end = s.find( ',', start );
+
+		if( end == std::string_view::npos ) {
+			end = s.size();
+		}
+
+		ret.emplace_back( s.substr( start, end - start ) );
+		start = end + 1;
+	}
+
+	return ret;
+}
+
+template<class T> std::vector<T> split_numbers( const std::string_view & s )
+{
+	std::vector<T> ret;
+
+	for( const auto & v : split( s ) ) {
+		ret.push_back( static_cast<T>( std::stoul( v ) ) );
+	}
+
+	return ret;
+}
+
+void usage( const char *prog )
+{
+	std::cerr << "usage: " << prog << " [options]\n"
+			  << "  --page-sizes 256,512   static supports 256 and 512 only\n"
+			  << "  --fill 0,50,90         fill level in percent of the data pages\n"
+			  << "  --devices ram,ram_mapped,file,mmap,stm32\n"
+			  << "  --fs dynamic,static\n"
+			  << "  --pages 512            size of the filesystem in pages, static uses 512\n"
+			  << "  --iterations 200\n"
+			  << "  --profile at45db321e   simulated device time: fm25w256, at45db321e or stm32h7\n";
+}
+
+} // namespace
+
+int main( int argc, char **argv )
+{
+	Params params;
+
+	for( int i = 1; i < argc; i++ ) {
+		const std::string_view arg = argv[i];
+
+		if( i + 1 >= argc ) {
+			usage( argv[0] );
+			return 1;
+		}
+
+		const std::string_view value = argv[++i];
+
+		if( arg == "--page-sizes" ) {
+			params.page_sizes = split_numbers<std::size_t>( value );
+		} else if( arg == "--fill" ) {
+			params.fill_levels = split_numbers<unsigned>( value );
+		} else if( arg == "--devices" ) {
+			params.devices = split( value );
+		} else if( arg == "--fs" ) {
+			params.filesystems = split( value );
+		} else if( arg == "--pages" ) {
+			params.pages = std::stoul( std::string( value ) );
+		} else if( arg == "--profile" ) {
+			params.profile = value;
+
+			if( !TimedFlashMemory::Profile::find( params.profile ) ) {
+				std::cerr << "unknown profile " << params.profile << '\n';
+				return 1;
+			}
+		} else if( arg == "--iterations" ) {
+			params.iterations = std::stoul( std::string( value ) );
+		} else {
+			usage( argv[0] );
+			return 1;
+		}
+	}
+
+	print_header();
+
+	for( const auto & fs_name : params.filesystems ) {
+		for( const auto & device_name : params.devices ) {
+			for( std::size_t page_size : params.page_sizes ) {
+				for( unsigned fill : params.fill_levels ) {
+
+					auto device = create_device( device_name, page_size, page_size * params.pages );
+
+					if( !device ) {
+						std::cerr << "unknown device " << device_name << '\n';
+						return 1;
+					}
+
+					std::optional<TimedFlashMemory> timed;
+
+					if( !params.profile.empty() ) {
+						timed.emplace( device.get(), *TimedFlashMemory::Profile::find( params.profile ) );
+					}
+
+					InstrumentedFlashMemory mem( timed ? static_cast<FlashMemoryInterface*>( &*timed ) : device.get() );
+					Device dev { mem, timed ? &*timed : nullptr };
+					bool ok = true;
+
+					if( fs_name == "dynamic" ) {
+						ok = run( params, fs_name, device_name, page_size, fill, dev, []( FlashMemoryInterface *m ) {
+							return std::make_unique<dynamic::SimpleFlashFs>( m );
+						} );
+					} else if( fs_name == "static" && page_size == 256 ) {
+						ok = run_static<256>( params, device_name, fill, dev );
+					} else if( fs_name == "static" && page_size == 512 ) {
+						ok = run_static<512>( params, device_name, fill, dev );
+					} else if( fs_name != "static" ) {
+						std::cerr << "unknown filesystem " << fs_name << '\n';
+						return 1;
+					}
+
+					if( !ok ) {
+						return 1;
+					}
+				}
+			}
+		}
+	}
+
+	return 0;
+}
@@ -25,6 +25,10 @@ public:
 	virtual void erase_inode_and_unused_pages( base_t::file_handle_t & inode_to_erase, base_t::file_handle_t & next_inode_version ) override {
 		// do nothing
 	}
+
+	virtual void erase_pages( base::PageSet<base_t::config_t> & pages_to_erase ) override {
+		// do nothing
+	}
 };
 
 
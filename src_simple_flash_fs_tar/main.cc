@@ -17,7 +17,8 @@
 #include <filesystem>
 #include <optional>
 #include <set>
-#include "../src/sim_pc/SimFlashMemoryPc.h"
+#include "../src/sim_pc/SimMmapFlashMemoryPc.h"
+#include "../src/SimpleFlashFsInstrumentedFlashMemory.h"
 #include "SimpleFlashFsDynamicReadOnly.h"
 
 using namespace Tools;
@@ -344,7 +345,7 @@ int main( int argc, char **argv )
 			const std::size_t size = 100*1024;
 
 			std::string file = o_create.getValues()->at(0);
-			SimFlashFsFlashMemory mem(file,size);
+			SimMmapFlashMemory mem(file,size);
 			SimpleFlashFs::dynamic::SimpleFlashFs fs(&mem);
 
 			const std::size_t page_size = 528;
@@ -357,14 +358,19 @@ int main( int argc, char **argv )
 		if( o_fs_info.isSet() ) {
 			std::string file = o_fs_info.getValues()->at(0);
 
-			SimFlashFsFlashMemory mem(file);
+			SimMmapFlashMemory sim_mem(file, SimMmapFlashMemory::Access::ReadOnly);
+			InstrumentedFlashMemory mem(&sim_mem);
 			SimpleFlashFs::dynamic::SimpleFlashFsReadOnly fs(&mem);
 
 			if( !fs.init() ) {
 				throw STDERR_EXCEPTION( "init failed" );
 			}
 
+			mem.set_page_size( fs.get_header().page_size );
+
 			info_fs( fs );
+
+			std::cout << "Device access:\n" << mem.snapshot().report() << std::endl;
 		}
 
 
@@ -373,7 +379,7 @@ int main( int argc, char **argv )
 
 			std::string file = values->at(0);
 
-			SimFlashFsFlashMemory mem(file);
+			SimMmapFlashMemory mem(file);
 			SimpleFlashFs::dynamic::SimpleFlashFs fs(&mem);
 
 			if( !fs.init() ) {
@@ -390,7 +396,7 @@ int main( int argc, char **argv )
 
 			std::string file = values->at(0);
 
-			SimFlashFsFlashMemory mem(file);
+			SimMmapFlashMemory mem(file);
 			SimpleFlashFs::dynamic::SimpleFlashFs fs(&mem);
 
 			if( !fs.init() ) {
@@ -408,8 +414,8 @@ int main( int argc, char **argv )
 				throw STDERR_EXCEPTION( "missing archive file name");
 			}
 
-			SimFlashFsFlashMemory mem(*archive_file_name);
-			SimpleFlashFs::dynamic::SimpleFlashFs fs(&mem);
+			SimMmapFlashMemory mem(*archive_file_name, SimMmapFlashMemory::Access::ReadOnly);
+			SimpleFlashFs::dynamic::SimpleFlashFsReadOnly fs(&mem);
 
 			if( !fs.init() ) {
 				throw STDERR_EXCEPTION( "init failed" );
@@ -426,8 +432,8 @@ int main( int argc, char **argv )
 				throw STDERR_EXCEPTION( "missing archive file name");
 			}
 
-			SimFlashFsFlashMemory mem(*archive_file_name);
-			SimpleFlashFs::dynamic::SimpleFlashFs fs(&mem);
+			SimMmapFlashMemory mem(*archive_file_name, SimMmapFlashMemory::Access::ReadOnly);
+			SimpleFlashFs::dynamic::SimpleFlashFsReadOnly fs(&mem);
 
 			if( !fs.init() ) {
 				throw STDERR_EXCEPTION( "init failed" );
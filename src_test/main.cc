@@ -0,0 +1,816 @@
+/**
+ * Tests of the dynamic filesystem on a simulated NOR flash
+ *
+ * Each test formats a SimNorFlashMemory, works on it, simulates a power
+ * loss by copying the memory while the filesystem is still running and
+ * mounts the copy again. The NOR flash counts writes to pages, that are
+ * not erased, so a page handed out before its erase is detected.
+ *
+ * The format tests write a file, mount the memory again and compare it.
+ * Then they change the file and cut the power at each write and erase
+ * of the flush, see PowerCutMemory.
+ *
+ * One line is printed per test. The exit code is 1, if a test failed.
+ *
+ * g++ -std=c++23 -O2 -I src -I <tools> src_test/main.cc src/dynamic/SimpleFlashFsDynamic.cc \
+ *     src/sim_pc/SimNorFlashMemoryPc.cc src/SimpleFlashFsConstants.cc \
+ *     src_vfs/FramFsImplDetail.cc src_vfs/SimpleFlashFsVfsServer.cc <tools libs> -o sff_test
+ *
+ * ./sff_test [test...]
+ *
+ * @author Copyright (c) 2026 Martin Oberzalek
+ */
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../src/dynamic/SimpleFlashFsDynamic.h"
+#include "../src/sim_pc/SimNorFlashMemoryPc.h"
+#include "../src_vfs/FramFsImplDetail.h"
+#include "../src_vfs/SimpleFlashFsVfsServer.h"
+
+using namespace SimpleFlashFs;
+
+namespace {
+
+constexpr std::size_t PAGE_SIZE = 256;
+constexpr std::size_t PAGES = 400;
+
+struct Test
+{
+	std::string_view name;
+	std::function<bool()> f;
+};
+
+std::vector<std::byte> pattern( std::size_t size, unsigned seed )
+{
+	std::vector<std::byte> data( size );
+
+	for( std::size_t i = 0; i < size; i++ ) {
+		data[i] = static_cast<std::byte>( ( i * 131 + seed ) & 0xFF );
+	}
+
+	return data;
+}
+
+/**
+ * the content of the memory at the time of a power loss
+ */
+std::unique_ptr<SimPc::SimNorFlashMemory> power_loss( SimPc::SimNorFlashMemory & mem )
+{
+	std::vector<std::byte> data( mem.size() );
+	mem.read( 0, data.data(), data.size() );
+
+	auto image = std::make_unique<SimPc::SimNorFlashMemory>( mem.size() );
+	image->write( 0, data.data(), data.size() );
+
+	return image;
+}
+
+bool format( FlashMemoryInterface & mem, uint16_t version, const dynamic::SimpleFlashFs::CheckpointConfig & checkpoint = {} )
+{
+	dynamic::SimpleFlashFs fs( &mem );
+	fs.set_checkpoint( checkpoint );
+	auto header = fs.create_default_header( PAGE_SIZE, mem.size() / PAGE_SIZE );
+	header.version = version;
+
+	if( !fs.create( header ) ) {
+		std::cerr << "cannot create the filesystem\n";
+		return false;
+	}
+
+	return true;
+}
+
+bool write_file( dynamic::SimpleFlashFs & fs, const std::string & name, const std::vector<std::byte> & data )
+{
+	auto file = fs.open( name, std::ios_base::out | std::ios_base::trunc );
+
+	if( !file ) {
+		std::cerr << "cannot open " << name << " for writing\n";
+		return false;
+	}
+
+	if( file.write( data.data(), data.size() ) != data.size() ) {
+		std::cerr << "cannot write " << name << '\n';
+		return false;
+	}
+
+	if( !file.flush() ) {
+		std::cerr << "cannot flush " << name << '\n';
+		return false;
+	}
+
+	return true;
+}
+
+bool check_file( dynamic::SimpleFlashFs & fs, const std::string & name, const std::vector<std::byte> & expected )
+{
+	auto file = fs.open( name, std::ios_base::in );
+
+	if( !file ) {
+		std::cerr << name << " not found\n";
+		return false;
+	}
+
+	std::vector<std::byte> data( file.file_size() );
+
+	if( file.read( data.data(), data.size() ) != data.size() || data != expected ) {
+		std::cerr << name << " has wrong content\n";
+		return false;
+	}
+
+	return true;
+}
+
+bool check_content( FileInterface & file, const std::string & name, const std::vector<std::byte> & expected )
+{
+	std::vector<std::byte> data( file.file_size() );
+
+	if( !file.seek( 0 ) || file.read( data.data(), data.size() ) != data.size() || data != expected ) {
+		std::cerr << name << " has wrong content\n";
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * overwrites two pages at page idx and appends half a page
+ */
+bool change_file( dynamic::SimpleFlashFs::FileHandle & file, std::vector<std::byte> & data, std::size_t idx )
+{
+	data.resize( file.file_size() );
+
+	if( !file.seek( 0 ) || file.read( data.data(), data.size() ) != data.size() ) {
+		return false;
+	}
+
+	auto update = pattern( PAGE_SIZE * 2, 7 );
+	std::copy( update.begin(), update.end(), data.begin() + idx * PAGE_SIZE );
+
+	if( !file.seek( idx * PAGE_SIZE ) || file.write( update.data(), update.size() ) != update.size() ) {
+		return false;
+	}
+
+	auto tail = pattern( PAGE_SIZE / 2, 8 );
+	data.insert( data.end(), tail.begin(), tail.end() );
+
+	return file.seek( file.file_size() ) && file.write( tail.data(), tail.size() ) == tail.size();
+}
+
+bool check_program_violations( const SimPc::SimNorFlashMemory & mem )
+{
+	if( mem.get_program_violations() ) {
+		std::cerr << mem.get_program_violations() << " bytes written without an erase\n";
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * The reclamation queue is lost at a power loss. The next mount
+ * has to erase the queued pages, before they are used again.
+ */
+bool test_reclamation_power_loss()
+{
+	SimPc::SimNorFlashMemory mem( PAGE_SIZE * PAGES );
+
+	if( !format( mem, base::Header<dynamic::Config>::VERSION_PAGE_LIST ) ) {
+		return false;
+	}
+
+	dynamic::SimpleFlashFs fs( &mem );
+
+	if( !fs.init() ) {
+		return false;
+	}
+
+	// slow enough, that the pages stay in the queue
+	dynamic::SimpleFlashFs::ReclamationConfig config;
+	config.max_erases_per_second = 1;
+	fs.start_reclamation_worker( config );
+
+	const std::size_t FILE_PAGES = 8;
+	std::vector<std::byte> data;
+
+	for( unsigned i = 0; i < 10; i++ ) {
+		data = pattern( PAGE_SIZE * FILE_PAGES, i );
+
+		if( !write_file( fs, "a", data ) ) {
+			return false;
+		}
+	}
+
+	if( fs.get_number_of_pending_erase_pages() == 0 ) {
+		std::cerr << "no pages queued\n";
+		return false;
+	}
+
+	auto image = power_loss( mem );
+	dynamic::SimpleFlashFs fs2( image.get() );
+
+	if( !fs2.init() || !check_file( fs2, "a", data ) ) {
+		return false;
+	}
+
+	// use all free pages
+	const std::size_t FILL_PAGES = 32;
+
+	for( unsigned i = 0; fs2.get_number_of_free_data_pages() >= FILL_PAGES; i++ ) {
+		if( !write_file( fs2, "b" + std::to_string(i), pattern( PAGE_SIZE * FILL_PAGES, i ) ) ) {
+			return false;
+		}
+	}
+
+	return check_program_violations( *image ) && check_file( fs2, "a", data );
+}
+
+/**
+ * writes and erases of the memories sharing one Power are counted.
+ * The write or erase number cut reaches the memory only half,
+ * all later ones are lost.
+ */
+struct Power
+{
+	std::size_t ops = 0;
+	std::size_t cut = SIZE_MAX;
+
+	// returns the number of bytes, that reach the memory
+	std::size_t pass( std::size_t size ) {
+		const std::size_t op = ops++;
+
+		if( op < cut ) {
+			return size;
+		}
+
+		return op == cut ? size / 2 : 0;
+	}
+
+	bool is_cut() const {
+		return ops > cut;
+	}
+};
+
+class PowerCutMemory : public FlashMemoryInterface
+{
+	FlashMemoryInterface & mem;
+	Power & power;
+
+public:
+	PowerCutMemory( FlashMemoryInterface & mem_, Power & power_ )
+	: mem( mem_ ),
+	  power( power_ )
+	{}
+
+	std::size_t size() const override {
+		return mem.size();
+	}
+
+	std::size_t write( std::size_t address, const std::byte *data, std::size_t size ) override {
+		const std::size_t len = power.pass( size );
+
+		if( len > 0 ) {
+			mem.write( address, data, len );
+		}
+
+		return len;
+	}
+
+	std::size_t read( std::size_t address, std::byte *data, std::size_t size ) override {
+		return mem.read( address, data, size );
+	}
+
+	void erase( std::size_t address, std::size_t size ) override {
+		const std::size_t len = power.pass( size );
+
+		if( len > 0 ) {
+			mem.erase( address, len );
+		}
+	}
+};
+
+/**
+ * a file in one of the formats. create() writes and flushes the first
+ * version, change() modifies it through the handle without a flush.
+ * Both return the expected content of the file.
+ */
+struct FormatScenario
+{
+	uint16_t version;
+	std::size_t pages;
+	// size of a checkpoint memory, the flush is followed by write_checkpoint()
+	std::size_t checkpoint_size = 0;
+	std::function<bool( dynamic::SimpleFlashFs & fs, std::vector<std::byte> & data )> create;
+	std::function<bool( dynamic::SimpleFlashFs::FileHandle & file, std::vector<std::byte> & data )> change;
+};
+
+/**
+ * runs the scenario, the power is cut at the write or erase number cut
+ * of the flush. After mounting a copy of the memories the file has to be
+ * the first or the changed version, or only the changed one, if the
+ * power was not cut. The free pages have to be erased.
+ * cut is set to SIZE_MAX, if the flush finished before.
+ */
+bool run_format_scenario( const FormatScenario & scenario, std::size_t & cut )
+{
+	SimPc::SimNorFlashMemory nor( PAGE_SIZE * scenario.pages );
+	SimPc::SimNorFlashMemory checkpoint_nor( std::max<std::size_t>( scenario.checkpoint_size, 1 ) );
+	Power power;
+	PowerCutMemory mem( nor, power );
+	PowerCutMemory checkpoint_mem( checkpoint_nor, power );
+
+	dynamic::SimpleFlashFs::CheckpointConfig checkpoint;
+	checkpoint.mem = &checkpoint_mem;
+	checkpoint.size = scenario.checkpoint_size;
+
+	if( !format( mem, scenario.version, checkpoint ) ) {
+		return false;
+	}
+
+	std::vector<std::byte> first;
+	std::vector<std::byte> changed;
+	std::unique_ptr<SimPc::SimNorFlashMemory> image;
+	std::unique_ptr<SimPc::SimNorFlashMemory> checkpoint_image;
+
+	{
+		dynamic::SimpleFlashFs fs( &mem );
+		fs.set_checkpoint( checkpoint );
+
+		if( !fs.init() || !scenario.create( fs, first ) ) {
+			return false;
+		}
+
+		auto file = fs.open( "f", std::ios_base::in | std::ios_base::out );
+
+		if( !file || !scenario.change( file, changed ) ) {
+			std::cerr << "cannot change f\n";
+			return false;
+		}
+
+		power.cut = cut == SIZE_MAX ? SIZE_MAX : power.ops + cut;
+
+		if( !file.flush() && !power.is_cut() ) {
+			std::cerr << "cannot flush f\n";
+			return false;
+		}
+
+		if( scenario.checkpoint_size > 0 && !fs.write_checkpoint() && !power.is_cut() ) {
+			std::cerr << "cannot write the checkpoint\n";
+			return false;
+		}
+
+		if( !power.is_cut() ) {
+			cut = SIZE_MAX;
+		}
+
+		image = power_loss( nor );
+		checkpoint_image = power_loss( checkpoint_nor );
+	}
+
+	checkpoint.mem = checkpoint_image.get();
+
+	dynamic::SimpleFlashFs fs( image.get() );
+	fs.set_checkpoint( checkpoint );
+
+	if( !fs.init() ) {
+		std::cerr << "cannot mount after cut " << cut << '\n';
+		return false;
+	}
+
+	auto file = fs.open( "f", std::ios_base::in );
+
+	if( !file ) {
+		std::cerr << "f not found after cut " << cut << '\n';
+		return false;
+	}
+
+	std::vector<std::byte> data( file.file_size() );
+
+	if( file.read( data.data(), data.size() ) != data.size() ||
+		!( data == changed || ( cut != SIZE_MAX && data == first ) ) ) {
+		std::cerr << "f has wrong content after cut " << cut << '\n';
+		return false;
+	}
+
+	// use all free pages
+	const std::size_t FILL_PAGES = 32;
+
+	for( unsigned i = 0; fs.get_number_of_free_data_pages() >= FILL_PAGES + 8; i++ ) {
+		if( !write_file( fs, "fill" + std::to_string(i), pattern( PAGE_SIZE * FILL_PAGES, i ) ) ) {
+			return false;
+		}
+	}
+
+	if( !check_program_violations( *image ) || !check_program_violations( *checkpoint_image ) ) {
+		std::cerr << "after cut " << cut << '\n';
+		return false;
+	}
+
+	return check_file( fs, "f", data );
+}
+
+/**
+ * cuts the power at each write and erase of the flush, until the flush
+ * finishes. The first run mounts the memory without a power cut.
+ */
+bool test_format( const FormatScenario & scenario )
+{
+	std::size_t cut = SIZE_MAX;
+
+	if( !run_format_scenario( scenario, cut ) ) {
+		return false;
+	}
+
+	for( std::size_t i = 0; ; i++ ) {
+		cut = i;
+
+		if( !run_format_scenario( scenario, cut ) ) {
+			return false;
+		}
+
+		// the flush finished before the cut
+		if( cut == SIZE_MAX ) {
+			return true;
+		}
+	}
+}
+
+/**
+ * VERSION_EXTENTS: a contiguous file, that needs more page numbers than
+ * fit into an inode page. The change splits the extent.
+ */
+bool test_format_extents()
+{
+	FormatScenario scenario;
+	scenario.version = base::Header<dynamic::Config>::VERSION_EXTENTS;
+	scenario.pages = PAGES;
+
+	scenario.create = []( dynamic::SimpleFlashFs & fs, std::vector<std::byte> & data ) {
+		data = pattern( PAGE_SIZE * 100 + 17, 1 );
+		return write_file( fs, "f", data );
+	};
+
+	scenario.change = []( dynamic::SimpleFlashFs::FileHandle & file, std::vector<std::byte> & data ) {
+		return change_file( file, data, 40 );
+	};
+
+	return test_format( scenario );
+}
+
+/**
+ * writes a file and overwrites every second page, so each page is an
+ * extent of its own. The page numbers have to be stored in table_level
+ * page table pages.
+ */
+bool create_fragmented_file( dynamic::SimpleFlashFs & fs, std::vector<std::byte> & data, std::size_t pages, uint16_t table_level )
+{
+	data = pattern( PAGE_SIZE * pages, 3 );
+
+	if( !write_file( fs, "f", data ) ) {
+		return false;
+	}
+
+	auto file = fs.open( "f", std::ios_base::in | std::ios_base::out );
+	auto page = pattern( PAGE_SIZE, 4 );
+
+	for( std::size_t i = 1; i < pages; i += 2 ) {
+		std::copy( page.begin(), page.end(), data.begin() + i * PAGE_SIZE );
+
+		if( !file.seek( i * PAGE_SIZE ) || file.write( page.data(), page.size() ) != page.size() ) {
+			std::cerr << "cannot write f\n";
+			return false;
+		}
+	}
+
+	if( !file.flush() ) {
+		std::cerr << "cannot flush f\n";
+		return false;
+	}
+
+	if( file.inode.table_level != table_level ) {
+		std::cerr << "f has table level " << file.inode.table_level << " instead of " << table_level << '\n';
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * VERSION_PAGE_TABLES with single indirect page tables
+ */
+bool test_format_page_tables()
+{
+	FormatScenario scenario;
+	scenario.version = base::Header<dynamic::Config>::VERSION_PAGE_TABLES;
+	scenario.pages = PAGES;
+
+	scenario.create = []( dynamic::SimpleFlashFs & fs, std::vector<std::byte> & data ) {
+		return create_fragmented_file( fs, data, 120, 1 );
+	};
+
+	scenario.change = []( dynamic::SimpleFlashFs::FileHandle & file, std::vector<std::byte> & data ) {
+		return change_file( file, data, 10 );
+	};
+
+	return test_format( scenario );
+}
+
+/**
+ * VERSION_PAGE_TABLES with double indirect page tables
+ */
+bool test_format_double_page_tables()
+{
+	FormatScenario scenario;
+	scenario.version = base::Header<dynamic::Config>::VERSION_PAGE_TABLES;
+	scenario.pages = 6500;
+
+	scenario.create = []( dynamic::SimpleFlashFs & fs, std::vector<std::byte> & data ) {
+		return create_fragmented_file( fs, data, 3400, 2 );
+	};
+
+	scenario.change = []( dynamic::SimpleFlashFs::FileHandle & file, std::vector<std::byte> & data ) {
+		return change_file( file, data, 2000 );
+	};
+
+	return test_format( scenario );
+}
+
+/**
+ * the mount reads the checkpoint and the log. The first version of the
+ * file is in the log, the flush appends the changed one and
+ * write_checkpoint() writes the other slot.
+ */
+bool test_format_checkpoint()
+{
+	FormatScenario scenario;
+	scenario.version = base::Header<dynamic::Config>::VERSION_EXTENTS;
+	scenario.pages = PAGES;
+	scenario.checkpoint_size = 2 * 4096;
+
+	scenario.create = []( dynamic::SimpleFlashFs & fs, std::vector<std::byte> & data ) {
+		for( unsigned i = 0; i < 5; i++ ) {
+			if( !write_file( fs, "c" + std::to_string(i), pattern( PAGE_SIZE * i + 5, i ) ) ) {
+				return false;
+			}
+		}
+
+		if( !fs.write_checkpoint() ) {
+			std::cerr << "cannot write the checkpoint\n";
+			return false;
+		}
+
+		data = pattern( PAGE_SIZE * 20 + 17, 1 );
+		return write_file( fs, "f", data );
+	};
+
+	scenario.change = []( dynamic::SimpleFlashFs::FileHandle & file, std::vector<std::byte> & data ) {
+		return change_file( file, data, 5 );
+	};
+
+	return test_format( scenario );
+}
+
+/**
+ * write() allocates all pages before writing them. If a write fails,
+ * the pages behind the end of the file are given back.
+ */
+bool test_failed_write()
+{
+	SimPc::SimNorFlashMemory nor( PAGE_SIZE * PAGES );
+	Power power;
+	PowerCutMemory mem( nor, power );
+
+	if( !format( mem, base::Header<dynamic::Config>::VERSION_EXTENTS ) ) {
+		return false;
+	}
+
+	dynamic::SimpleFlashFs fs( &mem );
+
+	if( !fs.init() || !write_file( fs, "f", pattern( PAGE_SIZE * 2, 1 ) ) ) {
+		return false;
+	}
+
+	const std::size_t free_pages = fs.get_number_of_free_data_pages();
+	auto file = fs.open( "f", std::ios_base::in | std::ios_base::out );
+
+	if( !file || !file.seek( file.file_size() ) ) {
+		return false;
+	}
+
+	// the second page of the write fails
+	auto data = pattern( PAGE_SIZE * 10, 2 );
+	power.cut = power.ops + 1;
+
+	if( file.write( data.data(), data.size() ) == data.size() ) {
+		std::cerr << "write did not fail\n";
+		return false;
+	}
+
+	power.cut = SIZE_MAX;
+
+	if( file.inode.count_valid_data_pages() != 2 ) {
+		std::cerr << file.inode.count_valid_data_pages() << " data pages after the failed write\n";
+		return false;
+	}
+
+	if( !file.flush() ) {
+		std::cerr << "cannot flush f\n";
+		return false;
+	}
+
+	if( fs.get_number_of_free_data_pages() != free_pages ) {
+		std::cerr << free_pages - fs.get_number_of_free_data_pages() << " data pages lost\n";
+		return false;
+	}
+
+	return check_content( file, "f", pattern( PAGE_SIZE * 2, 1 ) );
+}
+
+/**
+ * The segment cleaner must not move the pages of an open file, the
+ * handle would write its next inode version with the old pages.
+ */
+bool test_clean_open_file()
+{
+	SimPc::SimNorFlashMemory mem( PAGE_SIZE * PAGES );
+
+	{
+		dynamic::SimpleFlashFs fs( &mem );
+		auto header = fs.create_default_header( PAGE_SIZE, PAGES );
+		header.version = base::Header<dynamic::Config>::VERSION_EXTENTS;
+		header.erase_block_size = 8;
+
+		if( !fs.create( header ) ) {
+			std::cerr << "cannot create the filesystem\n";
+			return false;
+		}
+	}
+
+	dynamic::SimpleFlashFs fs( &mem );
+	auto data = pattern( PAGE_SIZE * 3, 1 );
+
+	if( !fs.init() || !write_file( fs, "f", data ) ) {
+		return false;
+	}
+
+	// the blocks of f fill up with dead pages
+	for( unsigned i = 0; i < 20; i++ ) {
+		if( !write_file( fs, "g", pattern( PAGE_SIZE * 2, i ) ) ) {
+			return false;
+		}
+	}
+
+	auto file = fs.open( "f", std::ios_base::in | std::ios_base::out );
+
+	if( !file ) {
+		std::cerr << "f not found\n";
+		return false;
+	}
+
+	fs.clean_segments( 100 );
+
+	if( !change_file( file, data, 1 ) || !file.flush() ) {
+		std::cerr << "cannot change f\n";
+		return false;
+	}
+
+	file = {};
+
+	// now the cleaner can move f
+	if( fs.clean_segments( 100 ) == 0 ) {
+		std::cerr << "no block cleaned\n";
+		return false;
+	}
+
+	if( !check_file( fs, "f", data ) || !check_file( fs, "g", pattern( PAGE_SIZE * 2, 19 ) ) ) {
+		return false;
+	}
+
+	dynamic::SimpleFlashFs remounted( &mem );
+
+	if( !remounted.init() ) {
+		std::cerr << "cannot mount again\n";
+		return false;
+	}
+
+	return check_file( remounted, "f", data ) && check_program_violations( mem );
+}
+
+class TestDrive : public FramFsImplDetail
+{
+public:
+	TestDrive( FlashMemoryInterface *mem_interface_ )
+	: FramFsImplDetail( mem_interface_, "t" )
+	{}
+
+	void create() override {
+		auto header = create_default_header( PAGE_SIZE, PAGES );
+		header.version = decltype(header)::VERSION_PAGE_TABLES;
+		base_t::create( header );
+	}
+};
+
+/**
+ * The VFS server opens files without a write mode as snapshots.
+ * A reader sees the last flushed version, not the data other
+ * handles did not flush yet, and keeps it after the flush.
+ */
+bool test_vfs_read_only_snapshot()
+{
+	SimPc::SimNorFlashMemory mem( PAGE_SIZE * PAGES );
+	auto drive = std::make_shared<TestDrive>( &mem );
+	drive->create();
+
+	Vfs::SimpleFlashFsVfsServer server;
+	server.register_drive( drive );
+
+	const std::string name = "/t/file";
+	auto writer = server.open( name, std::ios_base::out | std::ios_base::trunc );
+
+	if( !writer ) {
+		std::cerr << "cannot open " << name << " for writing\n";
+		return false;
+	}
+
+	auto flushed = pattern( PAGE_SIZE * 3 + 10, 1 );
+
+	if( writer->write( flushed.data(), flushed.size() ) != flushed.size() || !writer->flush() ) {
+		std::cerr << "cannot write " << name << '\n';
+		return false;
+	}
+
+	// more than a page, so some of the data pages are programmed already
+	auto unflushed = pattern( PAGE_SIZE * 2 + 20, 2 );
+
+	if( writer->write( unflushed.data(), unflushed.size() ) != unflushed.size() ) {
+		std::cerr << "cannot write " << name << '\n';
+		return false;
+	}
+
+	auto reader = server.open( name, std::ios_base::in );
+
+	if( !reader ) {
+		std::cerr << "cannot open " << name << " for reading\n";
+		return false;
+	}
+
+	if( !check_content( *reader, name, flushed ) ) {
+		return false;
+	}
+
+	if( !writer->flush() ) {
+		std::cerr << "cannot flush " << name << '\n';
+		return false;
+	}
+
+	auto all = flushed;
+	all.insert( all.end(), unflushed.begin(), unflushed.end() );
+
+	auto reader2 = server.open( name, std::ios_base::in );
+
+	if( !reader2 ) {
+		std::cerr << "cannot open " << name << " for reading\n";
+		return false;
+	}
+
+	return check_content( *reader, name, flushed ) &&
+		   check_content( *reader2, name, all ) &&
+		   check_program_violations( mem );
+}
+
+const std::vector<Test> TESTS {
+	{ "reclamation_power_loss", test_reclamation_power_loss },
+	{ "vfs_read_only_snapshot", test_vfs_read_only_snapshot },
+	{ "format_extents", test_format_extents },
+	{ "format_page_tables", test_format_page_tables },
+	{ "format_double_page_tables", test_format_double_page_tables },
+	{ "format_checkpoint", test_format_checkpoint },
+	{ "failed_write", test_failed_write },
+	{ "clean_open_file", test_clean_open_file },
+};
+
+} // namespace
+
+int main( int argc, char **argv )
+{
+	const std::vector<std::string_view> selected( argv + 1, argv + argc );
+	bool ok = true;
+
+	for( const auto & test : TESTS ) {
+		if( !selected.empty() && std::find( selected.begin(), selected.end(), test.name ) == selected.end() ) {
+			continue;
+		}
+
+		const bool passed = test.f();
+		std::cout << test.name << ": " << ( passed ? "OK" : "FAILED" ) << '\n';
+		ok = ok && passed;
+	}
+
+	return ok ? 0 : 1;
+}
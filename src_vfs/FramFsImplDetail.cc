@@ -5,12 +5,20 @@ using namespace Tools;
 
 ::SimpleFlashFs::Vfs::file_handle_t FramFsImplDetail::open( const std::string_view & path, std::ios_base::openmode mode )
 {
-	auto fh = base_t::open( path, mode );
+	constexpr auto write_modes = std::ios_base::out | std::ios_base::app | std::ios_base::trunc;
+
+	// readers get their own snapshot and do not wait for writers
+	auto fh = ( mode & write_modes ) ? base_t::open( path, mode ) : base_t::open_snapshot( path );
 
 	if( !fh ) {
 		return nullptr;
 	}
 
+	// collect small appends in RAM, the page is programmed when it is full
+	if( mode & std::ios_base::app ) {
+		fh.set_tail_buffer( true );
+	}
+
 	return std::make_unique<FileHandle>( std::move(fh) );
 }
 
@@ -42,31 +50,64 @@ void FramFsImplDetail::cleanup()
 		}
 		
 		if( inode->inode.file_name.empty() ) {
-			mem->erase( header.page_size + inode->page * header.page_size, header.page_size );
+			erase_inode_page( inode->page );
 		}
 	}
 }
 
 std::optional<uint32_t> FramFsImplDetail::allocate_free_data_page()
 {
+	// least worn page first, or sequential in erase block mode
+	if( is_wear_leveling_enabled() || is_block_mode() ) {
+		return base_t::allocate_free_data_page();
+	}
+
+	reclaim_if_no_free_data_pages( 1 );
+
+	std::lock_guard<config_t::mutex_type> lock( m_free_data_pages_mutex );
+
 	if( free_data_pages.empty() ) {
 		CPPDEBUG( "no free data pages left" );
 		return {};
 	}
 
-	std::uniform_int_distribution<std::mt19937::result_type> dist(0,free_data_pages.size()-1);
-	int target_index = dist(m_rng);
+	// start at a random page and take the next free one
+	std::uniform_int_distribution<std::mt19937::result_type> dist(header.max_inodes, header.filesystem_size-2);
+	auto ret = free_data_pages.find_next( dist(m_rng) );
 
-	for( auto it = free_data_pages.begin(); it != free_data_pages.end(); ++it, --target_index )
-	{
-		if( target_index == 0 ) {
-			uint32_t ret = *it;
-			free_data_pages.erase(it);
-			return ret;
-		}
+	if( !ret ) {
+		ret = free_data_pages.find_first();
+	}
+
+	if( ret ) {
+		free_data_pages.erase( *ret );
+	}
+
+	return ret;
+}
+
+std::optional<::SimpleFlashFs::base::PageRun> FramFsImplDetail::allocate_free_data_page_run( uint32_t near_page, uint32_t count )
+{
+	if( is_wear_leveling_enabled() || is_block_mode() ) {
+		return base_t::allocate_free_data_page_run( near_page, count );
 	}
-	
-	return {};
+
+	reclaim_if_no_free_data_pages( count );
+
+	std::lock_guard<config_t::mutex_type> lock( m_free_data_pages_mutex );
+
+	if( free_data_pages.empty() ) {
+		CPPDEBUG( "no free data pages left" );
+		return {};
+	}
+
+	// a new file starts at a random page, an existing one grows in place
+	if( near_page == 0 ) {
+		std::uniform_int_distribution<std::mt19937::result_type> dist(header.max_inodes, header.filesystem_size-2);
+		near_page = dist(m_rng);
+	}
+
+	return free_data_pages.allocate_run( near_page, count );
 }
 
 bool FramFsImplDetail::init() 
@@ -76,8 +117,11 @@ bool FramFsImplDetail::init()
 		return false;
 	}
 
-	m_header_inode_range.reinit( header );
-	header_inode_range = &m_header_inode_range;
+	// otherwise the least worn inode pages are used, or they are written sequentially
+	if( !is_wear_leveling_enabled() && !is_block_mode() ) {
+		m_header_inode_range.reinit( header );
+		header_inode_range = &m_header_inode_range;
+	}
 
 	m_initialized = true;
 	return true;
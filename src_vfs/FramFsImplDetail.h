@@ -117,4 +117,5 @@ protected:
 
 	// wear leveling for data pages
 	std::optional<uint32_t> allocate_free_data_page() override;
+	std::optional<::SimpleFlashFs::base::PageRun> allocate_free_data_page_run( uint32_t near_page, uint32_t count ) override;
 };
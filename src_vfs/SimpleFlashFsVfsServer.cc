@@ -41,8 +41,9 @@ namespace {
 //
 // Read paths in the base FS are lock-free; the per-OpenFile mutex
 // here serialises CALLS to the FS for a single file but does not
-// serialise calls for different files. The base FS's own fine-grained
-// locks (m_inode_meta_mutex / m_free_data_pages_mutex / m_mem_mutex)
+// serialise calls for different files. Read only openers do not use
+// a ThreadedFileHandle at all, see open(). The base FS's own fine-grained
+// locks (m_inode_meta_mutex / m_free_data_pages_mutex / m_bank_mutex)
 // keep cross-file operations safe.
 class ThreadedFileHandle : public SimpleFlashFs::FileInterface
 {
@@ -229,8 +230,13 @@ file_handle_t SimpleFlashFsVfsServer::open( const std::string_view & path, std::
     key.reserve( drive_name.size() + 1 + file_path.size() );
     key.append( drive_name ).append( ":" ).append( file_path );
 
+    // Readers get their own snapshot of the last flushed version from
+    // the drive. They bypass the open-file table, so they never wait
+    // for the OpenFile mutex of a writer.
+    const bool read_only = ( mode & ( std::ios::out | std::ios::app | std::ios::trunc ) ) == 0;
+
     // Step 1: is the file already open by another handle?
-    if( auto it = m_open_files.find( key ); it != m_open_files.end() ) {
+    if( auto it = m_open_files.find( key ); !read_only && it != m_open_files.end() ) {
         if( auto entry = it->second.lock(); entry && entry->handle && !!*entry->handle ) {
             // Yes - reuse the shared OpenFile.
             //
@@ -268,6 +274,9 @@ file_handle_t SimpleFlashFsVfsServer::open( const std::string_view & path, std::
         }
 
         auto file = drive->open( file_path, mode );
+        if( file && read_only ) {
+            return file;
+        }
         if( file ) {
             // Move the unique_ptr<FileInterface> into an OpenFile
             // and store a weak_ptr in the table.
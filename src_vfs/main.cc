@@ -11,7 +11,10 @@
 #include <filesystem>
 #include <optional>
 #include <set>
-#include "../src/sim_pc/SimFlashMemoryPc.h"
+#include <map>
+#include <unistd.h>
+#include "../src/sim_pc/SimMmapFlashMemoryPc.h"
+#include "../src/SimpleFlashFsInstrumentedFlashMemory.h"
 #include "FramFsImplDetail.h"
 #include "SimpleFlashFsVfsServer.h"
 #include "CommandParser.h"
@@ -51,15 +54,34 @@ class FramFsDriveB : public FramFsImplDetail
 public:
     FramFsDriveB( ::SimpleFlashFs::FlashMemoryInterface *mem_interface_ )
     : FramFsImplDetail( mem_interface_, "b" )
-    {}
+    {
+        // least worn pages first. The filesystem fills the whole AT45,
+        // so the erase counters are kept in RAM only.
+        WearLevelingConfig wear_config;
+        wear_config.enabled = true;
+        set_wear_leveling( wear_config );
+    }
 
     void create() override {
         auto header = ::SimpleFlashFs::dynamic::SimpleFlashFs::create_default_header(DRIVE_B_AT45_DB321E_PAGE_SIZE, DRIVE_B_AT45_DB321E_SIZE / DRIVE_B_AT45_DB321E_PAGE_SIZE );
 
+        // large files, store the data pages as extents or in page table pages
+        header.version = decltype(header)::VERSION_PAGE_TABLES;
+
         if( !::SimpleFlashFs::dynamic::SimpleFlashFs::create(header) ) {
             throw STDERR_EXCEPTION( "cannot create drive b" );
         }
     }
+
+    bool init() override {
+        if( !FramFsImplDetail::init() ) {
+            return false;
+        }
+
+        // AT45 page erases are slow, do them in the background
+        start_reclamation_worker();
+        return true;
+    }
 };
 
 class CommandQuit : public SimpleFlashFs::Vfs::Command
@@ -100,9 +122,70 @@ public:
 };
 
 
+class CommandIoStat : public SimpleFlashFs::Vfs::FilesystemCommand
+{
+	std::map<std::string,InstrumentedFlashMemory*> m_mems;
+
+public:
+	CommandIoStat( std::shared_ptr<SimpleFlashFs::Vfs::VfsServerInterface> vfs, std::map<std::string,InstrumentedFlashMemory*> mems )
+	: FilesystemCommand( vfs ),
+	  m_mems( mems )
+	{}
+
+	SimpleFlashFs::Vfs::CommandResult execute(const std::vector<std::string>& args) override {
+		std::string drive( m_vfs->get_current_drive() );
+		bool do_reset = false;
+
+		for( std::size_t i = 1; i < args.size(); i++ ) {
+			if( args[i] == "reset" ) {
+				do_reset = true;
+			} else {
+				drive = args[i];
+				if( drive.ends_with(':') ) {
+					drive.pop_back();
+				}
+			}
+		}
+
+		auto it = m_mems.find( drive );
+
+		if( it == m_mems.end() ) {
+			return {false, "iostat: unknown drive: " + drive, ""};
+		}
+
+		if( do_reset ) {
+			it->second->reset();
+			return {true, "OK", "Counters of drive " + drive + " cleared.\n"};
+		}
+
+		return {true, "OK", it->second->snapshot().report()};
+	}
+
+	std::string get_description() const override {
+		return "Show the flash memory access statistics";
+	}
+
+	std::string get_usage() const override {
+		return "iostat [drive] [reset]  - Show or clear the access counters of a drive";
+	}
+};
+
+
+// a write protected image is opened read only, so it can still be inspected
+static std::shared_ptr<::SimpleFlashFs::FlashMemoryInterface> open_drive_image( const std::string & file, std::size_t size )
+{
+	if( std::filesystem::exists( file ) && access( file.c_str(), W_OK ) != 0 ) {
+		return std::make_shared<SimMmapFlashMemory>( file, SimMmapFlashMemory::Access::ReadOnly );
+	}
+
+	return std::make_shared<SimMmapFlashMemory>( file, size );
+}
+
 std::shared_ptr<Vfs::VfsServerInterface>                vfs         = std::make_shared<Vfs::SimpleFlashFsVfsServer>();
-std::shared_ptr<::SimpleFlashFs::FlashMemoryInterface>  mem_drive_a = std::make_shared<SimFlashFsFlashMemory>(".drive_a", DRIVE_A_FM_25_W_256_SIZE);
-std::shared_ptr<::SimpleFlashFs::FlashMemoryInterface>  mem_drive_b = std::make_shared<SimFlashFsFlashMemory>(".drive_b", DRIVE_B_AT45_DB321E_SIZE);
+std::shared_ptr<::SimpleFlashFs::FlashMemoryInterface>  sim_drive_a = open_drive_image(".drive_a", DRIVE_A_FM_25_W_256_SIZE);
+std::shared_ptr<::SimpleFlashFs::FlashMemoryInterface>  sim_drive_b = open_drive_image(".drive_b", DRIVE_B_AT45_DB321E_SIZE);
+std::shared_ptr<InstrumentedFlashMemory>                mem_drive_a = std::make_shared<InstrumentedFlashMemory>(sim_drive_a.get(), DRIVE_A_FM_25_W_256_PAGE_SIZE);
+std::shared_ptr<InstrumentedFlashMemory>                mem_drive_b = std::make_shared<InstrumentedFlashMemory>(sim_drive_b.get(), DRIVE_B_AT45_DB321E_PAGE_SIZE);
 
 int main( int argc, char **argv )
 {
@@ -175,6 +258,9 @@ int main( int argc, char **argv )
 		parser->register_command("b:", std::make_shared<Vfs::DOSChangeDriveCommand>(vfs, "b"));
 		parser->register_command("cleanup", std::make_shared<CommandCleanup>(vfs));
 		parser->register_command("test_count", std::make_shared<Vfs::TestCount>(vfs));
+		parser->register_command("iostat", std::make_shared<CommandIoStat>(vfs, std::map<std::string,InstrumentedFlashMemory*>{
+			{ "a", mem_drive_a.get() },
+			{ "b", mem_drive_b.get() } }));
 
 		bool continue_interactive = true;
 